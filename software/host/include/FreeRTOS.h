@@ -0,0 +1,35 @@
+#ifndef _FREERTOS_H
+#define _FREERTOS_H
+
+/*
+    the parts of the FreeRTOS api the firmware uses, for the host build. the
+    kernel is replaced by sim/rtos.c, which runs everything on the one thread
+    and only moves simulated time on while something waits
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include "FreeRTOSConfig.h"
+
+typedef uint32_t TickType_t;
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+
+typedef struct sim_task* TaskHandle_t;
+typedef struct sim_queue* QueueHandle_t;
+typedef struct sim_queue* SemaphoreHandle_t;
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS pdTRUE
+#define pdFAIL pdFALSE
+
+#define portMAX_DELAY 0xFFFFFFFF
+#define pdMS_TO_TICKS(ms) ((TickType_t)(((uint64_t)(ms) * configTICK_RATE_HZ) / 1000))
+#define portYIELD_FROM_ISR(woken) (void)(woken)
+
+// nothing preempts the one thread the host build runs on
+#define taskENTER_CRITICAL()
+#define taskEXIT_CRITICAL()
+
+#endif // _FREERTOS_H
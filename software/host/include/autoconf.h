@@ -0,0 +1,57 @@
+#ifndef _AUTOCONF_H
+#define _AUTOCONF_H
+
+/*
+    the configuration the host build runs with, the Kconfig defaults with
+    proj.conf laid over them. the values the sdk's Kconfig supplies on the
+    target are the ones the board is built with. CONFIG_MIDI_OUT_TRACE is on
+    so the tests can read the trace
+*/
+
+#define CONFIG_TOTAL_SEQUENCES 64
+#define CONFIG_MAX_SEQUENCES 64
+#define CONFIG_STEPS_PER_SEQUENCE 64
+#define CONFIG_TEMPO 120
+
+#define CONFIG_UART 1
+#define CONFIG_MIDI 1
+#define CONFIG_SPI 1
+#define CONFIG_W25Q128JV 1
+#define CONFIG_KEYBOARD 1
+#define CONFIG_FREERTOS 1
+#define CONFIG_LOAD_TEST_SEQUENCE 1
+#define CONFIG_KEY_SCAN_MS 50
+#define CONFIG_PACKET_BUFFER_LENGTH 16
+#define CONFIG_I2C 1
+#define CONFIG_SSD1306 1
+#define CONFIG_MAX_POLYPHONY 8
+#define CONFIG_RESET_SEQ_ON_DISABLE 1
+
+#define CONFIG_STEPS_PER_BAR 16
+#define CONFIG_DISPLAY_FPS 30
+#define CONFIG_KEY_DEBOUNCE_MS 5
+#define CONFIG_KEY_HOLD_MS 500
+#define CONFIG_KEY_QUEUE_LENGTH 16
+
+#define CONFIG_MIDI_RUNNING_STATUS_PORT_A 1
+#define CONFIG_MIDI_RUNNING_STATUS_PORT_B 1
+#define CONFIG_MIDI_RUNNING_STATUS_PORT_C 1
+#define CONFIG_MIDI_RUNNING_STATUS_PORT_D 1
+#define CONFIG_MIDI_TX_BUFFER_LENGTH 512
+#define CONFIG_MIDI_BUDGET_RESERVE_BYTES 6
+#define CONFIG_MIDI_OUT_TRACE 1
+#define CONFIG_MIDI_OUT_TRACE_BYTES 4096
+
+#define CONFIG_METADATA_BASE_ADDR 0
+#define CONFIG_METADATA_BYTES_PER_SEQ 16
+#define CONFIG_STEPS_BASE_ADDR 1024
+#define CONFIG_FLASH_QUEUE_LENGTH 8
+#define CONFIG_STORE_BASE_ADDR 1048576
+#define CONFIG_STORE_SECTORS 640
+#define CONFIG_STORE_FREE_SECTORS 8
+#define CONFIG_SAVE_COW_SLOTS 4
+#define CONFIG_STORE_BANKS 16
+#define CONFIG_BANK_STAGE_BYTES 8192
+#define CONFIG_BANK_SWAP_SEQUENCES 8
+
+#endif // _AUTOCONF_H
@@ -0,0 +1,6 @@
+#ifndef _I2C_H
+#define _I2C_H
+
+void init_i2c(void);
+
+#endif // _I2C_H
@@ -0,0 +1,22 @@
+#ifndef _K_BUF_H
+#define _K_BUF_H
+
+#include <stdint.h>
+
+typedef struct {
+    uint8_t* buffer;
+    uint8_t max;
+    uint8_t size;
+    uint8_t ready;
+} k_buf_t;
+
+typedef k_buf_t* kbuf_handle_t;
+
+kbuf_handle_t kbuf_init(uint8_t* buffer, uint8_t size);
+void kbuf_reset(kbuf_handle_t k);
+void kbuf_push(kbuf_handle_t k, uint8_t data);
+uint8_t kbuf_size(kbuf_handle_t k);
+uint8_t kbuf_empty(kbuf_handle_t k);
+uint8_t kbuf_ready(kbuf_handle_t k);
+
+#endif // _K_BUF_H
@@ -0,0 +1,18 @@
+#ifndef _KEYBOARD_H
+#define _KEYBOARD_H
+
+#include <stdint.h>
+
+// the shift register clear on port d and the row inputs on port c
+#define CLR (1 << 5)
+
+#define ROW_INPUT_0_PIN 5
+#define ROW_INPUT_1_PIN 6
+#define ROW_INPUT_2_PIN 7
+#define ROW_INPUT_3_PIN 8
+#define ROW_INPUT_4_PIN 9
+#define ROW_INPUT_5_PIN 10
+#define ROW_INPUT_6_PIN 11
+#define ROW_INPUT_7_PIN 12
+
+#endif // _KEYBOARD_H
@@ -0,0 +1,216 @@
+#ifndef _MIDI_H
+#define _MIDI_H
+
+/*
+    the midi types and uart senders of the sdk's midi driver, for the host
+    build. the senders only feed sim/sdk.c, the firmware's own midi output
+    goes through midi_out.c and the dma
+*/
+
+#include <stdint.h>
+#include "stm32f722xx.h"
+
+typedef enum {
+    NOTE_OFF = 0x80,
+    NOTE_ON = 0x90,
+    POLY_PRESSURE = 0xA0,
+    CONTROLLER = 0xB0,
+    PROGRAM_CHANGE = 0xC0,
+    CHANNEL_PRESSURE = 0xD0,
+    PITCH_BEND = 0xE0,
+} MIDIStatus_t;
+
+typedef enum {
+    A0 = 21,
+    ASHARP0 = 22,
+    B0 = 23,
+    C1 = 24,
+    CSHARP1 = 25,
+    D1 = 26,
+    DSHARP1 = 27,
+    E1 = 28,
+    F1 = 29,
+    FSHARP1 = 30,
+    G1 = 31,
+    GSHARP1 = 32,
+    A1 = 33,
+    ASHARP1 = 34,
+    B1 = 35,
+    C2 = 36,
+    CSHARP2 = 37,
+    D2 = 38,
+    DSHARP2 = 39,
+    E2 = 40,
+    F2 = 41,
+    FSHARP2 = 42,
+    G2 = 43,
+    GSHARP2 = 44,
+    A2 = 45,
+    ASHARP2 = 46,
+    B2 = 47,
+    C3 = 48,
+    CSHARP3 = 49,
+    D3 = 50,
+    DSHARP3 = 51,
+    E3 = 52,
+    F3 = 53,
+    FSHARP3 = 54,
+    G3 = 55,
+    GSHARP3 = 56,
+    A3 = 57,
+    ASHARP3 = 58,
+    B3 = 59,
+    C4 = 60,
+    CSHARP4 = 61,
+    D4 = 62,
+    DSHARP4 = 63,
+    E4 = 64,
+    F4 = 65,
+    FSHARP4 = 66,
+    G4 = 67,
+    GSHARP4 = 68,
+    A4 = 69,
+    ASHARP4 = 70,
+    B4 = 71,
+    C5 = 72,
+    CSHARP5 = 73,
+    D5 = 74,
+    DSHARP5 = 75,
+    E5 = 76,
+    F5 = 77,
+    FSHARP5 = 78,
+    G5 = 79,
+    GSHARP5 = 80,
+    A5 = 81,
+    ASHARP5 = 82,
+    B5 = 83,
+    C6 = 84,
+    CSHARP6 = 85,
+    D6 = 86,
+    DSHARP6 = 87,
+    E6 = 88,
+    F6 = 89,
+    FSHARP6 = 90,
+    G6 = 91,
+    GSHARP6 = 92,
+    A6 = 93,
+    ASHARP6 = 94,
+    B6 = 95,
+    C7 = 96,
+    CSHARP7 = 97,
+    D7 = 98,
+    DSHARP7 = 99,
+    E7 = 100,
+    F7 = 101,
+    FSHARP7 = 102,
+    G7 = 103,
+    GSHARP7 = 104,
+    A7 = 105,
+    ASHARP7 = 106,
+    B7 = 107,
+    C8 = 108,
+} MIDINote_t;
+
+// the port in the high nibble and the channel in the low
+typedef enum {
+    PORT_A_CHANNEL_1 = 0x00,
+    PORT_A_CHANNEL_2 = 0x01,
+    PORT_A_CHANNEL_3 = 0x02,
+    PORT_A_CHANNEL_4 = 0x03,
+    PORT_A_CHANNEL_5 = 0x04,
+    PORT_A_CHANNEL_6 = 0x05,
+    PORT_A_CHANNEL_7 = 0x06,
+    PORT_A_CHANNEL_8 = 0x07,
+    PORT_A_CHANNEL_9 = 0x08,
+    PORT_A_CHANNEL_10 = 0x09,
+    PORT_A_CHANNEL_11 = 0x0A,
+    PORT_A_CHANNEL_12 = 0x0B,
+    PORT_A_CHANNEL_13 = 0x0C,
+    PORT_A_CHANNEL_14 = 0x0D,
+    PORT_A_CHANNEL_15 = 0x0E,
+    PORT_A_CHANNEL_16 = 0x0F,
+    PORT_B_CHANNEL_1 = 0x10,
+    PORT_B_CHANNEL_2 = 0x11,
+    PORT_B_CHANNEL_3 = 0x12,
+    PORT_B_CHANNEL_4 = 0x13,
+    PORT_B_CHANNEL_5 = 0x14,
+    PORT_B_CHANNEL_6 = 0x15,
+    PORT_B_CHANNEL_7 = 0x16,
+    PORT_B_CHANNEL_8 = 0x17,
+    PORT_B_CHANNEL_9 = 0x18,
+    PORT_B_CHANNEL_10 = 0x19,
+    PORT_B_CHANNEL_11 = 0x1A,
+    PORT_B_CHANNEL_12 = 0x1B,
+    PORT_B_CHANNEL_13 = 0x1C,
+    PORT_B_CHANNEL_14 = 0x1D,
+    PORT_B_CHANNEL_15 = 0x1E,
+    PORT_B_CHANNEL_16 = 0x1F,
+    PORT_C_CHANNEL_1 = 0x20,
+    PORT_C_CHANNEL_2 = 0x21,
+    PORT_C_CHANNEL_3 = 0x22,
+    PORT_C_CHANNEL_4 = 0x23,
+    PORT_C_CHANNEL_5 = 0x24,
+    PORT_C_CHANNEL_6 = 0x25,
+    PORT_C_CHANNEL_7 = 0x26,
+    PORT_C_CHANNEL_8 = 0x27,
+    PORT_C_CHANNEL_9 = 0x28,
+    PORT_C_CHANNEL_10 = 0x29,
+    PORT_C_CHANNEL_11 = 0x2A,
+    PORT_C_CHANNEL_12 = 0x2B,
+    PORT_C_CHANNEL_13 = 0x2C,
+    PORT_C_CHANNEL_14 = 0x2D,
+    PORT_C_CHANNEL_15 = 0x2E,
+    PORT_C_CHANNEL_16 = 0x2F,
+    PORT_D_CHANNEL_1 = 0x30,
+    PORT_D_CHANNEL_2 = 0x31,
+    PORT_D_CHANNEL_3 = 0x32,
+    PORT_D_CHANNEL_4 = 0x33,
+    PORT_D_CHANNEL_5 = 0x34,
+    PORT_D_CHANNEL_6 = 0x35,
+    PORT_D_CHANNEL_7 = 0x36,
+    PORT_D_CHANNEL_8 = 0x37,
+    PORT_D_CHANNEL_9 = 0x38,
+    PORT_D_CHANNEL_10 = 0x39,
+    PORT_D_CHANNEL_11 = 0x3A,
+    PORT_D_CHANNEL_12 = 0x3B,
+    PORT_D_CHANNEL_13 = 0x3C,
+    PORT_D_CHANNEL_14 = 0x3D,
+    PORT_D_CHANNEL_15 = 0x3E,
+    PORT_D_CHANNEL_16 = 0x3F,
+} MIDIChannel_t;
+
+typedef enum {
+    ALL_SOUND_OFF = 120,
+    RESET_ALL_CONTROLLERS = 121,
+    ALL_NOTES_OFF = 123,
+} MIDIControl_t;
+
+typedef struct {
+    MIDIStatus_t status;
+    MIDIChannel_t channel;
+    MIDINote_t note;
+    uint8_t velocity;
+} MIDIPacket_t;
+
+typedef struct {
+    MIDIStatus_t status;
+    MIDIChannel_t channel;
+    MIDIControl_t control;
+    uint8_t value;
+} MIDICC_t;
+
+typedef struct {
+    MIDIChannel_t channel;
+    uint8_t prescale_value;
+    uint8_t prescale_counter;
+    uint8_t counter;
+    uint32_t enabled_steps[2];
+    uint32_t muted_steps[2];
+    uint32_t queue[2];
+} MIDISequence_t;
+
+void send_midi_note(USART_TypeDef* uart, MIDIPacket_t* p);
+void send_midi_control(USART_TypeDef* uart, MIDICC_t* cc);
+void all_channels_off(USART_TypeDef* uart);
+
+#endif // _MIDI_H
@@ -0,0 +1,14 @@
+#ifndef _QUEUE_H
+#define _QUEUE_H
+
+#include "FreeRTOS.h"
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size);
+BaseType_t xQueueSend(QueueHandle_t q, const void* item, TickType_t wait);
+BaseType_t xQueueSendToBack(QueueHandle_t q, const void* item, TickType_t wait);
+BaseType_t xQueueSendToBackFromISR(QueueHandle_t q, const void* item, BaseType_t* woken);
+BaseType_t xQueueSendFromISR(QueueHandle_t q, const void* item, BaseType_t* woken);
+BaseType_t xQueueReceive(QueueHandle_t q, void* item, TickType_t wait);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q);
+
+#endif // _QUEUE_H
@@ -0,0 +1,69 @@
+#ifndef _SIM_H
+#define _SIM_H
+
+/*
+    control of the simulated board the host build runs on. time is counted in
+    cpu cycles at SystemCoreClock and only moves on while every task is
+    waiting, or while a peripheral is being driven, so a run is the same every
+    time it is made
+*/
+
+#include <stdint.h>
+#include "FreeRTOS.h"
+
+// exit status of a process whose power was cut, see sim_flash_cut_after()
+#define SIM_POWER_CUT 99
+
+uint64_t sim_now();
+uint64_t sim_us();
+uint64_t sim_cycles_per_us();
+
+/*
+    mark the scheduler started. until then the calling code is the only task,
+    as in main() before vTaskStartScheduler()
+*/
+void sim_start();
+
+// run the tasks created so far while the caller sleeps for us microseconds
+void sim_run_us(uint64_t us);
+
+// move time on by a number of cycles with the current task still running
+void sim_advance(uint64_t cycles);
+
+// called by the rtos each time time has moved on, fires the peripheral events due
+void sim_hw_run(uint64_t until);
+uint64_t sim_hw_next_event();
+
+/*
+    a dma transfer on one of the midi uarts
+
+    @param start_us when the first byte went out
+    @param end_us   when the last byte finished
+    @param offset   where its bytes start in sim_midi_bytes()
+    @param len      number of bytes sent
+*/
+typedef struct {
+    uint64_t start_us;
+    uint64_t end_us;
+    uint32_t offset;
+    uint16_t len;
+} sim_tx_t;
+
+uint32_t sim_midi_transfers(uint8_t port);
+const sim_tx_t* sim_midi_transfer(uint8_t port, uint32_t i);
+const uint8_t* sim_midi_bytes(uint8_t port);
+
+/*
+    the flash chip. the image is shared with forked processes, so a child can
+    run until its power is cut and another then mount what it left behind
+*/
+uint8_t* sim_flash_image();
+uint32_t sim_flash_ops();
+uint32_t sim_flash_programs();
+uint32_t sim_flash_erases();
+void sim_flash_cut_after(uint32_t ops);
+
+// everything written to the debug uart
+const char* sim_debug_output();
+
+#endif // _SIM_H
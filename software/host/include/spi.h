@@ -0,0 +1,21 @@
+#ifndef _SPI_H
+#define _SPI_H
+
+#include <stdint.h>
+#include "stm32f722xx.h"
+
+typedef struct {
+    SPI_TypeDef* spi;
+    GPIO_TypeDef* gpio;
+    uint8_t miso;
+    uint8_t mosi;
+    uint8_t clk;
+    uint8_t cs;
+} SPI_Handler;
+
+int init_spi(SPI_Handler* h);
+void CS_low(GPIO_TypeDef* gpio, uint8_t pin);
+void CS_high(GPIO_TypeDef* gpio, uint8_t pin);
+void SPI_tx_rx(SPI_TypeDef* spi, uint8_t* tx, uint8_t* rx, uint32_t len);
+
+#endif // _SPI_H
@@ -0,0 +1,11 @@
+#ifndef _SSD1306_H
+#define _SSD1306_H
+
+#include <stdint.h>
+
+#define WIDTH 128
+#define HEIGHT 64
+
+void init_ssd1306(void);
+
+#endif // _SSD1306_H
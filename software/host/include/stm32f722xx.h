@@ -0,0 +1,174 @@
+#ifndef _STM32F722XX_H
+#define _STM32F722XX_H
+
+/*
+    the registers and core functions of the stm32f722 the firmware touches,
+    for the host build. each peripheral is a plain struct in ram, see
+    sim/hw.c. the bits the simulation acts on have their real values, the
+    rest only have to be distinct enough to compile
+*/
+
+#include <stdint.h>
+
+#define __IO volatile
+
+typedef struct {
+    __IO uint32_t CR1, CR2, CR3, BRR, GTPR, RTOR, RQR, ISR, ICR, RDR, TDR;
+} USART_TypeDef;
+
+typedef struct {
+    __IO uint32_t CR, NDTR, PAR, M0AR, M1AR, FCR;
+} DMA_Stream_TypeDef;
+
+typedef struct {
+    __IO uint32_t LISR, HISR, LIFCR, HIFCR;
+} DMA_TypeDef;
+
+typedef struct {
+    __IO uint32_t CR1, CR2, SMCR, DIER, SR, EGR, CCMR1, CCMR2, CCER, CNT, PSC, ARR, RCR, CCR1, CCR2, CCR3, CCR4;
+} TIM_TypeDef;
+
+typedef struct {
+    __IO uint32_t MODER, OTYPER, OSPEEDR, PUPDR, IDR, ODR, BSRR, LCKR, AFR[2];
+} GPIO_TypeDef;
+
+typedef struct {
+    __IO uint32_t CR1, CR2, SR, DR, CRCPR, RXCRCR, TXCRCR;
+} SPI_TypeDef;
+
+typedef struct {
+    __IO uint32_t CR1, CR2, OAR1, OAR2, TIMINGR, TIMEOUTR, ISR, ICR, PECR, RXDR, TXDR;
+} I2C_TypeDef;
+
+typedef struct {
+    __IO uint32_t CR, PLLCFGR, CFGR, CIR, AHB1ENR, APB1ENR, APB2ENR;
+} RCC_TypeDef;
+
+typedef struct {
+    __IO uint32_t IMR, EMR, RTSR, FTSR, SWIER, PR;
+} EXTI_TypeDef;
+
+typedef struct {
+    __IO uint32_t CTRL, CYCCNT, LAR;
+} DWT_Type;
+
+typedef struct {
+    __IO uint32_t DEMCR;
+} CoreDebug_Type;
+
+extern USART_TypeDef *USART1, *USART2, *USART3, *UART4, *USART6;
+extern DMA_TypeDef *DMA1, *DMA2;
+extern DMA_Stream_TypeDef *DMA1_Stream0, *DMA1_Stream1, *DMA1_Stream4, *DMA1_Stream6, *DMA1_Stream7;
+extern DMA_Stream_TypeDef *DMA2_Stream0, *DMA2_Stream2, *DMA2_Stream3, *DMA2_Stream5, *DMA2_Stream6, *DMA2_Stream7;
+extern TIM_TypeDef *TIM2, *TIM3, *TIM4, *TIM5, *TIM6, *TIM7;
+extern GPIO_TypeDef *GPIOA, *GPIOB, *GPIOC, *GPIOD, *GPIOG;
+extern SPI_TypeDef *SPI1;
+extern I2C_TypeDef *I2C1;
+extern RCC_TypeDef *RCC;
+extern EXTI_TypeDef *EXTI;
+extern DWT_Type *DWT;
+extern CoreDebug_Type *CoreDebug;
+
+typedef enum {
+    USART1_IRQn,
+    EXTI15_10_IRQn,
+    TIM2_IRQn,
+    TIM3_IRQn,
+    TIM4_IRQn,
+    TIM5_IRQn,
+    TIM6_DAC_IRQn,
+    TIM7_IRQn,
+    DMA1_Stream0_IRQn,
+    DMA1_Stream1_IRQn,
+    DMA1_Stream4_IRQn,
+    DMA1_Stream6_IRQn,
+    DMA1_Stream7_IRQn,
+    DMA2_Stream0_IRQn,
+    DMA2_Stream2_IRQn,
+    DMA2_Stream3_IRQn,
+    DMA2_Stream5_IRQn,
+    DMA2_Stream6_IRQn,
+    DMA2_Stream7_IRQn,
+    I2C1_EV_IRQn,
+} IRQn_Type;
+
+#define RCC_CFGR_PPRE1_Pos 10
+#define RCC_CFGR_PPRE1 (0x7 << RCC_CFGR_PPRE1_Pos)
+#define RCC_CFGR_PPRE1_DIV1 (0x0 << RCC_CFGR_PPRE1_Pos)
+#define RCC_CFGR_PPRE1_DIV2 (0x4 << RCC_CFGR_PPRE1_Pos)
+#define RCC_CFGR_PPRE1_DIV4 (0x5 << RCC_CFGR_PPRE1_Pos)
+#define RCC_CFGR_PPRE1_DIV8 (0x6 << RCC_CFGR_PPRE1_Pos)
+#define RCC_CFGR_PPRE1_DIV16 (0x7 << RCC_CFGR_PPRE1_Pos)
+
+#define RCC_AHB1ENR_GPIOAEN (1 << 0)
+#define RCC_AHB1ENR_GPIOCEN (1 << 2)
+#define RCC_AHB1ENR_GPIODEN (1 << 3)
+#define RCC_AHB1ENR_DMA1EN (1 << 21)
+#define RCC_AHB1ENR_DMA2EN (1 << 22)
+#define RCC_APB1ENR_TIM2EN (1 << 0)
+#define RCC_APB1ENR_TIM7EN (1 << 5)
+
+#define TIM_CR1_CEN (1 << 0)
+#define TIM_DIER_UIE (1 << 0)
+#define TIM_DIER_CC1IE (1 << 1)
+#define TIM_SR_UIF (1 << 0)
+#define TIM_SR_CC1IF (1 << 1)
+#define TIM_EGR_UG (1 << 0)
+
+#define DMA_SxCR_EN (1 << 0)
+#define DMA_SxCR_TCIE (1 << 4)
+#define DMA_SxCR_DIR_0 (1 << 6)
+#define DMA_SxCR_MINC (1 << 10)
+#define DMA_SxCR_CHSEL_Pos 25
+#define DMA_LISR_TCIF0 (1 << 5)
+
+#define USART_CR3_DMAT (1 << 7)
+#define USART_ISR_ORE (1 << 3)
+#define USART_ISR_RXNE (1 << 5)
+#define USART_ICR_ORECF (1 << 3)
+
+#define SPI_CR2_RXDMAEN (1 << 0)
+#define SPI_CR2_TXDMAEN (1 << 1)
+
+#define I2C_CR1_PE (1 << 0)
+#define I2C_CR1_NACKIE (1 << 4)
+#define I2C_CR1_STOPIE (1 << 5)
+#define I2C_CR1_TXDMAEN (1 << 14)
+#define I2C_CR2_START (1 << 13)
+#define I2C_CR2_NBYTES_Pos 16
+#define I2C_CR2_AUTOEND (1 << 25)
+#define I2C_ISR_NACKF (1 << 4)
+#define I2C_ISR_STOPF (1 << 5)
+#define I2C_ICR_NACKCF (1 << 4)
+#define I2C_ICR_STOPCF (1 << 5)
+
+#define GPIO_MODER_MODER11_Pos 22
+#define GPIO_MODER_MODER12_Pos 24
+#define EXTI_EMR_EM11 (1 << 11)
+#define EXTI_EMR_EM12 (1 << 12)
+#define EXTI_RTSR_TR11 (1 << 11)
+#define EXTI_RTSR_TR12 (1 << 12)
+
+#define CoreDebug_DEMCR_TRCENA_Msk (1 << 24)
+#define DWT_CTRL_CYCCNTENA_Msk (1 << 0)
+
+extern uint32_t SystemCoreClock;
+
+void NVIC_EnableIRQ(IRQn_Type irq);
+void NVIC_DisableIRQ(IRQn_Type irq);
+void NVIC_SetPriority(IRQn_Type irq, uint32_t priority);
+
+void __disable_irq(void);
+void __enable_irq(void);
+uint32_t __get_PRIMASK(void);
+void __set_PRIMASK(uint32_t primask);
+void __DMB(void);
+void __DSB(void);
+
+#define __CLZ __builtin_clz
+
+void SCB_CleanDCache_by_Addr(uint32_t* addr, int32_t len);
+void SCB_InvalidateDCache_by_Addr(uint32_t* addr, int32_t len);
+void SCB_CleanInvalidateDCache_by_Addr(uint32_t* addr, int32_t len);
+
+#endif // _STM32F722XX_H
@@ -0,0 +1,6 @@
+#ifndef _TIMERS_H
+#define _TIMERS_H
+
+#include "FreeRTOS.h"
+
+#endif // _TIMERS_H
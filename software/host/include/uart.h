@@ -0,0 +1,22 @@
+#ifndef _UART_H
+#define _UART_H
+
+#include <stdint.h>
+#include "stm32f722xx.h"
+
+typedef struct {
+    USART_TypeDef* uart;
+    uint32_t baud;
+    GPIO_TypeDef* gpio;
+    uint8_t tx_pin;
+    uint8_t rx_pin;
+    uint8_t afr_reg;
+    uint8_t rx_interrupts;
+    uint8_t afr_mode;
+} USART_Handler;
+
+int init_uart(USART_Handler* h);
+void send_uart(USART_TypeDef* uart, char* s, int len);
+void send_hex(USART_TypeDef* uart, uint32_t n);
+
+#endif // _UART_H
@@ -0,0 +1,11 @@
+#ifndef _W25Q128JV_H
+#define _W25Q128JV_H
+
+#include <stdint.h>
+
+void eraseSector(uint32_t addr);
+void eraseChip(void);
+void programPage(uint32_t addr, uint8_t* tx, uint8_t* rx, uint16_t len);
+void SPIRead(uint32_t addr, uint8_t* tx, uint8_t* rx, uint32_t len);
+
+#endif // _W25Q128JV_H
@@ -0,0 +1,14 @@
+#include <stdint.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "sequence.h"
+#include "common.h"
+
+// what main.c and setup.c define on the target
+MIDISequence_t sequences[CONFIG_TOTAL_SEQUENCES];
+step_t steps[CONFIG_TOTAL_SEQUENCES * CONFIG_STEPS_PER_SEQUENCE];
+TaskHandle_t saveTask;
+TaskHandle_t flashTask;
+TaskHandle_t displayTask;
+
+uint8_t display_buffer[DISPLAY_BUFFER_SIZE];
@@ -0,0 +1,470 @@
+#include <string.h>
+#include "stm32f722xx.h"
+#include "midi_out.h"
+#include "sim.h"
+
+/*
+    the peripherals of the host build. the registers are plain structs the
+    firmware reads and writes as it would the real ones. what the hardware
+    would do on its own, count a timer or move a dma transfer along, is done
+    here as simulated time moves on: sim_hw_next_event() says when the next
+    thing happens and sim_hw_run() moves time on to it and fires the
+    interrupt. a register write takes effect the next time either is called,
+    which is at the same simulated time since time doesn't pass in between
+
+    the board is clocked as the sdk sets it up, 216MHz with APB1 at /4
+*/
+
+uint32_t SystemCoreClock = 216000000;
+
+static USART_TypeDef usart1, usart2, usart3, uart4, usart6;
+static DMA_TypeDef dma1, dma2;
+static DMA_Stream_TypeDef dma1_stream0, dma1_stream1, dma1_stream4, dma1_stream6, dma1_stream7;
+static DMA_Stream_TypeDef dma2_stream0, dma2_stream2, dma2_stream3, dma2_stream5, dma2_stream6, dma2_stream7;
+static TIM_TypeDef tim2, tim3, tim4, tim5, tim6, tim7;
+static GPIO_TypeDef gpioa, gpiob, gpioc, gpiod, gpiog;
+static SPI_TypeDef spi1;
+static I2C_TypeDef i2c1;
+static RCC_TypeDef rcc = {
+    .CFGR = RCC_CFGR_PPRE1_DIV4,
+};
+static EXTI_TypeDef exti;
+static DWT_Type dwt;
+static CoreDebug_Type core_debug;
+
+USART_TypeDef *USART1 = &usart1, *USART2 = &usart2, *USART3 = &usart3, *UART4 = &uart4, *USART6 = &usart6;
+DMA_TypeDef *DMA1 = &dma1, *DMA2 = &dma2;
+DMA_Stream_TypeDef *DMA1_Stream0 = &dma1_stream0, *DMA1_Stream1 = &dma1_stream1, *DMA1_Stream4 = &dma1_stream4;
+DMA_Stream_TypeDef *DMA1_Stream6 = &dma1_stream6, *DMA1_Stream7 = &dma1_stream7;
+DMA_Stream_TypeDef *DMA2_Stream0 = &dma2_stream0, *DMA2_Stream2 = &dma2_stream2, *DMA2_Stream3 = &dma2_stream3;
+DMA_Stream_TypeDef *DMA2_Stream5 = &dma2_stream5, *DMA2_Stream6 = &dma2_stream6, *DMA2_Stream7 = &dma2_stream7;
+TIM_TypeDef *TIM2 = &tim2, *TIM3 = &tim3, *TIM4 = &tim4, *TIM5 = &tim5, *TIM6 = &tim6, *TIM7 = &tim7;
+GPIO_TypeDef *GPIOA = &gpioa, *GPIOB = &gpiob, *GPIOC = &gpioc, *GPIOD = &gpiod, *GPIOG = &gpiog;
+SPI_TypeDef* SPI1 = &spi1;
+I2C_TypeDef* I2C1 = &i2c1;
+RCC_TypeDef* RCC = &rcc;
+EXTI_TypeDef* EXTI = &exti;
+DWT_Type* DWT = &dwt;
+CoreDebug_Type* CoreDebug = &core_debug;
+
+void TIM2_IRQHandler(void);
+void TIM7_IRQHandler(void);
+void DMA2_Stream7_IRQHandler(void);
+void DMA1_Stream6_IRQHandler(void);
+void DMA1_Stream4_IRQHandler(void);
+void DMA2_Stream6_IRQHandler(void);
+void I2C1_EV_IRQHandler(void);
+
+static uint64_t now;
+static uint32_t nvic_enabled;
+static uint32_t primask;
+
+uint64_t sim_now() {
+    return now;
+}
+
+uint64_t sim_cycles_per_us() {
+    return SystemCoreClock / 1000000;
+}
+
+uint64_t sim_us() {
+    return now / sim_cycles_per_us();
+}
+
+void NVIC_EnableIRQ(IRQn_Type irq) {
+    nvic_enabled |= (1UL << irq);
+}
+
+void NVIC_DisableIRQ(IRQn_Type irq) {
+    nvic_enabled &= ~(1UL << irq);
+}
+
+void NVIC_SetPriority(IRQn_Type irq, uint32_t priority) {
+    (void)irq;
+    (void)priority;
+}
+
+static uint8_t irq_enabled(IRQn_Type irq) {
+    return (nvic_enabled >> irq) & 1;
+}
+
+void __disable_irq() {
+    primask = 1;
+}
+
+void __enable_irq() {
+    primask = 0;
+}
+
+uint32_t __get_PRIMASK() {
+    return primask;
+}
+
+void __set_PRIMASK(uint32_t p) {
+    primask = p;
+}
+
+void __DMB() {
+}
+
+void __DSB() {
+}
+
+void SCB_CleanDCache_by_Addr(uint32_t* addr, int32_t len) {
+    (void)addr;
+    (void)len;
+}
+
+void SCB_CleanInvalidateDCache_by_Addr(uint32_t* addr, int32_t len) {
+    (void)addr;
+    (void)len;
+}
+
+/*
+    cpu cycles per tick of the APB1 timer clock. the timers run at twice the
+    bus clock whenever the bus is divided down
+*/
+static uint64_t timer_ratio() {
+    static const uint8_t apb_div[8] = {1, 1, 1, 1, 2, 4, 8, 16};
+    uint8_t div = apb_div[(RCC->CFGR & RCC_CFGR_PPRE1) >> RCC_CFGR_PPRE1_Pos];
+
+    return div == 1 ? 1 : div / 2;
+}
+
+/*
+    a basic or general purpose timer counting up, with its update and
+    channel 1 compare interrupts
+
+    @param phase    cpu cycles into the current count
+*/
+typedef struct {
+    TIM_TypeDef* tim;
+    IRQn_Type irq;
+    void (*handler)(void);
+    uint64_t phase;
+} sim_timer_t;
+
+static sim_timer_t timers[] = {
+    {&tim2, TIM2_IRQn, TIM2_IRQHandler, 0},
+    {&tim7, TIM7_IRQn, TIM7_IRQHandler, 0},
+};
+
+#define NUM_TIMERS (sizeof(timers) / sizeof(timers[0]))
+
+static uint64_t timer_period(TIM_TypeDef* tim) {
+    return (uint64_t)tim->ARR + 1;
+}
+
+static uint64_t cycles_per_count(TIM_TypeDef* tim) {
+    return timer_ratio() * ((uint64_t)tim->PSC + 1);
+}
+
+static void timer_update_event(sim_timer_t* t) {
+    if(t->tim->EGR & TIM_EGR_UG) {
+        t->tim->EGR = 0;
+        t->tim->CNT = 0;
+        t->phase = 0;
+    }
+}
+
+static uint64_t timer_next(sim_timer_t* t) {
+    TIM_TypeDef* tim = t->tim;
+    uint64_t period = timer_period(tim);
+    uint64_t counts = UINT64_MAX;
+
+    timer_update_event(t);
+
+    if(!(tim->CR1 & TIM_CR1_CEN)) {
+        return UINT64_MAX;
+    }
+
+    if(tim->DIER & TIM_DIER_CC1IE) {
+        uint64_t d = ((uint64_t)tim->CCR1 - tim->CNT) % period;
+        counts = d ? d : period;
+    }
+
+    if(tim->DIER & TIM_DIER_UIE) {
+        uint64_t d = period - tim->CNT;
+        counts = d < counts ? d : counts;
+    }
+
+    if(counts == UINT64_MAX) {
+        return UINT64_MAX;
+    }
+
+    return now + (counts * cycles_per_count(tim)) - t->phase;
+}
+
+static void timer_advance(sim_timer_t* t, uint64_t cycles) {
+    TIM_TypeDef* tim = t->tim;
+
+    timer_update_event(t);
+
+    if(!(tim->CR1 & TIM_CR1_CEN)) {
+        return;
+    }
+
+    uint64_t period = timer_period(tim);
+    uint64_t cpc = cycles_per_count(tim);
+    uint64_t total = t->phase + cycles;
+    uint64_t counts = total / cpc;
+
+    t->phase = total % cpc;
+
+    if(counts == 0) {
+        return;
+    }
+
+    uint64_t d = ((uint64_t)tim->CCR1 - tim->CNT) % period;
+    if((d ? d : period) <= counts) {
+        tim->SR |= TIM_SR_CC1IF;
+    }
+
+    uint64_t cnt = tim->CNT + counts;
+    if(cnt >= period) {
+        tim->SR |= TIM_SR_UIF;
+    }
+
+    tim->CNT = cnt % period;
+}
+
+static void timer_fire(sim_timer_t* t) {
+    TIM_TypeDef* tim = t->tim;
+
+    if((tim->SR & tim->DIER & (TIM_SR_UIF | TIM_SR_CC1IF)) && irq_enabled(t->irq)) {
+        t->handler();
+    }
+}
+
+/*
+    a dma stream feeding one of the midi uarts. a transfer goes out at
+    31250 baud and raises transfer complete once its last byte is on the wire.
+    every transfer is recorded with when it started and finished
+*/
+#define SIM_MIDI_TRANSFERS 16384
+#define SIM_MIDI_BYTES (1024 * 1024)
+
+typedef struct {
+    DMA_Stream_TypeDef* stream;
+    DMA_TypeDef* dma;
+    uint32_t tc;
+    IRQn_Type irq;
+    void (*handler)(void);
+
+    uint8_t busy;
+    uint64_t end;
+
+    uint32_t transfers;
+    sim_tx_t tx[SIM_MIDI_TRANSFERS];
+    uint32_t bytes;
+    uint8_t data[SIM_MIDI_BYTES];
+} sim_midi_dma_t;
+
+static sim_midi_dma_t midi_dma[NUM_MIDI_PORTS] = {
+    {
+        .stream = &dma2_stream7,
+        .dma = &dma2,
+        .tc = 0x20 << 22,
+        .irq = DMA2_Stream7_IRQn,
+        .handler = DMA2_Stream7_IRQHandler,
+    },
+    {
+        .stream = &dma1_stream6,
+        .dma = &dma1,
+        .tc = 0x20 << 16,
+        .irq = DMA1_Stream6_IRQn,
+        .handler = DMA1_Stream6_IRQHandler,
+    },
+    {
+        .stream = &dma1_stream4,
+        .dma = &dma1,
+        .tc = 0x20 << 0,
+        .irq = DMA1_Stream4_IRQn,
+        .handler = DMA1_Stream4_IRQHandler,
+    },
+    {
+        .stream = &dma2_stream6,
+        .dma = &dma2,
+        .tc = 0x20 << 16,
+        .irq = DMA2_Stream6_IRQn,
+        .handler = DMA2_Stream6_IRQHandler,
+    },
+};
+
+// interrupt flag clear registers take effect as soon as they are written
+static void clear_dma_flags() {
+    DMA_TypeDef* dmas[2] = {&dma1, &dma2};
+
+    for(uint8_t i = 0; i < 2; i++) {
+        dmas[i]->LISR &= ~dmas[i]->LIFCR;
+        dmas[i]->HISR &= ~dmas[i]->HIFCR;
+        dmas[i]->LIFCR = 0;
+        dmas[i]->HIFCR = 0;
+    }
+}
+
+static void midi_dma_start(sim_midi_dma_t* d) {
+    DMA_Stream_TypeDef* s = d->stream;
+
+    if(d->busy || !(s->CR & DMA_SxCR_EN)) {
+        return;
+    }
+
+    uint16_t len = s->NDTR;
+    sim_tx_t* tx = &d->tx[d->transfers % SIM_MIDI_TRANSFERS];
+
+    tx->start_us = now / sim_cycles_per_us();
+    tx->end_us = tx->start_us + ((uint64_t)len * MIDI_OUT_BYTE_US);
+    tx->offset = d->bytes;
+    tx->len = len;
+
+    for(uint16_t i = 0; i < len; i++) {
+        d->data[(d->bytes + i) % SIM_MIDI_BYTES] = ((uint8_t*)(uintptr_t)s->M0AR)[i];
+    }
+
+    d->bytes += len;
+    d->transfers++;
+
+    d->busy = 1;
+    d->end = now + ((uint64_t)len * MIDI_OUT_BYTE_US * sim_cycles_per_us());
+}
+
+static void midi_dma_fire(sim_midi_dma_t* d) {
+    if(!d->busy || now < d->end) {
+        return;
+    }
+
+    d->busy = 0;
+    d->stream->NDTR = 0;
+    d->stream->CR &= ~DMA_SxCR_EN;
+    d->dma->HISR |= d->tc;
+
+    if((d->stream->CR & DMA_SxCR_TCIE) && irq_enabled(d->irq)) {
+        d->handler();
+        clear_dma_flags();
+    }
+}
+
+/*
+    the display's i2c bus at 400kHz, fed by DMA1 stream 7. a transfer raises
+    stop once every byte is sent
+*/
+#define SIM_I2C_BYTE_CYCLES(c) ((uint64_t)(c) * 9 / 400000)
+
+static uint8_t i2c_busy;
+static uint64_t i2c_end;
+
+static void i2c_start() {
+    if(i2c_busy || !(i2c1.CR2 & I2C_CR2_START) || !(i2c1.CR1 & I2C_CR1_PE)) {
+        return;
+    }
+
+    uint32_t len = (i2c1.CR2 >> I2C_CR2_NBYTES_Pos) & 0xFF;
+
+    i2c1.CR2 &= ~I2C_CR2_START;
+    i2c_busy = 1;
+    i2c_end = now + ((len + 1) * SIM_I2C_BYTE_CYCLES(SystemCoreClock));
+}
+
+static void i2c_fire() {
+    if(!i2c_busy || now < i2c_end) {
+        return;
+    }
+
+    i2c_busy = 0;
+    dma1_stream7.CR &= ~DMA_SxCR_EN;
+    i2c1.ISR |= I2C_ISR_STOPF;
+
+    if((i2c1.CR1 & I2C_CR1_STOPIE) && irq_enabled(I2C1_EV_IRQn)) {
+        I2C1_EV_IRQHandler();
+    }
+
+    i2c1.ISR &= ~i2c1.ICR;
+    i2c1.ICR = 0;
+}
+
+// pick up whatever the firmware started since time last moved
+static void start_transfers() {
+    clear_dma_flags();
+
+    for(uint8_t i = 0; i < NUM_MIDI_PORTS; i++) {
+        midi_dma_start(&midi_dma[i]);
+    }
+
+    i2c_start();
+}
+
+uint64_t sim_hw_next_event() {
+    uint64_t next = UINT64_MAX;
+
+    start_transfers();
+
+    for(uint8_t i = 0; i < NUM_TIMERS; i++) {
+        uint64_t t = timer_next(&timers[i]);
+        next = t < next ? t : next;
+    }
+
+    for(uint8_t i = 0; i < NUM_MIDI_PORTS; i++) {
+        if(midi_dma[i].busy && midi_dma[i].end < next) {
+            next = midi_dma[i].end;
+        }
+    }
+
+    if(i2c_busy && i2c_end < next) {
+        next = i2c_end;
+    }
+
+    return next;
+}
+
+static void move_to(uint64_t t) {
+    for(uint8_t i = 0; i < NUM_TIMERS; i++) {
+        timer_advance(&timers[i], t - now);
+    }
+
+    now = t;
+}
+
+/*
+    move simulated time on to until, firing every interrupt that falls due on
+    the way in the order they fall due
+*/
+void sim_hw_run(uint64_t until) {
+    while(1) {
+        uint64_t next = sim_hw_next_event();
+
+        if(next > until) {
+            break;
+        }
+
+        move_to(next);
+
+        for(uint8_t i = 0; i < NUM_TIMERS; i++) {
+            timer_fire(&timers[i]);
+        }
+
+        for(uint8_t i = 0; i < NUM_MIDI_PORTS; i++) {
+            midi_dma_fire(&midi_dma[i]);
+        }
+
+        i2c_fire();
+    }
+
+    if(until > now) {
+        move_to(until);
+    }
+
+    start_transfers();
+}
+
+uint32_t sim_midi_transfers(uint8_t port) {
+    return midi_dma[port].transfers;
+}
+
+const sim_tx_t* sim_midi_transfer(uint8_t port, uint32_t i) {
+    return &midi_dma[port].tx[i % SIM_MIDI_TRANSFERS];
+}
+
+const uint8_t* sim_midi_bytes(uint8_t port) {
+    return midi_dma[port].data;
+}
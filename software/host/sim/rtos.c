@@ -0,0 +1,554 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ucontext.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include "semphr.h"
+#include "sim.h"
+#include "stm32f722xx.h"
+
+/*
+    the kernel of the host build. every task runs on its own stack on the one
+    host thread and is switched to with swapcontext, so only one runs at a
+    time and a switch only happens where FreeRTOS could switch on the target:
+    when a task blocks, or when it readies a task of higher priority.
+    interrupts are fired by sim/hw.c as simulated time moves on, which it
+    only does while every task is blocked or a peripheral is being driven.
+
+    the code that calls into the firmware first, a test's main(), is a task
+    of priority 0 in its own right. until sim_start() it is the only one that
+    runs
+*/
+
+#define SIM_STACK_SIZE (256 * 1024)
+
+#define WAIT_NONE 0
+#define WAIT_TAKE 1
+#define WAIT_NOTIFY 2
+#define WAIT_RECEIVE 3
+#define WAIT_SEND 4
+#define WAIT_DELAY 5
+
+#define TASK_READY 0
+#define TASK_DELETED 1
+
+#define SIM_MAX_TASKS 16
+
+struct sim_task {
+    const char* name;
+    void (*fn)(void*);
+    void* param;
+    UBaseType_t priority;
+    ucontext_t ctx;
+    uint8_t state;
+
+    uint32_t notify_value;
+    uint8_t notified;
+
+    uint8_t wait;
+    struct sim_queue* queue;
+    uint64_t wake;
+    uint64_t order;
+};
+
+struct sim_queue {
+    UBaseType_t length;
+    UBaseType_t item_size;
+    UBaseType_t count;
+    UBaseType_t head;
+    uint8_t* items;
+};
+
+static struct sim_task main_task = {
+    .name = "main",
+    .priority = 0,
+};
+
+static struct sim_task* tasks[SIM_MAX_TASKS] = {&main_task};
+static uint8_t num_tasks = 1;
+static struct sim_task* current = &main_task;
+
+static uint8_t started;
+static uint32_t suspended;
+static uint64_t order;
+
+static uint64_t cycles_per_tick() {
+    return SystemCoreClock / configTICK_RATE_HZ;
+}
+
+static uint8_t waiting_on(struct sim_task* t) {
+    switch(t->wait) {
+        case WAIT_TAKE:
+            return t->notify_value == 0;
+        case WAIT_NOTIFY:
+            return !t->notified;
+        case WAIT_RECEIVE:
+            return t->queue->count == 0;
+        case WAIT_SEND:
+            return t->queue->count == t->queue->length;
+        case WAIT_DELAY:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+static uint8_t runnable(struct sim_task* t) {
+    if(t->state == TASK_DELETED) {
+        return 0;
+    }
+
+    if(!started && t != &main_task) {
+        return 0;
+    }
+
+    return !waiting_on(t) || sim_now() >= t->wake;
+}
+
+/*
+    the highest priority task that can run. of those at the same priority the
+    one that has gone longest without running goes first
+
+    @param above    only tasks of a higher priority than this are looked at
+*/
+static struct sim_task* pick(int32_t above) {
+    struct sim_task* best = NULL;
+
+    for(uint8_t i = 0; i < num_tasks; i++) {
+        struct sim_task* t = tasks[i];
+
+        if(!runnable(t) || (int32_t)t->priority <= above) {
+            continue;
+        }
+
+        if(!best || t->priority > best->priority || (t->priority == best->priority && t->order < best->order)) {
+            best = t;
+        }
+    }
+
+    return best;
+}
+
+static void switch_to(struct sim_task* next) {
+    if(next == current) {
+        return;
+    }
+
+    struct sim_task* prev = current;
+    current = next;
+    swapcontext(&prev->ctx, &next->ctx);
+}
+
+static void stall() {
+    fprintf(stderr, "sim: every task is blocked and nothing is left to wake them\n");
+
+    for(uint8_t i = 0; i < num_tasks; i++) {
+        fprintf(stderr, "  %s wait %u state %u\n", tasks[i]->name, tasks[i]->wait, tasks[i]->state);
+    }
+
+    abort();
+}
+
+// the next interrupt or timeout that can change which task runs
+static uint64_t next_event() {
+    uint64_t until = sim_hw_next_event();
+
+    for(uint8_t i = 0; i < num_tasks; i++) {
+        struct sim_task* t = tasks[i];
+
+        if(t->state != TASK_DELETED && t->wait != WAIT_NONE && t->wake > sim_now() && t->wake < until) {
+            until = t->wake;
+        }
+    }
+
+    return until;
+}
+
+/*
+    run whatever can run. time is moved on to the next interrupt or timeout
+    only when nothing can
+*/
+static void schedule() {
+    while(1) {
+        struct sim_task* next = pick(-1);
+
+        if(next) {
+            switch_to(next);
+            return;
+        }
+
+        uint64_t until = next_event();
+
+        if(until == UINT64_MAX) {
+            stall();
+        }
+
+        sim_hw_run(until);
+    }
+}
+
+/*
+    block the current task until what it waits on is there or the time is up
+
+    @return 1 if it is there, 0 on a timeout
+*/
+static uint8_t block_until(uint8_t wait, struct sim_queue* q, uint64_t wake) {
+    current->wait = wait;
+    current->queue = q;
+    current->wake = wake;
+    current->order = ++order;
+
+    schedule();
+
+    uint8_t ready = !waiting_on(current);
+    current->wait = WAIT_NONE;
+
+    return ready;
+}
+
+static uint8_t block(uint8_t wait, struct sim_queue* q, TickType_t ticks) {
+    uint64_t wake = UINT64_MAX;
+
+    if(ticks != portMAX_DELAY) {
+        wake = sim_now() + ((uint64_t)ticks * cycles_per_tick());
+    }
+
+    return block_until(wait, q, wake);
+}
+
+/*
+    give the processor to a task of higher priority than the current one if
+    one can now run, as FreeRTOS does straight after the call that readied it
+*/
+static void preempt() {
+    if(!started || suspended) {
+        return;
+    }
+
+    struct sim_task* next = pick(current->priority);
+
+    if(next) {
+        current->order = ++order;
+        switch_to(next);
+    }
+}
+
+static uint64_t now_ticks() {
+    return sim_now() / cycles_per_tick();
+}
+
+void sim_start() {
+    started = 1;
+    preempt();
+}
+
+void sim_run_us(uint64_t us) {
+    block_until(WAIT_DELAY, NULL, sim_now() + (us * sim_cycles_per_us()));
+}
+
+/*
+    time is moved on an event at a time, so a higher priority task woken part
+    way through runs from that moment and the rest of the cycles are spent
+    once the current task runs again
+*/
+void sim_advance(uint64_t cycles) {
+    while(cycles) {
+        uint64_t step = next_event() - sim_now();
+
+        if(step > cycles) {
+            step = cycles;
+        }
+
+        sim_hw_run(sim_now() + step);
+        cycles -= step;
+        preempt();
+    }
+}
+
+static void task_entry() {
+    current->fn(current->param);
+    vTaskDelete(NULL);
+}
+
+BaseType_t xTaskCreate(void (*task)(void*), const char* name, uint16_t stack, void* param, UBaseType_t priority, TaskHandle_t* handle) {
+    (void)stack;
+
+    if(num_tasks >= SIM_MAX_TASKS) {
+        return pdFAIL;
+    }
+
+    struct sim_task* t = calloc(1, sizeof(*t));
+    t->name = name;
+    t->fn = task;
+    t->param = param;
+    t->priority = priority;
+    t->order = ++order;
+
+    getcontext(&t->ctx);
+    t->ctx.uc_stack.ss_sp = malloc(SIM_STACK_SIZE);
+    t->ctx.uc_stack.ss_size = SIM_STACK_SIZE;
+    t->ctx.uc_link = NULL;
+    makecontext(&t->ctx, task_entry, 0);
+
+    tasks[num_tasks++] = t;
+
+    if(handle) {
+        *handle = t;
+    }
+
+    preempt();
+
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task) {
+    struct sim_task* t = task ? task : current;
+
+    t->state = TASK_DELETED;
+
+    if(t == current) {
+        schedule();
+    }
+}
+
+// never returns, like the real one
+void vTaskStartScheduler() {
+    sim_start();
+    block_until(WAIT_DELAY, NULL, UINT64_MAX);
+    stall();
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+    return current;
+}
+
+BaseType_t xTaskGetSchedulerState() {
+    if(!started) {
+        return taskSCHEDULER_NOT_STARTED;
+    }
+
+    return suspended ? taskSCHEDULER_SUSPENDED : taskSCHEDULER_RUNNING;
+}
+
+TickType_t xTaskGetTickCount() {
+    return (TickType_t)now_ticks();
+}
+
+TickType_t xTaskGetTickCountFromISR() {
+    return (TickType_t)now_ticks();
+}
+
+void vTaskDelay(TickType_t ticks) {
+    block(WAIT_DELAY, NULL, ticks);
+}
+
+void vTaskDelayUntil(TickType_t* previous, TickType_t ticks) {
+    *previous += ticks;
+    block_until(WAIT_DELAY, NULL, (uint64_t)*previous * cycles_per_tick());
+}
+
+void vTaskSuspendAll() {
+    suspended++;
+}
+
+BaseType_t xTaskResumeAll() {
+    suspended--;
+    preempt();
+
+    return pdFALSE;
+}
+
+static void notify(TaskHandle_t task, uint32_t value, eNotifyAction action) {
+    switch(action) {
+        case eSetBits:
+            task->notify_value |= value;
+            break;
+        case eIncrement:
+            task->notify_value++;
+            break;
+        case eSetValueWithOverwrite:
+            task->notify_value = value;
+            break;
+        case eSetValueWithoutOverwrite:
+            if(!task->notified) {
+                task->notify_value = value;
+            }
+            break;
+        default:
+            break;
+    }
+
+    task->notified = 1;
+}
+
+// a task that was never created is left alone rather than crashing the run
+BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action) {
+    if(!task) {
+        return pdFAIL;
+    }
+
+    notify(task, value, action);
+    preempt();
+
+    return pdPASS;
+}
+
+BaseType_t xTaskNotifyFromISR(TaskHandle_t task, uint32_t value, eNotifyAction action, BaseType_t* woken) {
+    if(task) {
+        notify(task, value, action);
+    }
+
+    if(woken) {
+        *woken = pdFALSE;
+    }
+
+    return pdPASS;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    return xTaskNotify(task, 0, eIncrement);
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t* woken) {
+    xTaskNotifyFromISR(task, 0, eIncrement, woken);
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t wait) {
+    if(current->notify_value == 0) {
+        block(WAIT_TAKE, NULL, wait);
+    }
+
+    uint32_t value = current->notify_value;
+
+    if(value) {
+        current->notify_value = clear ? 0 : value - 1;
+    }
+
+    current->notified = 0;
+
+    return value;
+}
+
+BaseType_t xTaskNotifyWait(uint32_t clear_on_entry, uint32_t clear_on_exit, uint32_t* value, TickType_t wait) {
+    if(!current->notified) {
+        current->notify_value &= ~clear_on_entry;
+        block(WAIT_NOTIFY, NULL, wait);
+    }
+
+    if(value) {
+        *value = current->notify_value;
+    }
+
+    if(!current->notified) {
+        return pdFALSE;
+    }
+
+    current->notify_value &= ~clear_on_exit;
+    current->notified = 0;
+
+    return pdTRUE;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size) {
+    struct sim_queue* q = calloc(1, sizeof(*q));
+
+    q->length = length;
+    q->item_size = item_size;
+    q->items = calloc(length, item_size ? item_size : 1);
+
+    return q;
+}
+
+static void put(struct sim_queue* q, const void* item) {
+    UBaseType_t tail = (q->head + q->count) % q->length;
+
+    if(q->item_size) {
+        memcpy(&q->items[tail * q->item_size], item, q->item_size);
+    }
+
+    q->count++;
+}
+
+static void get(struct sim_queue* q, void* item) {
+    if(q->item_size && item) {
+        memcpy(item, &q->items[q->head * q->item_size], q->item_size);
+    }
+
+    q->head = (q->head + 1) % q->length;
+    q->count--;
+}
+
+BaseType_t xQueueSend(QueueHandle_t q, const void* item, TickType_t wait) {
+    if(q->count == q->length && (wait == 0 || !block(WAIT_SEND, q, wait))) {
+        return pdFALSE;
+    }
+
+    put(q, item);
+    preempt();
+
+    return pdTRUE;
+}
+
+BaseType_t xQueueSendToBack(QueueHandle_t q, const void* item, TickType_t wait) {
+    return xQueueSend(q, item, wait);
+}
+
+BaseType_t xQueueSendFromISR(QueueHandle_t q, const void* item, BaseType_t* woken) {
+    if(woken) {
+        *woken = pdFALSE;
+    }
+
+    if(q->count == q->length) {
+        return pdFALSE;
+    }
+
+    put(q, item);
+
+    return pdTRUE;
+}
+
+BaseType_t xQueueSendToBackFromISR(QueueHandle_t q, const void* item, BaseType_t* woken) {
+    return xQueueSendFromISR(q, item, woken);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t q, void* item, TickType_t wait) {
+    if(q->count == 0 && (wait == 0 || !block(WAIT_RECEIVE, q, wait))) {
+        return pdFALSE;
+    }
+
+    get(q, item);
+    preempt();
+
+    return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q) {
+    return q->count;
+}
+
+// no priority inheritance, nothing in the firmware relies on it
+SemaphoreHandle_t xSemaphoreCreateMutex() {
+    struct sim_queue* q = xQueueCreate(1, 0);
+    q->count = 1;
+
+    return q;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary() {
+    return xQueueCreate(1, 0);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t s, TickType_t wait) {
+    return xQueueReceive(s, NULL, wait);
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t s) {
+    return xQueueSend(s, NULL, 0);
+}
+
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t s, BaseType_t* woken) {
+    return xQueueSendFromISR(s, NULL, woken);
+}
@@ -0,0 +1,104 @@
+#include <stdio.h>
+#include <string.h>
+#include "stm32f722xx.h"
+#include "uart.h"
+#include "midi.h"
+#include "k_buf.h"
+#include "i2c.h"
+#include "ssd1306.h"
+#include "sim.h"
+
+/*
+    the sdk drivers the firmware calls directly. the debug uart is collected
+    in memory for the tests to look at, the midi senders write nothing as the
+    firmware's midi output goes through midi_out.c and the dma
+*/
+
+#define SIM_DEBUG_BYTES (1024 * 1024)
+
+static char debug[SIM_DEBUG_BYTES];
+static uint32_t debug_len;
+
+int init_uart(USART_Handler* h) {
+    (void)h;
+
+    return 0;
+}
+
+void send_uart(USART_TypeDef* uart, char* s, int len) {
+    if(uart != USART3) {
+        return;
+    }
+
+    for(int i = 0; i < len && debug_len < SIM_DEBUG_BYTES - 1; i++) {
+        debug[debug_len++] = s[i];
+    }
+}
+
+void send_hex(USART_TypeDef* uart, uint32_t n) {
+    char s[11];
+    int len = snprintf(s, sizeof(s), "0x%02X", (unsigned)n);
+
+    send_uart(uart, s, len);
+}
+
+const char* sim_debug_output() {
+    debug[debug_len] = '\0';
+
+    return debug;
+}
+
+void send_midi_note(USART_TypeDef* uart, MIDIPacket_t* p) {
+    (void)uart;
+    (void)p;
+}
+
+void send_midi_control(USART_TypeDef* uart, MIDICC_t* cc) {
+    (void)uart;
+    (void)cc;
+}
+
+void all_channels_off(USART_TypeDef* uart) {
+    (void)uart;
+}
+
+kbuf_handle_t kbuf_init(uint8_t* buffer, uint8_t size) {
+    static k_buf_t k;
+
+    k.buffer = buffer;
+    k.max = size;
+    kbuf_reset(&k);
+
+    return &k;
+}
+
+void kbuf_reset(kbuf_handle_t k) {
+    k->size = 0;
+    k->ready = 0;
+}
+
+void kbuf_push(kbuf_handle_t k, uint8_t data) {
+    if(k->size < k->max) {
+        k->buffer[k->size++] = data;
+    }
+
+    k->ready = k->size == k->max;
+}
+
+uint8_t kbuf_size(kbuf_handle_t k) {
+    return k->size;
+}
+
+uint8_t kbuf_empty(kbuf_handle_t k) {
+    return k->size == 0;
+}
+
+uint8_t kbuf_ready(kbuf_handle_t k) {
+    return k->ready;
+}
+
+void init_i2c() {
+}
+
+void init_ssd1306() {
+}
@@ -0,0 +1,305 @@
+#define _GNU_SOURCE
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "stm32f722xx.h"
+#include "spi.h"
+#include "w25q128jv.h"
+#include "sim.h"
+
+/*
+    the W25Q128JV on SPI1, as flash.c drives it: instructions clocked in
+    between chip select low and high, the busy and suspend bits of the status
+    registers, and fast read data moved by DMA2 stream 0. a program can only
+    clear bits and an erase sets a whole sector back to 0xFF, as on the chip.
+    programs and erases take their typical datasheet times
+
+    the array and the counts of programs and erases live in memory shared with
+    any process forked off, and the power can be cut in the middle of any
+    program or erase. a cut program has written only the first half of its
+    bytes and a cut erase has only erased the first half of its sector, then
+    the process exits with SIM_POWER_CUT
+*/
+
+#define SIM_FLASH_SIZE (16 * 1024 * 1024)
+#define SIM_FLASH_SECTOR 0x1000
+#define SIM_FLASH_PAGE 0x100
+
+// the spi is clocked at 13.5MHz
+#define SIM_SPI_BYTE_CYCLES 128
+
+#define SIM_PROGRAM_US 400
+#define SIM_SECTOR_ERASE_US 45000
+#define SIM_CHIP_ERASE_US 40000000
+
+#define FLASH_CS_GPIO GPIOA
+#define FLASH_CS_PIN 4
+
+typedef struct {
+    uint8_t array[SIM_FLASH_SIZE];
+    uint32_t ops;
+    uint32_t programs;
+    uint32_t erases;
+} sim_flash_t;
+
+static sim_flash_t* flash;
+static uint32_t cut_after;
+
+static uint8_t selected;
+static uint8_t cmd;
+static uint32_t count;
+static uint32_t addr;
+
+static uint8_t page[SIM_FLASH_PAGE];
+static uint16_t page_len;
+
+static uint8_t write_enabled;
+static uint64_t busy_until;
+static uint8_t suspended;
+static uint64_t suspended_left;
+
+static uint8_t fast_read;
+static uint32_t fast_read_addr;
+
+__attribute__((constructor)) static void sim_flash_map() {
+    flash = mmap(NULL, sizeof(sim_flash_t), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    memset(flash->array, 0xFF, SIM_FLASH_SIZE);
+}
+
+uint8_t* sim_flash_image() {
+    return flash->array;
+}
+
+uint32_t sim_flash_ops() {
+    return flash->ops;
+}
+
+uint32_t sim_flash_programs() {
+    return flash->programs;
+}
+
+uint32_t sim_flash_erases() {
+    return flash->erases;
+}
+
+/*
+    cut the power part way through a program or erase
+
+    @param ops  number of programs and erases, counted from now, that complete
+                before the one that is cut
+*/
+void sim_flash_cut_after(uint32_t ops) {
+    cut_after = flash->ops + ops + 1;
+}
+
+// count a program or erase, true if this is the one the power is cut in
+static uint8_t power_cut() {
+    flash->ops++;
+
+    return cut_after && flash->ops == cut_after;
+}
+
+static uint8_t busy() {
+    return sim_now() < busy_until;
+}
+
+static void program() {
+    uint32_t base = addr & ~(SIM_FLASH_PAGE - 1);
+    uint16_t len = page_len;
+
+    flash->programs++;
+
+    if(power_cut()) {
+        len /= 2;
+    }
+
+    // the address wraps within the page as on the chip
+    for(uint16_t i = 0; i < len; i++) {
+        uint32_t a = base + ((addr + i) & (SIM_FLASH_PAGE - 1));
+        flash->array[a % SIM_FLASH_SIZE] &= page[i];
+    }
+
+    if(len != page_len) {
+        _exit(SIM_POWER_CUT);
+    }
+
+    busy_until = sim_now() + (SIM_PROGRAM_US * sim_cycles_per_us());
+}
+
+static void erase_sector() {
+    uint32_t base = (addr & ~(SIM_FLASH_SECTOR - 1)) % SIM_FLASH_SIZE;
+
+    flash->erases++;
+
+    if(power_cut()) {
+        memset(&flash->array[base], 0xFF, SIM_FLASH_SECTOR / 2);
+        _exit(SIM_POWER_CUT);
+    }
+
+    memset(&flash->array[base], 0xFF, SIM_FLASH_SECTOR);
+    busy_until = sim_now() + (SIM_SECTOR_ERASE_US * sim_cycles_per_us());
+}
+
+static void erase_chip() {
+    flash->erases++;
+
+    if(power_cut()) {
+        memset(flash->array, 0xFF, SIM_FLASH_SIZE / 2);
+        _exit(SIM_POWER_CUT);
+    }
+
+    memset(flash->array, 0xFF, SIM_FLASH_SIZE);
+    busy_until = sim_now() + ((uint64_t)SIM_CHIP_ERASE_US * sim_cycles_per_us());
+}
+
+static uint8_t clock_byte(uint8_t tx) {
+    uint32_t n = count++;
+
+    if(n == 0) {
+        cmd = tx;
+        page_len = 0;
+        addr = 0;
+
+        switch(cmd) {
+            case 0x06:
+                write_enabled = 1;
+                break;
+            case 0x75:
+                if(busy()) {
+                    suspended_left = busy_until - sim_now();
+                    busy_until = 0;
+                    suspended = 1;
+                }
+                break;
+            case 0x7A:
+                if(suspended) {
+                    busy_until = sim_now() + suspended_left;
+                    suspended = 0;
+                }
+                break;
+            default:
+                break;
+        }
+
+        return 0xFF;
+    }
+
+    switch(cmd) {
+        case 0x05:
+            return (busy() ? 0x01 : 0x00) | (write_enabled ? 0x02 : 0x00);
+        case 0x35:
+            return suspended ? 0x80 : 0x00;
+        case 0x9F:
+            return n == 1 ? 0xEF : (n == 2 ? 0x40 : 0x18);
+        default:
+            break;
+    }
+
+    if(n <= 3) {
+        addr = (addr << 8) | tx;
+        return 0xFF;
+    }
+
+    switch(cmd) {
+        case 0x03:
+            return flash->array[(addr + n - 4) % SIM_FLASH_SIZE];
+        case 0x0B:
+            // the data phase is moved by dma, see SCB_InvalidateDCache_by_Addr()
+            fast_read = 1;
+            fast_read_addr = addr;
+            DMA2->LISR |= DMA_LISR_TCIF0;
+            return 0xFF;
+        case 0x02:
+            if(page_len < SIM_FLASH_PAGE) {
+                page[page_len++] = tx;
+            }
+            return 0xFF;
+        default:
+            return 0xFF;
+    }
+}
+
+void CS_low(GPIO_TypeDef* gpio, uint8_t pin) {
+    if(gpio == FLASH_CS_GPIO && pin == FLASH_CS_PIN) {
+        selected = 1;
+        count = 0;
+    }
+}
+
+// a program or erase starts once chip select goes high
+void CS_high(GPIO_TypeDef* gpio, uint8_t pin) {
+    if(gpio != FLASH_CS_GPIO || pin != FLASH_CS_PIN || !selected) {
+        return;
+    }
+
+    selected = 0;
+
+    if(!write_enabled || busy() || suspended) {
+        return;
+    }
+
+    if(cmd == 0x02 && count > 4) {
+        program();
+    } else if(cmd == 0x20 && count == 4) {
+        erase_sector();
+    } else if(cmd == 0xC7 && count == 1) {
+        erase_chip();
+    } else {
+        return;
+    }
+
+    write_enabled = 0;
+}
+
+/*
+    the bytes are clocked through the chip together, then the time they take
+    is spent. a higher priority task woken part way through runs from then
+    on, as it would on the chip
+*/
+void SPI_tx_rx(SPI_TypeDef* spi, uint8_t* tx, uint8_t* rx, uint32_t len) {
+    (void)spi;
+
+    for(uint32_t i = 0; i < len; i++) {
+        uint8_t b = selected ? clock_byte(tx[i]) : 0xFF;
+
+        if(rx) {
+            rx[i] = b;
+        }
+    }
+
+    sim_advance((uint64_t)len * SIM_SPI_BYTE_CYCLES);
+}
+
+// the sdk driver's read, which flash.c uses for FLASH_OP_READ
+void SPIRead(uint32_t a, uint8_t* tx, uint8_t* rx, uint32_t len) {
+    uint8_t cmd[4] = {0x03, (a >> 16) & 0xFF, (a >> 8) & 0xFF, a & 0xFF};
+
+    CS_low(FLASH_CS_GPIO, FLASH_CS_PIN);
+    SPI_tx_rx(SPI1, cmd, NULL, sizeof(cmd));
+    SPI_tx_rx(SPI1, tx, rx, len);
+    CS_high(FLASH_CS_GPIO, FLASH_CS_PIN);
+}
+
+int init_spi(SPI_Handler* h) {
+    (void)h;
+
+    return 0;
+}
+
+/*
+    the cpu sees what the dma wrote once the lines are invalidated, so the
+    data of a fast read is copied into place here
+*/
+void SCB_InvalidateDCache_by_Addr(uint32_t* rx, int32_t len) {
+    if(!fast_read) {
+        return;
+    }
+
+    for(int32_t i = 0; i < len; i++) {
+        ((uint8_t*)rx)[i] = flash->array[(fast_read_addr + i) % SIM_FLASH_SIZE];
+    }
+
+    fast_read = 0;
+
+    sim_advance((uint64_t)len * SIM_SPI_BYTE_CYCLES);
+}
@@ -0,0 +1,70 @@
+#ifndef _TEST_H
+#define _TEST_H
+
+/*
+    the checks the host tests are written with. a failed check is printed and
+    counted, the test carries on and exits with 1 if any failed
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+static int test_failures;
+
+#define CHECK(c) do { \
+    if(!(c)) { \
+        fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #c); \
+        test_failures++; \
+    } \
+} while(0)
+
+#define CHECK_EQ(a, b) do { \
+    long long _a = (long long)(a); \
+    long long _b = (long long)(b); \
+    if(_a != _b) { \
+        fprintf(stderr, "%s:%d: %s == %s, %lld != %lld\n", __FILE__, __LINE__, #a, #b, _a, _b); \
+        test_failures++; \
+    } \
+} while(0)
+
+static inline int test_result() {
+    if(test_failures) {
+        fprintf(stderr, "%d checks failed\n", test_failures);
+    }
+
+    return test_failures ? 1 : 0;
+}
+
+/*
+    run fn in a child process, which starts from a copy of this one with the
+    firmware untouched if this process hasn't run it
+
+    @return the exit status of the child, or -1 if it didn't exit
+*/
+static inline int test_fork(int (*fn)(void*), void* arg) {
+    fflush(stdout);
+    fflush(stderr);
+
+    pid_t pid = fork();
+
+    if(pid == 0) {
+        int ret = fn(arg);
+
+        fflush(stdout);
+        fflush(stderr);
+        _exit(ret);
+    }
+
+    int status;
+    waitpid(pid, &status, 0);
+
+    if(WIFSIGNALED(status)) {
+        fprintf(stderr, "child killed by signal %d\n", WTERMSIG(status));
+    }
+
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+#endif // _TEST_H
@@ -0,0 +1,214 @@
+#include <sys/mman.h>
+#include "test.h"
+#include "test_store.h"
+#include "step_editor.h"
+
+/*
+    switch banks under a playing sequence. the save task decodes the
+    sequences playing ahead of the switch, so the play task stays on its
+    edges, the notes of the old bank are released and the new bank plays
+    from the first step of a bar. a switch waits while more sequences play
+    than can be decoded ahead of it, and goes through once fewer do. edits
+    made after the swap, before the save task has loaded the rest of the
+    bank, are kept and saved
+*/
+
+#define FIRST_DEADLINE 1000
+#define STEP_US (15000000 / CONFIG_TEMPO)
+#define BAR_US (STEP_US * CONFIG_STEPS_PER_BAR)
+#define MAX_LATENCY_US 1
+
+/*
+    a bank the first test doesn't touch, and a sequence of it that isn't
+    playing, so it's loaded after the swap
+*/
+#define EDIT_BANK 2
+#define IDLE_SQ 20
+
+static uint64_t start;
+static store_state_t* expected;
+
+// sequence 0 holds the note on port A channel 1, struck again every step
+static void fill_sequence(uint8_t note) {
+    store_load_sequence(0);
+
+    memset(&sequences[0], 0, sizeof(MIDISequence_t));
+    sequences[0].channel = PORT_A_CHANNEL_1;
+
+    for(uint8_t i = 0; i < CONFIG_STEPS_PER_SEQUENCE; i++) {
+        step_t* st = &steps[i];
+
+        memset(st, 0, sizeof(*st));
+        st->note_off[0] = note;
+        st->note_on[0].note = note;
+        st->note_on[0].velocity = 100;
+    }
+
+    compile_sequence(0);
+    store_mark_metadata(0);
+}
+
+// @return 1 once the bank is in, within a few bars
+static uint8_t switch_bank(uint8_t b) {
+    store_select_bank(b);
+    xTaskNotify(saveTask, SAVE_TASK_BANK, eSetBits);
+
+    for(uint8_t i = 0; i < 4 * CONFIG_STEPS_PER_BAR && store_bank() != b; i++) {
+        sim_run_us(STEP_US);
+    }
+
+    return store_bank() == b;
+}
+
+static uint8_t sends(const sim_tx_t* tx, uint8_t note, uint8_t velocity) {
+    const uint8_t* wire = sim_midi_bytes(0);
+
+    for(uint32_t i = 1; i < tx->len; i++) {
+        if(wire[tx->offset + i - 1] == note && wire[tx->offset + i] == velocity) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+// @return the step a transfer went out on, the step's edge is in edge
+static uint32_t transfer_step(const sim_tx_t* tx, uint64_t* edge) {
+    uint32_t s = (tx->start_us - start - FIRST_DEADLINE) / STEP_US;
+
+    *edge = start + FIRST_DEADLINE + ((uint64_t)s * STEP_US);
+
+    return s;
+}
+
+static int swap(void* arg) {
+    (void)arg;
+
+    store_start();
+    xTaskCreate(sq_play_task, "sq_play_task", 2048, NULL, 3, NULL);
+    xTaskCreate(save_task, "save task", 512, NULL, 1, &saveTask);
+    start = sim_us();
+
+    // bank 1 plays E4, bank 0 C4
+    enable_sequence(0);
+    CHECK(switch_bank(1));
+    fill_sequence(E4);
+    CHECK(switch_bank(0));
+    fill_sequence(C4);
+    sim_run_us(BAR_US);
+
+    uint32_t first = sim_midi_transfers(0);
+
+    CHECK(switch_bank(1));
+    sim_run_us(BAR_US);
+
+    uint32_t swapped_at = 0;
+
+    for(uint32_t i = first; i < sim_midi_transfers(0); i++) {
+        const sim_tx_t* tx = sim_midi_transfer(0, i);
+        uint64_t edge;
+        uint32_t s = transfer_step(tx, &edge);
+
+        CHECK(tx->start_us - edge <= MAX_LATENCY_US);
+
+        if(!swapped_at && sends(tx, E4, 100)) {
+            swapped_at = i;
+
+            // the bank comes in on a bar, after a release of the old notes
+            CHECK_EQ(s % CONFIG_STEPS_PER_BAR, 0);
+            CHECK(sends(tx, C4, 0));
+            CHECK(!sends(tx, C4, 100));
+        }
+    }
+
+    CHECK(swapped_at > first);
+    CHECK(swapped_at && sends(sim_midi_transfer(0, swapped_at - 1), C4, 100));
+
+    /*
+        one more sequence playing than there are slots holds the switch back.
+        with the first of them stopped the rest aren't all decoded, the bank
+        is staged again and then goes in
+    */
+    for(uint8_t sq = 1; sq <= CONFIG_BANK_SWAP_SEQUENCES; sq++) {
+        enable_sequence(sq);
+    }
+
+    CHECK(!switch_bank(0));
+    CHECK_EQ(store_bank(), 1);
+
+    disable_sequence(0);
+
+    for(uint8_t i = 0; i < 4 * CONFIG_STEPS_PER_BAR && store_bank() != 0; i++) {
+        sim_run_us(STEP_US);
+    }
+
+    CHECK_EQ(store_bank(), 0);
+
+    // every sequence of the bank ends up loaded
+    sim_run_us(BAR_US);
+    CHECK_EQ(store_loaded_mask(0), 0xFFFFFFFF);
+    CHECK_EQ(store_loaded_mask(1), 0xFFFFFFFF);
+
+    return test_result();
+}
+
+/*
+    edit a sequence played through the swap and one still to be loaded, as
+    soon as the bank is in. the test does the save task's part itself so the
+    edits land before the load pass. both must outlast it and a save
+*/
+static int edit_after_swap(void* arg) {
+    (void)arg;
+
+    store_start();
+    xTaskCreate(sq_play_task, "sq_play_task", 2048, NULL, 3, NULL);
+
+    enable_sequence(0);
+    fill_sequence(C4);
+
+    store_select_bank(EDIT_BANK);
+    store_save();
+    store_stage_bank();
+
+    for(uint8_t i = 0; i < 2 * CONFIG_STEPS_PER_BAR && store_bank() != EDIT_BANK; i++) {
+        sim_run_us(STEP_US);
+    }
+
+    CHECK_EQ(store_bank(), EDIT_BANK);
+    CHECK(!(store_loaded_mask(0) & (1UL << IDLE_SQ)));
+
+    edit_step_note(0, 5, NOTE_ON, A4, 80);
+    edit_step_note(IDLE_SQ, 3, NOTE_ON, G4, 90);
+    store_state_read(expected);
+
+    // SAVE_TASK_LOAD
+    for(uint8_t i = 0; i < CONFIG_TOTAL_SEQUENCES; i++) {
+        store_load_sequence(i);
+    }
+
+    CHECK(store_state_matches(expected, "after the load"));
+    CHECK_EQ(store_save(), STORE_SAVE_OK);
+
+    return test_result();
+}
+
+static int reload(void* arg) {
+    (void)arg;
+
+    store_start();
+
+    CHECK_EQ(store_bank(), EDIT_BANK);
+    CHECK(store_state_matches(expected, "after a power cycle"));
+
+    return test_result();
+}
+
+int main() {
+    expected = mmap(NULL, sizeof(store_state_t), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+    CHECK_EQ(test_fork(swap, NULL), 0);
+    CHECK_EQ(test_fork(edit_after_swap, NULL), 0);
+    CHECK_EQ(test_fork(reload, NULL), 0);
+
+    return test_result();
+}
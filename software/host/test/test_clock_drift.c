@@ -0,0 +1,102 @@
+#include <string.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "tasks.h"
+#include "sequence.h"
+#include "store.h"
+#include "flash.h"
+#include "clock.h"
+#include "midi_out.h"
+#include "stm32f722xx.h"
+#include "sim.h"
+#include "test.h"
+
+/*
+    play 10000 steps off the simulated TIM2 and check when each one went out
+    on the wire. step k has to start exactly 1000 + 15000000 * k / tempo
+    microseconds after the clock was started, rounded down, so any error in
+    the timer's prescaler or in carrying the fraction of the period shows up
+    as drift. the tempo is one that doesn't divide 15000000, and the APB1
+    prescaler is set as on the board, where the timers run at twice the APB1
+    clock
+*/
+
+#define STEPS 10000
+#define TEMPO 133
+#define FIRST_DEADLINE 1000
+#define US_PER_MINUTE_PER_16TH 15000000ULL
+
+extern MIDISequence_t sequences[CONFIG_TOTAL_SEQUENCES];
+extern step_t steps[CONFIG_TOTAL_SEQUENCES * CONFIG_STEPS_PER_SEQUENCE];
+extern TaskHandle_t flashTask;
+
+// one note every step on port A
+static void load_test_sequence() {
+    store_load_sequence(0);
+
+    memset(&sequences[0], 0, sizeof(MIDISequence_t));
+    sequences[0].channel = PORT_A_CHANNEL_1;
+
+    for(uint8_t i = 0; i < CONFIG_STEPS_PER_SEQUENCE; i++) {
+        step_t* st = &steps[i];
+
+        memset(st, 0, sizeof(*st));
+        st->note_off[0] = C4;
+        st->note_on[0].note = C4;
+        st->note_on[0].velocity = 100;
+    }
+
+    compile_sequence(0);
+    enable_sequence(0);
+}
+
+static uint64_t ideal_us(uint64_t start, uint32_t step) {
+    return start + FIRST_DEADLINE + ((US_PER_MINUTE_PER_16TH * step) / TEMPO);
+}
+
+int main() {
+    RCC->CFGR = (RCC->CFGR & ~RCC_CFGR_PPRE1) | RCC_CFGR_PPRE1_DIV4;
+
+    flash_init();
+    init_sequences();
+    midi_out_init();
+    load_test_sequence();
+
+    xTaskCreate(sq_play_task, "sq_play_task", 2048, NULL, 3, NULL);
+    xTaskCreate(flash_task, "flash task", 512, NULL, 2, &flashTask);
+
+    // the play task starts the clock before anything else runs
+    uint64_t start = sim_us();
+    sim_start();
+    clock_set_tempo(TEMPO);
+
+    uint64_t run_us = ideal_us(0, STEPS - 1) + 10000;
+    while(sim_us() - start < run_us) {
+        sim_run_us(1000000);
+    }
+
+    CHECK(sim_midi_transfers(0) >= STEPS);
+
+    uint32_t wrong = 0;
+    int64_t worst = 0;
+
+    for(uint32_t i = 0; i < STEPS; i++) {
+        int64_t error = (int64_t)sim_midi_transfer(0, i)->start_us - (int64_t)ideal_us(start, i);
+
+        if(error != 0) {
+            wrong++;
+        }
+
+        if(error > worst || -error > worst) {
+            worst = error < 0 ? -error : error;
+        }
+    }
+
+    printf("%u of %u steps off time, worst by %lldus\n", wrong, STEPS, (long long)worst);
+    CHECK_EQ(wrong, 0);
+
+    // the timer has counted one microsecond per microsecond
+    CHECK_EQ((uint64_t)clock_now(), sim_us() - start);
+
+    return test_result();
+}
@@ -0,0 +1,191 @@
+#include <string.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "tasks.h"
+#include "sequence.h"
+#include "store.h"
+#include "flash.h"
+#include "midi_out.h"
+#include "sim.h"
+#include "test.h"
+
+/*
+    how step buffers reach the uarts. the first byte of a step has to go out
+    on the clock edge even while the flash is busy erasing and programming
+    underneath the play task, and a step that is committed while the one
+    before it is still going out has to follow it with no gap, after any
+    input echo that came in meanwhile
+*/
+
+#define RUN_US 2000000
+#define FIRST_DEADLINE 1000
+#define STEP_US (15000000 / CONFIG_TEMPO)
+#define LOAD_ADDR 0xF00000
+
+/*
+    the play task takes over from the flash task the moment its timer fires,
+    part way through an spi transfer or not. this leaves room for the
+    interrupt entry and the switch, which the sim doesn't take time for
+*/
+#define MAX_LATENCY_US 1
+
+extern MIDISequence_t sequences[CONFIG_TOTAL_SEQUENCES];
+extern step_t steps[CONFIG_TOTAL_SEQUENCES * CONFIG_STEPS_PER_SEQUENCE];
+extern TaskHandle_t flashTask;
+
+// keeps the flash task busy for the whole run
+static void load_task() {
+    static uint8_t page[256];
+    uint32_t addr = LOAD_ADDR;
+
+    memset(page, 0x5A, sizeof(page));
+
+    while(1) {
+        flash_eraseSector(addr);
+
+        for(uint32_t p = 0; p < 0x1000; p += sizeof(page)) {
+            flash_programPage(addr + p, page, sizeof(page));
+        }
+
+        flash_fastRead(addr, page, sizeof(page));
+        addr = addr == LOAD_ADDR ? LOAD_ADDR + 0x1000 : LOAD_ADDR;
+    }
+}
+
+// one note every step on port A
+static void load_test_sequence() {
+    store_load_sequence(0);
+
+    memset(&sequences[0], 0, sizeof(MIDISequence_t));
+    sequences[0].channel = PORT_A_CHANNEL_1;
+
+    for(uint8_t i = 0; i < CONFIG_STEPS_PER_SEQUENCE; i++) {
+        step_t* st = &steps[i];
+
+        memset(st, 0, sizeof(*st));
+        st->note_off[0] = C4;
+        st->note_on[0].note = C4;
+        st->note_on[0].velocity = 100;
+    }
+
+    compile_sequence(0);
+    enable_sequence(0);
+}
+
+static int edge_latency(void* arg) {
+    (void)arg;
+
+    flash_init();
+    init_sequences();
+    midi_out_init();
+    load_test_sequence();
+
+    xTaskCreate(sq_play_task, "sq_play_task", 2048, NULL, 3, NULL);
+    xTaskCreate(flash_task, "flash task", 512, NULL, 2, &flashTask);
+    xTaskCreate(load_task, "load task", 512, NULL, 1, NULL);
+
+    uint64_t start = sim_us();
+    sim_start();
+    sim_run_us(RUN_US);
+
+    uint32_t steps_sent = sim_midi_transfers(0);
+    uint64_t worst = 0;
+
+    CHECK(steps_sent >= RUN_US / STEP_US);
+    CHECK(sim_flash_ops() > 100);
+
+    for(uint32_t i = 0; i < steps_sent; i++) {
+        uint64_t edge = start + FIRST_DEADLINE + ((uint64_t)i * STEP_US);
+        const sim_tx_t* tx = sim_midi_transfer(0, i);
+
+        CHECK(tx->start_us >= edge);
+
+        if(tx->start_us - edge > worst) {
+            worst = tx->start_us - edge;
+        }
+    }
+
+    printf("%u steps, %u flash ops, worst edge to first byte %lluus\n", steps_sent, sim_flash_ops(), (unsigned long long)worst);
+    CHECK(worst <= MAX_LATENCY_US);
+
+    return test_result();
+}
+
+static void queue_notes(uint8_t port, uint8_t channel, uint8_t n) {
+    MIDIPacket_t p = {.status = NOTE_ON, .channel = channel, .velocity = 100};
+
+    midi_out_lock();
+
+    for(uint8_t i = 0; i < n; i++) {
+        p.note = C4 + i;
+        midi_out_queue(port, &p);
+    }
+
+    midi_out_unlock();
+}
+
+/*
+    three steps committed back to back with an echo between the first two.
+    the echo goes ahead of the waiting step, each transfer starts the moment
+    the one before it ends, and a step queued while both step buffers are
+    taken is dropped
+*/
+static int handover(void* arg) {
+    (void)arg;
+
+    const uint8_t port = 1;
+    midi_port_t* m = midi_out_port(port);
+    MIDIPacket_t echo = {.status = CONTROLLER, .channel = 5, .note = 7, .velocity = 64};
+
+    midi_out_init();
+    sim_start();
+
+    queue_notes(port, 0, 10);
+    midi_out_commit();
+    uint64_t committed = sim_us();
+
+    sim_run_us(100);
+    midi_out_thru(port, &echo);
+
+    queue_notes(port, 1, 10);
+    midi_out_commit();
+
+    uint32_t dropped = m->dropped;
+    queue_notes(port, 2, 1);
+    CHECK_EQ(m->dropped, dropped + 1);
+    midi_out_commit();
+
+    sim_run_us(100000);
+
+    CHECK_EQ(sim_midi_transfers(port), 3);
+
+    const sim_tx_t* first = sim_midi_transfer(port, 0);
+    const sim_tx_t* thru = sim_midi_transfer(port, 1);
+    const sim_tx_t* second = sim_midi_transfer(port, 2);
+
+    CHECK_EQ(first->start_us, committed);
+    CHECK_EQ(first->len, 21);
+    CHECK_EQ(thru->start_us, first->end_us);
+    CHECK_EQ(thru->len, 3);
+    CHECK_EQ(second->start_us, thru->end_us);
+    CHECK_EQ(second->len, 21);
+
+    const uint8_t* wire = sim_midi_bytes(port);
+
+    CHECK_EQ(wire[first->offset], 0x90);
+    CHECK_EQ(wire[thru->offset], 0xB5);
+    CHECK_EQ(wire[second->offset], 0x91);
+
+    // the port is idle once everything has gone out
+    CHECK_EQ(m->active, MIDI_OUT_NO_BUFFER);
+    CHECK_EQ(m->pending, MIDI_OUT_NO_BUFFER);
+
+    return test_result();
+}
+
+int main() {
+    CHECK_EQ(test_fork(edge_latency, NULL), 0);
+    CHECK_EQ(test_fork(handover, NULL), 0);
+
+    return test_result();
+}
@@ -0,0 +1,146 @@
+#include <string.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "midi_out.h"
+#include "sim.h"
+#include "test.h"
+
+/*
+    midi_out_encode() on its own and through the step buffers. with running
+    status a message leaves out its status when it matches the one before,
+    and note offs go as note ons with velocity 0 to share it. the status is
+    sent in full again after the port's flags change, at the start of every
+    step buffer and so after an input echo. without running status every
+    message is sent whole
+*/
+
+typedef struct {
+    MIDIPacket_t p;
+    uint8_t len;
+    uint8_t bytes[MIDI_OUT_MAX_MESSAGE];
+} encoding_t;
+
+#define PACKET(s, c, n, v) {.status = (s), .channel = (c), .note = (n), .velocity = (v)}
+
+static const encoding_t running[] = {
+    {PACKET(NOTE_ON, 0, C4, 100), 3, {0x90, C4, 100}},
+    {PACKET(NOTE_ON, 0, E4, 90), 2, {E4, 90}},
+    {PACKET(NOTE_OFF, 0, C4, 64), 2, {C4, 0}},
+    {PACKET(NOTE_ON, 1, C4, 100), 3, {0x91, C4, 100}},
+    {PACKET(NOTE_OFF, 1, C4, 0), 2, {C4, 0}},
+    {PACKET(CONTROLLER, 1, 7, 127), 3, {0xB1, 7, 127}},
+    {PACKET(CONTROLLER, 1, 10, 64), 2, {10, 64}},
+    {PACKET(NOTE_OFF, 1, C4, 0), 3, {0x91, C4, 0}},
+};
+
+static const encoding_t whole[] = {
+    {PACKET(NOTE_ON, 0, C4, 100), 3, {0x90, C4, 100}},
+    {PACKET(NOTE_ON, 0, E4, 90), 3, {0x90, E4, 90}},
+    {PACKET(NOTE_OFF, 0, C4, 64), 3, {0x80, C4, 64}},
+    {PACKET(CONTROLLER, 1, 7, 127), 3, {0xB1, 7, 127}},
+};
+
+static void check_encodings(uint8_t port, const encoding_t* e, uint8_t n) {
+    midi_port_t* m = midi_out_port(port);
+    uint32_t bytes = 0;
+    uint32_t saved = 0;
+
+    for(uint8_t i = 0; i < n; i++) {
+        MIDIPacket_t p = e[i].p;
+        uint8_t buf[MIDI_OUT_MAX_MESSAGE];
+
+        CHECK_EQ(midi_out_cost(m, &p), e[i].len);
+
+        uint8_t len = midi_out_encode(m, &p, buf);
+
+        CHECK_EQ(len, e[i].len);
+        CHECK(memcmp(buf, e[i].bytes, e[i].len) == 0);
+
+        bytes += e[i].len;
+        saved += MIDI_OUT_MAX_MESSAGE - e[i].len;
+    }
+
+    CHECK_EQ(m->bytes, bytes);
+    CHECK_EQ(m->bytes_saved, saved);
+}
+
+// a change of flags sends the next status in full
+static void check_flags_reset() {
+    midi_port_t* m = midi_out_port(2);
+    MIDIPacket_t p = PACKET(NOTE_ON, 3, G4, 80);
+    uint8_t buf[MIDI_OUT_MAX_MESSAGE];
+
+    CHECK_EQ(midi_out_encode(m, &p, buf), 3);
+    CHECK_EQ(midi_out_encode(m, &p, buf), 2);
+
+    midi_out_set_flags(2, MIDI_OUT_RUNNING_STATUS);
+
+    CHECK_EQ(midi_out_cost(m, &p), 3);
+    CHECK_EQ(midi_out_encode(m, &p, buf), 3);
+    CHECK_EQ(buf[0], 0x93);
+}
+
+static void queue_chord(uint8_t port, uint8_t status, uint8_t velocity) {
+    MIDIPacket_t p = PACKET(status, 0, 0, velocity);
+
+    midi_out_lock();
+
+    p.note = C4;
+    midi_out_queue(port, &p);
+    p.note = E4;
+    midi_out_queue(port, &p);
+    p.note = G4;
+    midi_out_queue(port, &p);
+
+    midi_out_unlock();
+}
+
+/*
+    two steps with an input echo between them, all on channel 1. each step
+    starts with its status even though the one before it was the same, and
+    the echo is sent whole
+*/
+static void check_step_reset() {
+    const uint8_t port = 3;
+    const uint8_t first[] = {0x90, C4, 100, E4, 100, G4, 100};
+    const uint8_t echo[] = {0x80, D4, 0};
+    const uint8_t second[] = {0x90, C4, 0, E4, 0, G4, 0};
+    MIDIPacket_t thru = PACKET(NOTE_OFF, 0, D4, 0);
+
+    queue_chord(port, NOTE_ON, 100);
+    midi_out_commit();
+    sim_run_us(10000);
+
+    midi_out_thru(port, &thru);
+    sim_run_us(10000);
+
+    queue_chord(port, NOTE_OFF, 0);
+    midi_out_commit();
+    sim_run_us(10000);
+
+    CHECK_EQ(sim_midi_transfers(port), 3);
+
+    const uint8_t* wire = sim_midi_bytes(port);
+
+    CHECK(memcmp(wire, first, sizeof(first)) == 0);
+    CHECK(memcmp(&wire[sizeof(first)], echo, sizeof(echo)) == 0);
+    CHECK(memcmp(&wire[sizeof(first) + sizeof(echo)], second, sizeof(second)) == 0);
+
+    // the status is left out of 4 of the 6 messages of the two steps
+    CHECK_EQ(midi_out_port(port)->bytes_saved, 4);
+}
+
+int main() {
+    midi_out_init();
+    sim_start();
+
+    check_encodings(0, running, sizeof(running) / sizeof(running[0]));
+
+    midi_out_set_flags(1, 0);
+    check_encodings(1, whole, sizeof(whole) / sizeof(whole[0]));
+
+    check_flags_reset();
+    check_step_reset();
+
+    return test_result();
+}
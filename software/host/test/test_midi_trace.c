@@ -0,0 +1,206 @@
+#include <string.h>
+#include <sys/mman.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "tasks.h"
+#include "sequence.h"
+#include "store.h"
+#include "flash.h"
+#include "midi_out.h"
+#include "sim.h"
+#include "test.h"
+
+/*
+    play two sequences for a few seconds and check the trace. the engine is
+    run twice, each time in a fresh process, and both traces must match entry
+    for entry. every entry must carry the step it was committed on, the clock
+    count of that step's deadline and the bytes the sequences should produce,
+    and the trace of each port must be exactly what went out on its uart
+*/
+
+#define RUN_US 3000000
+#define FIRST_DEADLINE 1000
+#define STEP_COUNTS (15000000 / CONFIG_TEMPO)
+#define MAX_ENTRIES 256
+
+extern MIDISequence_t sequences[CONFIG_TOTAL_SEQUENCES];
+extern step_t steps[CONFIG_TOTAL_SEQUENCES * CONFIG_STEPS_PER_SEQUENCE];
+extern TaskHandle_t flashTask;
+
+typedef struct {
+    midi_out_trace_t t;
+    uint8_t data[32];
+} entry_t;
+
+typedef struct {
+    uint32_t count;
+    entry_t entries[MAX_ENTRIES];
+} trace_t;
+
+static trace_t* traces;
+
+static const uint8_t chord[3] = {E4, G4, B4};
+
+static uint8_t melody_note(uint8_t step) {
+    return C4 + (step % 4);
+}
+
+/*
+    sequence 0 plays one note a step on port A channel 1, sequence 1 a chord
+    every other step on port B channel 3
+*/
+static void load_test_sequences() {
+    store_load_sequence(0);
+    store_load_sequence(1);
+
+    memset(&sequences[0], 0, sizeof(MIDISequence_t));
+    sequences[0].channel = PORT_A_CHANNEL_1;
+
+    for(uint8_t i = 0; i < CONFIG_STEPS_PER_SEQUENCE; i++) {
+        step_t* st = &steps[i];
+
+        memset(st, 0, sizeof(*st));
+        st->note_off[0] = melody_note(i + CONFIG_STEPS_PER_SEQUENCE - 1);
+        st->note_on[0].note = melody_note(i);
+        st->note_on[0].velocity = 100;
+    }
+
+    memset(&sequences[1], 0, sizeof(MIDISequence_t));
+    sequences[1].channel = PORT_B_CHANNEL_3;
+    sequences[1].prescale_value = 1;
+
+    for(uint8_t i = 0; i < CONFIG_STEPS_PER_SEQUENCE; i++) {
+        step_t* st = &steps[CONFIG_STEPS_PER_SEQUENCE + i];
+
+        memset(st, 0, sizeof(*st));
+
+        for(uint8_t n = 0; n < 3; n++) {
+            st->note_off[n] = chord[n];
+            st->note_on[n].note = chord[n];
+            st->note_on[n].velocity = 90;
+        }
+    }
+
+    compile_sequence(0);
+    compile_sequence(1);
+    enable_sequence(0);
+    enable_sequence(1);
+}
+
+static void drain(trace_t* trace) {
+    entry_t e;
+
+    memset(&e, 0, sizeof(e));
+
+    while(midi_out_trace_read(&e.t, e.data)) {
+        if(trace->count < MAX_ENTRIES) {
+            memcpy(&trace->entries[trace->count++], &e, sizeof(e));
+        }
+
+        memset(&e, 0, sizeof(e));
+    }
+}
+
+// the trace of a port has to be byte for byte what its uart sent
+static void check_wire(trace_t* trace, uint8_t port) {
+    const uint8_t* wire = sim_midi_bytes(port);
+    uint32_t sent = 0;
+
+    for(uint32_t i = 0; i < sim_midi_transfers(port); i++) {
+        sent += sim_midi_transfer(port, i)->len;
+    }
+
+    uint32_t traced = 0;
+
+    for(uint32_t i = 0; i < trace->count; i++) {
+        entry_t* e = &trace->entries[i];
+
+        if(e->t.port != port) {
+            continue;
+        }
+
+        // the last step committed may still be on the wire
+        if(traced + e->t.len > sent) {
+            break;
+        }
+
+        CHECK(memcmp(&wire[traced], e->data, e->t.len) == 0);
+        traced += e->t.len;
+    }
+
+    CHECK(traced > 0);
+    CHECK(sent - traced < MIDI_OUT_THRU_LENGTH + CONFIG_MIDI_TX_BUFFER_LENGTH);
+}
+
+static int run(void* arg) {
+    trace_t* trace = arg;
+
+    flash_init();
+    init_sequences();
+    midi_out_init();
+    load_test_sequences();
+
+    xTaskCreate(sq_play_task, "sq_play_task", 2048, NULL, 3, NULL);
+    xTaskCreate(flash_task, "flash task", 512, NULL, 2, &flashTask);
+    sim_start();
+
+    for(uint32_t t = 0; t < RUN_US; t += 10000) {
+        sim_run_us(10000);
+        drain(trace);
+    }
+
+    check_wire(trace, 0);
+    check_wire(trace, 1);
+    CHECK_EQ(midi_out_trace_dropped(), 0);
+
+    return test_result();
+}
+
+static void check_entries(trace_t* trace) {
+    uint32_t steps_a = 0;
+    uint32_t steps_b = 0;
+
+    CHECK(trace->count > 0);
+
+    for(uint32_t i = 0; i < trace->count; i++) {
+        entry_t* e = &trace->entries[i];
+        uint32_t s = e->t.step;
+
+        CHECK_EQ(e->t.now, FIRST_DEADLINE + (s * STEP_COUNTS));
+
+        if(e->t.port == 0) {
+            uint8_t expected[5] = {0x90, melody_note(s + CONFIG_STEPS_PER_SEQUENCE - 1), 0, melody_note(s), 100};
+
+            CHECK_EQ(s, steps_a);
+            CHECK_EQ(e->t.len, sizeof(expected));
+            CHECK(memcmp(e->data, expected, sizeof(expected)) == 0);
+            steps_a++;
+        } else if(e->t.port == 1) {
+            uint8_t expected[13] = {0x92, E4, 0, G4, 0, B4, 0, E4, 90, G4, 90, B4, 90};
+
+            // the chord is played on every other step
+            CHECK_EQ(s, steps_b * 2);
+            CHECK_EQ(e->t.len, sizeof(expected));
+            CHECK(memcmp(e->data, expected, sizeof(expected)) == 0);
+            steps_b++;
+        } else {
+            CHECK(0);
+        }
+    }
+
+    CHECK(steps_a > 4);
+}
+
+int main() {
+    traces = mmap(NULL, 2 * sizeof(trace_t), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+    CHECK_EQ(test_fork(run, &traces[0]), 0);
+    CHECK_EQ(test_fork(run, &traces[1]), 0);
+
+    CHECK_EQ(traces[0].count, traces[1].count);
+    CHECK(memcmp(&traces[0], &traces[1], sizeof(trace_t)) == 0);
+
+    check_entries(&traces[0]);
+
+    return test_result();
+}
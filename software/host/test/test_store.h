@@ -0,0 +1,125 @@
+#ifndef _TEST_STORE_H
+#define _TEST_STORE_H
+
+/*
+    what the store tests start the firmware with and compare. the state of
+    the sequences is everything a save writes, the metadata a record holds
+    and the notes of every step
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "tasks.h"
+#include "sequence.h"
+#include "store.h"
+#include "flash.h"
+#include "midi_out.h"
+#include "sim.h"
+
+extern MIDISequence_t sequences[CONFIG_TOTAL_SEQUENCES];
+extern step_t steps[CONFIG_TOTAL_SEQUENCES * CONFIG_STEPS_PER_SEQUENCE];
+extern TaskHandle_t flashTask;
+extern TaskHandle_t saveTask;
+
+typedef struct {
+    uint8_t channel;
+    uint8_t prescale_value;
+    uint32_t enabled_steps[2];
+} saved_metadata_t;
+
+typedef struct {
+    saved_metadata_t metadata[CONFIG_TOTAL_SEQUENCES];
+    step_t steps[CONFIG_TOTAL_SEQUENCES * CONFIG_STEPS_PER_SEQUENCE];
+} store_state_t;
+
+// mount the store as at power up and load every sequence
+static inline void store_start() {
+    flash_init();
+    init_sequences();
+    midi_out_init();
+
+    xTaskCreate(flash_task, "flash task", 512, NULL, 2, &flashTask);
+    sim_start();
+
+    for(uint8_t i = 0; i < CONFIG_TOTAL_SEQUENCES; i++) {
+        store_load_sequence(i);
+    }
+}
+
+// notes are saved wherever they sit in a step and loaded packed to the front
+static inline void store_pack_step(step_t* st) {
+    step_t packed;
+    uint8_t offs = 0;
+    uint8_t ons = 0;
+
+    memset(&packed, 0, sizeof(packed));
+
+    for(uint8_t n = 0; n < CONFIG_MAX_POLYPHONY; n++) {
+        if(st->note_off[n]) {
+            packed.note_off[offs++] = st->note_off[n];
+        }
+
+        if(st->note_on[n].note) {
+            packed.note_on[ons++] = st->note_on[n];
+        }
+    }
+
+    *st = packed;
+}
+
+static inline void store_state_read(store_state_t* e) {
+    for(uint8_t i = 0; i < CONFIG_TOTAL_SEQUENCES; i++) {
+        e->metadata[i].channel = sequences[i].channel;
+        e->metadata[i].prescale_value = sequences[i].prescale_value;
+        memcpy(e->metadata[i].enabled_steps, sequences[i].enabled_steps, sizeof(e->metadata[i].enabled_steps));
+    }
+
+    memcpy(e->steps, steps, sizeof(e->steps));
+
+    for(uint16_t i = 0; i < CONFIG_TOTAL_SEQUENCES * CONFIG_STEPS_PER_SEQUENCE; i++) {
+        store_pack_step(&e->steps[i]);
+    }
+}
+
+/*
+    @param what     printed with the first difference found
+
+    @return 1 if the sequences in ram are the state given
+*/
+static inline uint8_t store_state_matches(store_state_t* e, const char* what) {
+    store_state_t* now = malloc(sizeof(store_state_t));
+    uint8_t match = 1;
+
+    store_state_read(now);
+
+    for(uint8_t i = 0; i < CONFIG_TOTAL_SEQUENCES && match; i++) {
+        if(memcmp(&now->metadata[i], &e->metadata[i], sizeof(saved_metadata_t))) {
+            if(what) {
+                printf("%s: settings of sequence %u differ\n", what, i);
+            }
+
+            match = 0;
+        }
+
+        for(uint8_t s = 0; s < CONFIG_STEPS_PER_SEQUENCE && match; s++) {
+            uint16_t st = (i * CONFIG_STEPS_PER_SEQUENCE) + s;
+
+            if(memcmp(&now->steps[st], &e->steps[st], sizeof(step_t))) {
+                if(what) {
+                    printf("%s: step %u of sequence %u differs\n", what, s, i);
+                }
+
+                match = 0;
+            }
+        }
+    }
+
+    free(now);
+
+    return match;
+}
+
+#endif // _TEST_STORE_H
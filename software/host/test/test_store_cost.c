@@ -0,0 +1,92 @@
+#include "step_editor.h"
+#include "test.h"
+#include "test_store.h"
+
+/*
+    what a save costs in flash operations. a save only writes the blocks
+    marked since the last one, a page each for a small record, then commits
+    them with an index record for the bank and a checkpoint. it only erases
+    when a checkpoint slot fills or the log is reclaimed, which store_save()
+    doesn't do, so a save that changes one sequence costs three programs
+    where moving every block into the log costs one for each block. the
+    metadata of 16 sequences shares a record, so the settings of every
+    sequence go out in STORE_METADATA_RECORDS programs. a page program is
+    waited out without sleeping a tick, so each takes less than one
+*/
+
+// the index record of the bank and the checkpoint
+#define COMMIT_PROGRAMS 2
+
+typedef struct {
+    uint32_t programs;
+    uint32_t erases;
+    uint64_t us;
+} cost_t;
+
+static void cost_start(cost_t* c) {
+    c->programs = sim_flash_programs();
+    c->erases = sim_flash_erases();
+    c->us = sim_us();
+}
+
+static void cost_end(cost_t* c) {
+    c->programs = sim_flash_programs() - c->programs;
+    c->erases = sim_flash_erases() - c->erases;
+    c->us = sim_us() - c->us;
+}
+
+static int run(void* arg) {
+    (void)arg;
+
+    cost_t full;
+    cost_t one;
+    cost_t metadata;
+
+    /*
+        the flash holds nothing yet, so every block is marked to be moved
+        into the log. an empty sequence fits a page, and the first checkpoint
+        erases its slot
+    */
+    store_start();
+
+    cost_start(&full);
+    CHECK_EQ(store_save(), STORE_SAVE_OK);
+    cost_end(&full);
+
+    CHECK_EQ(full.programs, STORE_METADATA_RECORDS + CONFIG_TOTAL_SEQUENCES + COMMIT_PROGRAMS);
+    CHECK_EQ(full.erases, 1);
+
+    cost_start(&one);
+    edit_step_note(3, 10, NOTE_ON, C4, 100);
+    CHECK_EQ(store_save(), STORE_SAVE_OK);
+    cost_end(&one);
+
+    CHECK_EQ(one.programs, 1 + COMMIT_PROGRAMS);
+    CHECK_EQ(one.erases, 0);
+    CHECK(one.us < one.programs * (1000000 / configTICK_RATE_HZ));
+
+    cost_start(&metadata);
+
+    for(uint8_t sq = 0; sq < CONFIG_TOTAL_SEQUENCES; sq++) {
+        store_preserve_metadata(sq);
+        sequences[sq].prescale_value = sq % 128;
+        store_mark_metadata(sq);
+    }
+
+    CHECK_EQ(store_save(), STORE_SAVE_OK);
+    cost_end(&metadata);
+
+    CHECK_EQ(metadata.programs, STORE_METADATA_RECORDS + COMMIT_PROGRAMS);
+    CHECK_EQ(metadata.erases, 0);
+
+    printf("full save %u programs %u erases, one sequence %u programs %u erases in %llu us, all metadata %u programs %u erases\n",
+        full.programs, full.erases, one.programs, one.erases, (unsigned long long)one.us, metadata.programs, metadata.erases);
+
+    return test_result();
+}
+
+int main() {
+    CHECK_EQ(test_fork(run, NULL), 0);
+
+    return test_result();
+}
@@ -0,0 +1,118 @@
+#include <sys/mman.h>
+#include "step_editor.h"
+#include "test.h"
+#include "test_store.h"
+
+/*
+    a save only writes the blocks the editors marked with store_mark_step()
+    and store_mark_metadata(), so an editor that changes a step or a
+    sequence's settings without marking it loses the change at the next power
+    cycle. each editor is run in a process of its own, which saves and exits,
+    then the store is loaded in a fresh process and must hold exactly what
+    the editor left in ram
+*/
+
+typedef struct {
+    const char* name;
+    void (*edit)();
+} editor_t;
+
+#define PASTE_SQ 6
+
+static store_state_t* expected;
+
+static void edit_note_on() {
+    edit_step_note(0, 3, NOTE_ON, E4, 100);
+    edit_step_note(0, 4, NOTE_ON, G4, 90);
+}
+
+static void edit_note_off() {
+    edit_step_note(0, 5, NOTE_OFF, E4, 0);
+}
+
+static void edit_velocity() {
+    edit_step_velocity(0, 3, -20);
+}
+
+static void edit_toggle() {
+    toggle_step(1, 7);
+    toggle_step(1, 40);
+}
+
+static void edit_channel() {
+    set_midi_channel(2, PORT_B_CHANNEL_3);
+}
+
+static void edit_clear_step() {
+    clear_step(0, 3);
+}
+
+/*
+    a note held for two steps, pasted onto the last step of a sequence past
+    the first four so its note off wraps round to the start
+*/
+static void edit_paste() {
+    step_t temp;
+    uint8_t offsets[CONFIG_MAX_POLYPHONY] = {0};
+    uint16_t base = PASTE_SQ * CONFIG_STEPS_PER_SEQUENCE;
+
+    edit_step_note(PASTE_SQ, 4, NOTE_ON, E4, 100);
+    edit_step_note(PASTE_SQ, 6, NOTE_OFF, E4, 0);
+    copy_step(&temp, offsets, PASTE_SQ, 4);
+    paste_step(temp, offsets, PASTE_SQ, CONFIG_STEPS_PER_SEQUENCE - 1);
+
+    CHECK_EQ(steps[base + CONFIG_STEPS_PER_SEQUENCE - 1].note_on[0].note, E4);
+    CHECK_EQ(steps[base + 1].note_off[0], E4);
+}
+
+static void edit_copy_steps() {
+    copy_steps(5, 0, 10 * sizeof(step_t));
+}
+
+static void edit_clear_sequence() {
+    clear_sequence(5);
+}
+
+static const editor_t editors[] = {
+    {"edit_step_note on", edit_note_on},
+    {"edit_step_note off", edit_note_off},
+    {"edit_step_velocity", edit_velocity},
+    {"toggle_step", edit_toggle},
+    {"set_midi_channel", edit_channel},
+    {"clear_step", edit_clear_step},
+    {"paste_step", edit_paste},
+    {"copy_steps", edit_copy_steps},
+    {"clear_sequence", edit_clear_sequence},
+};
+
+static int edit_and_save(void* arg) {
+    const editor_t* e = arg;
+
+    store_start();
+    e->edit();
+    store_state_read(expected);
+    store_save();
+
+    return test_result();
+}
+
+static int reload(void* arg) {
+    const editor_t* e = arg;
+
+    store_start();
+
+    return store_state_matches(expected, e->name) ? 0 : 1;
+}
+
+int main() {
+    expected = mmap(NULL, sizeof(store_state_t), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+    for(uint8_t i = 0; i < sizeof(editors) / sizeof(editors[0]); i++) {
+        const editor_t* e = &editors[i];
+
+        CHECK_EQ(test_fork(edit_and_save, (void*)e), 0);
+        CHECK_EQ(test_fork(reload, (void*)e), 0);
+    }
+
+    return test_result();
+}
@@ -0,0 +1,215 @@
+#include <sys/mman.h>
+#include "test.h"
+#include "test_store.h"
+
+/*
+    cut the power at every program and erase of a save, then power up again.
+    the store must come up holding either everything from before the save or
+    everything from after it, and a save made after that must come back
+    intact from the next power up
+
+    the save cut short is one that moves records still current out of the
+    tail of the log as well, and writes checkpoints between the two slots, so
+    the cuts land in torn records, torn checkpoints, torn erases and part way
+    through compactions. the log is first filled until the save after next
+    will compact the sector holding the oldest records that are still current
+*/
+
+#define HOT_SEQUENCES 16
+
+// the log and the two checkpoint slots after it, all a save writes to
+#define STORE_BYTES ((CONFIG_STORE_SECTORS + 2) * STORE_SECTOR_SIZE)
+
+typedef struct {
+    uint32_t round;
+    uint32_t ops;
+    uint32_t before_cuts;
+    uint32_t after_cuts;
+    store_state_t before;
+    store_state_t after;
+    store_state_t again;
+    uint8_t image[STORE_BYTES];
+} shared_t;
+
+static shared_t* shared;
+
+/*
+    the largest steps a sequence can have, every note on and note off of
+    every step in use. the notes change with each round
+*/
+static void fill_sequence(uint8_t sq, uint32_t round) {
+    for(uint8_t s = 0; s < CONFIG_STEPS_PER_SEQUENCE; s++) {
+        uint16_t index = ((uint16_t)sq * CONFIG_STEPS_PER_SEQUENCE) + s;
+        step_t* st = &steps[index];
+
+        for(uint8_t n = 0; n < CONFIG_MAX_POLYPHONY; n++) {
+            st->note_on[n].note = A0 + (((sq * 13) + (s * 5) + (n * 11) + (round * 7)) % (C8 - A0));
+            st->note_on[n].velocity = 1 + ((s + n + round) % 127);
+            st->note_off[n] = A0 + ((sq + (s * 3) + (n * 17) + round) % (C8 - A0));
+        }
+
+        compile_step(index);
+    }
+}
+
+// a round edits the hot sequences and saves them
+static void save_round(uint32_t round) {
+    for(uint8_t sq = 0; sq < HOT_SEQUENCES; sq++) {
+        fill_sequence(sq, round);
+    }
+
+    sequences[0].prescale_value = round % 128;
+    store_mark_metadata(0);
+
+    store_save();
+    store_compact();
+}
+
+static store_header_t* image_header(uint16_t sector, uint8_t page) {
+    uint32_t addr = CONFIG_STORE_BASE_ADDR + ((uint32_t)sector * STORE_SECTOR_SIZE) + ((uint32_t)page * STORE_PAGE_SIZE);
+
+    return (store_header_t*)&sim_flash_image()[addr];
+}
+
+// the sector of the newest record of a sequence
+static uint16_t record_sector(uint8_t sq) {
+    uint16_t found = 0;
+    uint32_t newest = 0;
+
+    for(uint16_t s = 0; s < CONFIG_STORE_SECTORS; s++) {
+        for(uint8_t p = 0; p < STORE_PAGES_PER_SECTOR; p++) {
+            store_header_t* h = image_header(s, p);
+
+            if(h->magic == STORE_MAGIC && h->type == STORE_RECORD_SEQUENCE && h->index == sq && h->seq_no >= newest) {
+                newest = h->seq_no;
+                found = s;
+            }
+        }
+    }
+
+    return found;
+}
+
+/*
+    save every sequence once, then save the hot ones round after round until
+    a round compacts the sector the first cold sequence was saved to. the
+    flash as it was before that round is kept
+*/
+static int fill_log(void* arg) {
+    (void)arg;
+
+    store_start();
+
+    for(uint8_t sq = 0; sq < CONFIG_TOTAL_SEQUENCES; sq++) {
+        fill_sequence(sq, 0);
+    }
+
+    store_save();
+    store_compact();
+
+    uint16_t cold = record_sector(HOT_SEQUENCES);
+    uint32_t cold_seq = image_header(cold, 0)->seq_no;
+
+    for(uint32_t round = 1; round < 1000; round++) {
+        memcpy(shared->image, &sim_flash_image()[CONFIG_STORE_BASE_ADDR], sizeof(shared->image));
+        store_state_read(&shared->before);
+        shared->round = round;
+
+        save_round(round);
+
+        if(image_header(cold, 0)->seq_no != cold_seq) {
+            store_state_read(&shared->after);
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+// power up on the kept flash and run the round, with the power cut if cut > 0
+static int run_round(void* arg) {
+    uint32_t cut = (uint32_t)(uintptr_t)arg;
+
+    memcpy(&sim_flash_image()[CONFIG_STORE_BASE_ADDR], shared->image, sizeof(shared->image));
+    store_start();
+
+    uint32_t ops = sim_flash_ops();
+
+    if(cut) {
+        sim_flash_cut_after(cut - 1);
+    }
+
+    save_round(shared->round);
+    shared->ops = sim_flash_ops() - ops;
+
+    return store_state_matches(&shared->after, "uncut round") ? 0 : 1;
+}
+
+/*
+    power up after a cut. the store holds the state from before the round or
+    after it, and is saved to once more
+*/
+static int power_up(void* arg) {
+    uint32_t cut = (uint32_t)(uintptr_t)arg;
+
+    store_start();
+
+    if(store_state_matches(&shared->before, NULL)) {
+        shared->before_cuts++;
+    } else if(store_state_matches(&shared->after, NULL)) {
+        shared->after_cuts++;
+    } else {
+        printf("cut after %u ops: ", cut - 1);
+        store_state_matches(&shared->after, "neither before nor after the round");
+        return 1;
+    }
+
+    save_round(shared->round + 1);
+    store_state_read(&shared->again);
+
+    return 0;
+}
+
+static int power_up_again(void* arg) {
+    uint32_t cut = (uint32_t)(uintptr_t)arg;
+
+    store_start();
+
+    if(!store_state_matches(&shared->again, NULL)) {
+        printf("cut after %u ops: ", cut - 1);
+        store_state_matches(&shared->again, "save after the power up");
+        return 1;
+    }
+
+    return 0;
+}
+
+int main() {
+    shared = mmap(NULL, sizeof(shared_t), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+    CHECK_EQ(test_fork(fill_log, NULL), 0);
+    CHECK_EQ(test_fork(run_round, NULL), 0);
+
+    uint32_t ops = shared->ops;
+
+    printf("round %u, %u programs and erases\n", shared->round, ops);
+    CHECK(ops > 0);
+
+    for(uint32_t cut = 1; cut <= ops; cut++) {
+        void* arg = (void*)(uintptr_t)cut;
+
+        CHECK_EQ(test_fork(run_round, arg), SIM_POWER_CUT);
+        CHECK_EQ(test_fork(power_up, arg), 0);
+        CHECK_EQ(test_fork(power_up_again, arg), 0);
+
+        if(test_failures) {
+            break;
+        }
+    }
+
+    printf("%u cuts came up before the round, %u after it\n", shared->before_cuts, shared->after_cuts);
+    CHECK(shared->before_cuts > 0);
+    CHECK(shared->after_cuts > 0);
+
+    return test_result();
+}
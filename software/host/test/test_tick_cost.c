@@ -0,0 +1,119 @@
+#include <time.h>
+#include "test.h"
+#include "test_store.h"
+
+/*
+    what load_sequences() costs a tick with 1, 3 and every sequence playing.
+    only the enabled sequences are visited, so the cost has to grow with the
+    number playing. each sequence strikes a note every step. the ticks are
+    timed in batches and the fastest batch of many is kept, which leaves out
+    whatever else the host was doing
+*/
+
+#define BATCH_TICKS 16
+#define BATCHES 2000
+#define BUFFER_SIZE ((BATCH_TICKS * CONFIG_TOTAL_SEQUENCES) + 1)
+
+static MIDIPacket_t note_on_buffer[BUFFER_SIZE];
+static MIDIPacket_t note_off_buffer[BUFFER_SIZE];
+static midi_buf_t note_on_mbuf;
+static midi_buf_t note_off_mbuf;
+static port_buffers_t port_buffers[1];
+
+static void fill_sequence(uint8_t sq) {
+    store_load_sequence(sq);
+
+    memset(&sequences[sq], 0, sizeof(MIDISequence_t));
+    sequences[sq].channel = PORT_A_CHANNEL_1;
+
+    for(uint8_t i = 0; i < CONFIG_STEPS_PER_SEQUENCE; i++) {
+        step_t* st = &steps[((uint16_t)sq * CONFIG_STEPS_PER_SEQUENCE) + i];
+
+        memset(st, 0, sizeof(*st));
+        st->note_off[0] = C4;
+        st->note_on[0].note = C4;
+        st->note_on[0].velocity = 100;
+    }
+
+    compile_sequence(sq);
+}
+
+static uint64_t now_ns() {
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+
+    return ((uint64_t)t.tv_sec * 1000000000) + t.tv_nsec;
+}
+
+// @return the fastest a tick went with the first n sequences playing, in ns
+static uint64_t tick_cost(uint8_t n) {
+    uint64_t best = UINT64_MAX;
+
+    for(uint8_t sq = 0; sq < CONFIG_TOTAL_SEQUENCES; sq++) {
+        disable_sequence(sq);
+    }
+
+    for(uint8_t sq = 0; sq < n; sq++) {
+        enable_sequence(sq);
+    }
+
+    for(uint32_t b = 0; b < BATCHES; b++) {
+        mbuf_reset(port_buffers[0].note_on);
+        mbuf_reset(port_buffers[0].note_off);
+
+        uint64_t start = now_ns();
+
+        for(uint8_t t = 0; t < BATCH_TICKS; t++) {
+            load_sequences(port_buffers, 1);
+        }
+
+        uint64_t ns = now_ns() - start;
+
+        if(ns < best) {
+            best = ns;
+        }
+    }
+
+    CHECK_EQ(mbuf_overflows(port_buffers[0].note_on), 0);
+    CHECK_EQ(mbuf_overflows(port_buffers[0].note_off), 0);
+
+    return best / BATCH_TICKS;
+}
+
+static int run(void* arg) {
+    (void)arg;
+
+    store_start();
+
+    port_buffers[0].port = 0;
+    port_buffers[0].note_on = mbuf_init(&note_on_mbuf, note_on_buffer, BUFFER_SIZE);
+    port_buffers[0].note_off = mbuf_init(&note_off_mbuf, note_off_buffer, BUFFER_SIZE);
+
+    for(uint8_t sq = 0; sq < CONFIG_TOTAL_SEQUENCES; sq++) {
+        fill_sequence(sq);
+    }
+
+    uint64_t one = tick_cost(1);
+    uint64_t three = tick_cost(3);
+    uint64_t all = tick_cost(CONFIG_TOTAL_SEQUENCES);
+
+    printf("tick with 1 sequence %llu ns, 3 sequences %llu ns, %u sequences %llu ns\n",
+        (unsigned long long)one, (unsigned long long)three, CONFIG_TOTAL_SEQUENCES, (unsigned long long)all);
+
+    /*
+        3 playing visit three times the sequences 1 does, and a tenth of the
+        cost of every sequence playing is still more than 3 should take
+    */
+    CHECK(one < three);
+    CHECK(three < all);
+    CHECK(three * 10 < all);
+
+    return test_result();
+}
+
+int main() {
+    CHECK_EQ(test_fork(run, NULL), 0);
+
+    return test_result();
+}
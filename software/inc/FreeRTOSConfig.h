@@ -98,6 +98,7 @@ to exclude the API function. */
 #define INCLUDE_vTaskDelay				1
 #define INCLUDE_eTaskGetState			1
 #define INCLUDE_xTimerPendFunctionCall	1
+#define INCLUDE_xTaskGetSchedulerState	1
 
 /* Cortex-M specific definitions. */
 #ifdef __NVIC_PRIO_BITS
@@ -1,4 +1,4 @@
-uint8_t font[] = {
+const uint8_t font[] = {
 	0x00, 0x00, 0x00, 0x00, 0x00,	// NULL
 	0x3E, 0x5B, 0x4F, 0x5B, 0x3E,	// :q
 	0x3E, 0x6B, 0x4F, 0x6B, 0x3E,	// :p
@@ -258,42 +258,110 @@ uint8_t font[] = {
 };
 
 
-unsigned char font16[] = {
-	0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00, // blank
-	0xF0,0xF8,0x1C,0x0C,0x0C,0x8C,0xCC,0xDC,0xF8,0xF0,0x3F,0x7F,0xEC,0xCE,0xC7,0xC3,0xC1,0xE0,0x7F,0x3F, // 0
-	0x00,0x00,0x30,0x38,0xFC,0xFC,0x00,0x00,0x00,0x00,0x00,0x00,0xC0,0xC0,0xFF,0xFF,0xC0,0xC0,0x00,0x00, // 1
-	0x30,0x38,0x1C,0x0C,0x0C,0x0C,0x0C,0x1C,0xF8,0xF0,0xFC,0xFE,0xC7,0xC3,0xC3,0xC3,0xC3,0xC3,0xC1,0xC0, // 2
-	0x30,0x38,0x1C,0x0C,0x0C,0x0C,0x0C,0x1C,0xF8,0xF0,0x30,0x70,0xE0,0xC0,0xC3,0xC3,0xC3,0xE7,0x7F,0x3C, // 3
-	0x00,0x80,0xC0,0xE0,0x70,0x38,0xFC,0xFC,0x00,0x00,0x0F,0x0F,0x0D,0x0C,0x0C,0x0C,0xFF,0xFF,0x0C,0x0C, // 4
-	0xFC,0xFC,0xCC,0xCC,0xCC,0xCC,0xCC,0xCC,0x8C,0x0C,0x30,0x70,0xE0,0xC0,0xC0,0xC0,0xC0,0xE0,0x7F,0x3F, // 5
-	0xF0,0xF8,0x1C,0x0C,0x0C,0x0C,0x0C,0x1C,0x38,0x30,0x3F,0x7F,0xE3,0xC3,0xC3,0xC3,0xC3,0xE7,0x7E,0x3C, // 6
-	0x0C,0x0C,0x0C,0x0C,0x0C,0x0C,0x8C,0xCC,0xFC,0x7C,0x00,0x00,0x00,0x00,0xFE,0xFF,0x03,0x01,0x00,0x00, // 7
-	0xF0,0xF8,0x9C,0x0C,0x0C,0x0C,0x0C,0x9C,0xF8,0xF0,0x3C,0x7F,0xE7,0xC3,0xC3,0xC3,0xC3,0xE7,0x7F,0x3C, // 8
-	0xF0,0xF8,0x9C,0x0C,0x0C,0x0C,0x0C,0x9C,0xF8,0xF0,0x30,0x71,0xE3,0xC3,0xC3,0xC3,0xC3,0xE3,0x7F,0x3F, // 9
-	0xC0,0xE0,0x70,0x38,0x1C,0x1C,0x38,0x70,0xE0,0xC0,0xFF,0xFF,0x0C,0x0C,0x0C,0x0C,0x0C,0x0C,0xFF,0xFF, // A
-	0xFC,0xFC,0x0C,0x0C,0x0C,0x0C,0x0C,0x9C,0xF8,0xF0,0xFF,0xFF,0xC3,0xC3,0xC3,0xC3,0xC3,0xE7,0x7F,0x3C, // B
-	0xF0,0xF8,0x1C,0x0C,0x0C,0x0C,0x0C,0x1C,0x38,0x30,0x3F,0x7F,0xE0,0xC0,0xC0,0xC0,0xC0,0xE0,0x70,0x30, // C
-	0xFC,0xFC,0x0C,0x0C,0x0C,0x0C,0x0C,0x1C,0xF8,0xF0,0xFF,0xFF,0xC0,0xC0,0xC0,0xC0,0xC0,0xE0,0x7F,0x3F, // D
-	0xFC,0xFC,0x0C,0x0C,0x0C,0x0C,0x0C,0x0C,0x0C,0x0C,0xFF,0xFF,0xC3,0xC3,0xC3,0xC3,0xC3,0xC3,0xC0,0xC0, // E
-	0xFC,0xFC,0x0C,0x0C,0x0C,0x0C,0x0C,0x0C,0x0C,0x0C,0xFF,0xFF,0x03,0x03,0x03,0x03,0x03,0x03,0x00,0x00, // F
-	0xF0,0xF8,0x1C,0x0C,0x0C,0x0C,0x0C,0x1C,0x38,0x30,0x3F,0x7F,0xE0,0xC0,0xC0,0xC3,0xC3,0xE3,0x7F,0x3F, // G
-	0xFC,0xFC,0x00,0x00,0x00,0x00,0x00,0x00,0xFC,0xFC,0xFF,0xFF,0x03,0x03,0x03,0x03,0x03,0x03,0xFF,0xFF, // H
-	0X00,0X00,0X0C,0X0C,0xFC,0xFC,0X0C,0X0C,0X00,0X00,0X00,0X00,0xC0,0xC0,0XFF,0XFF,0XC0,0xC0,0X00,0X00, // I
-	0x00,0x00,0x00,0x00,0x0C,0x0C,0xFC,0xFC,0x0C,0x0C,0x30,0x70,0xE0,0xC0,0xC0,0xE0,0x7F,0x3F,0x00,0x00, // J
-	0xFC,0xFC,0x00,0x80,0xC0,0xE0,0x70,0x38,0x1C,0x0C,0xFF,0xFF,0x03,0x07,0x0F,0x1C,0x38,0x70,0xE0,0xC0, // K
-	0xFC,0xFC,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0xFF,0xFF,0xC0,0xC0,0xC0,0xC0,0xC0,0xC0,0xC0,0xC0, // L
-	0xFC,0xFC,0x70,0xE0,0xC0,0xC0,0xE0,0x70,0xFC,0xFC,0xFF,0xFF,0x00,0x00,0x03,0x03,0x00,0x00,0xFF,0xFF, // M
-	0xFC,0xFC,0xE0,0xC0,0x80,0x00,0x00,0x00,0xFC,0xFC,0xFF,0xFF,0x00,0x01,0x03,0x07,0x0E,0x1C,0xFF,0xFF, // N
-	0xF0,0xF8,0x1C,0x0C,0x0C,0x0C,0x0C,0x1C,0xF8,0xF0,0x3F,0x7F,0xE0,0xC0,0xC0,0xC0,0xC0,0xE0,0x7F,0x3F, // O
-	0xFC,0xFC,0x0C,0x0C,0x0C,0x0C,0x0C,0x9C,0xF8,0xF0,0xFF,0xFF,0x03,0x03,0x03,0x03,0x03,0x03,0x01,0x00, // P
-	0xF0,0xF8,0x1C,0x0C,0x0C,0x0C,0x0C,0x1C,0xF8,0xF0,0x3F,0x7F,0xE0,0xC0,0xCC,0xDC,0x78,0x70,0xFF,0xDF, // Q
-	0xFC,0xFC,0x0C,0x0C,0x0C,0x0C,0x0C,0x9C,0xF8,0xF0,0xFF,0xFF,0x03,0x07,0x0F,0x1F,0x3B,0x73,0xE1,0xC0, // R
-	0xF0,0xF8,0x9C,0x0C,0x0C,0x0C,0x0C,0x1C,0x38,0x30,0x30,0x71,0xE3,0xC3,0xC3,0xC3,0xC3,0xE7,0x7E,0x3C, // S
-	0x0C,0x0C,0x0C,0x0C,0xFC,0xFC,0x0C,0x0C,0x0C,0x0C,0x00,0x00,0x00,0x00,0xFF,0xFF,0x00,0x00,0x00,0x00, // T
-	0xFC,0xFC,0x00,0x00,0x00,0x00,0x00,0x00,0xFC,0xFC,0x3F,0x7F,0xE0,0xC0,0xC0,0xC0,0xC0,0xE0,0x7F,0x3F, // U
-	0xFC,0xFC,0x00,0x00,0x00,0x00,0x00,0x00,0xFC,0xFC,0x0F,0x1F,0x38,0x70,0xE0,0xE0,0x70,0x38,0x1F,0x0F, // V
-	0xFC,0xFC,0x00,0x00,0x00,0x00,0x00,0x00,0xFC,0xFC,0x3F,0x7F,0xE0,0xE0,0x7F,0x7F,0xE0,0xE0,0x7F,0x3F, // W
-	0x3C,0x7C,0xE0,0xC0,0x80,0x80,0xC0,0xE0,0x7C,0x3C,0xF0,0xF8,0x1C,0x0F,0x07,0x07,0x0F,0x1C,0xF8,0xF0, // X
-	0xFC,0xFC,0x80,0x00,0x00,0x00,0x00,0x80,0xFC,0xFC,0x00,0x01,0x03,0x07,0xFE,0xFE,0x07,0x03,0x01,0x00, // Y
-	0x0C,0x0C,0x0C,0x0C,0x0C,0x8C,0xCC,0xEC,0x7C,0x3C,0xF0,0xF8,0xDC,0xCE,0xC7,0xC3,0xC1,0xC0,0xC0,0xC0, // Z
-};	
+/*
+    the 16px font, one glyph for each printable ascii character from space to
+    '~', indexed from space. a glyph is 10 columns in the top page followed by
+    10 in the page below. the space, digits and capitals are drawn by hand, the
+    rest are the 5px font doubled in both directions
+*/
+#define FONT16_FIRST ' '
+#define FONT16_GLYPHS 95
+#define FONT16_WIDTH 10
+
+const uint8_t font16[FONT16_GLYPHS][2][FONT16_WIDTH] = {
+	{{0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00}, {0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00}}, // space
+	{{0x00,0x00,0x00,0x00,0xFF,0xFF,0x00,0x00,0x00,0x00}, {0x00,0x00,0x00,0x00,0x33,0x33,0x00,0x00,0x00,0x00}}, // !
+	{{0x00,0x00,0x3F,0x3F,0x00,0x00,0x3F,0x3F,0x00,0x00}, {0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00}}, // "
+	{{0x30,0x30,0xFF,0xFF,0x30,0x30,0xFF,0xFF,0x30,0x30}, {0x03,0x03,0x3F,0x3F,0x03,0x03,0x3F,0x3F,0x03,0x03}}, // #
+	{{0x30,0x30,0xCC,0xCC,0xFF,0xFF,0xCC,0xCC,0x0C,0x0C}, {0x0C,0x0C,0x0C,0x0C,0x3F,0x3F,0x0C,0x0C,0x03,0x03}}, // $
+	{{0x0F,0x0F,0x0F,0x0F,0xC0,0xC0,0x30,0x30,0x0C,0x0C}, {0x0C,0x0C,0x03,0x03,0x00,0x00,0x3C,0x3C,0x3C,0x3C}}, // %
+	{{0x3C,0x3C,0xC3,0xC3,0x3C,0x3C,0x00,0x00,0x00,0x00}, {0x0F,0x0F,0x30,0x30,0x33,0x33,0x0C,0x0C,0x33,0x33}}, // &
+	{{0x00,0x00,0xC0,0xC0,0x3F,0x3F,0x0F,0x0F,0x00,0x00}, {0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00}}, // '
+	{{0x00,0x00,0xF0,0xF0,0x0C,0x0C,0x03,0x03,0x00,0x00}, {0x00,0x00,0x03,0x03,0x0C,0x0C,0x30,0x30,0x00,0x00}}, // (
+	{{0x00,0x00,0x03,0x03,0x0C,0x0C,0xF0,0xF0,0x00,0x00}, {0x00,0x00,0x30,0x30,0x0C,0x0C,0x03,0x03,0x00,0x00}}, // )
+	{{0xCC,0xCC,0xF0,0xF0,0xFF,0xFF,0xF0,0xF0,0xCC,0xCC}, {0x0C,0x0C,0x03,0x03,0x3F,0x3F,0x03,0x03,0x0C,0x0C}}, // *
+	{{0xC0,0xC0,0xC0,0xC0,0xFC,0xFC,0xC0,0xC0,0xC0,0xC0}, {0x00,0x00,0x00,0x00,0x0F,0x0F,0x00,0x00,0x00,0x00}}, // +
+	{{0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00}, {0x00,0x00,0xC0,0xC0,0x3F,0x3F,0x0F,0x0F,0x00,0x00}}, // ,
+	{{0xC0,0xC0,0xC0,0xC0,0xC0,0xC0,0xC0,0xC0,0xC0,0xC0}, {0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00}}, // -
+	{{0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00}, {0x00,0x00,0x00,0x00,0x3C,0x3C,0x3C,0x3C,0x00,0x00}}, // .
+	{{0x00,0x00,0x00,0x00,0xC0,0xC0,0x30,0x30,0x0C,0x0C}, {0x0C,0x0C,0x03,0x03,0x00,0x00,0x00,0x00,0x00,0x00}}, // /
+	{{0xF0,0xF8,0x1C,0x0C,0x0C,0x8C,0xCC,0xDC,0xF8,0xF0}, {0x3F,0x7F,0xEC,0xCE,0xC7,0xC3,0xC1,0xE0,0x7F,0x3F}}, // 0
+	{{0x00,0x00,0x30,0x38,0xFC,0xFC,0x00,0x00,0x00,0x00}, {0x00,0x00,0xC0,0xC0,0xFF,0xFF,0xC0,0xC0,0x00,0x00}}, // 1
+	{{0x30,0x38,0x1C,0x0C,0x0C,0x0C,0x0C,0x1C,0xF8,0xF0}, {0xFC,0xFE,0xC7,0xC3,0xC3,0xC3,0xC3,0xC3,0xC1,0xC0}}, // 2
+	{{0x30,0x38,0x1C,0x0C,0x0C,0x0C,0x0C,0x1C,0xF8,0xF0}, {0x30,0x70,0xE0,0xC0,0xC3,0xC3,0xC3,0xE7,0x7F,0x3C}}, // 3
+	{{0x00,0x80,0xC0,0xE0,0x70,0x38,0xFC,0xFC,0x00,0x00}, {0x0F,0x0F,0x0D,0x0C,0x0C,0x0C,0xFF,0xFF,0x0C,0x0C}}, // 4
+	{{0xFC,0xFC,0xCC,0xCC,0xCC,0xCC,0xCC,0xCC,0x8C,0x0C}, {0x30,0x70,0xE0,0xC0,0xC0,0xC0,0xC0,0xE0,0x7F,0x3F}}, // 5
+	{{0xF0,0xF8,0x1C,0x0C,0x0C,0x0C,0x0C,0x1C,0x38,0x30}, {0x3F,0x7F,0xE3,0xC3,0xC3,0xC3,0xC3,0xE7,0x7E,0x3C}}, // 6
+	{{0x0C,0x0C,0x0C,0x0C,0x0C,0x0C,0x8C,0xCC,0xFC,0x7C}, {0x00,0x00,0x00,0x00,0xFE,0xFF,0x03,0x01,0x00,0x00}}, // 7
+	{{0xF0,0xF8,0x9C,0x0C,0x0C,0x0C,0x0C,0x9C,0xF8,0xF0}, {0x3C,0x7F,0xE7,0xC3,0xC3,0xC3,0xC3,0xE7,0x7F,0x3C}}, // 8
+	{{0xF0,0xF8,0x9C,0x0C,0x0C,0x0C,0x0C,0x9C,0xF8,0xF0}, {0x30,0x71,0xE3,0xC3,0xC3,0xC3,0xC3,0xE3,0x7F,0x3F}}, // 9
+	{{0x00,0x00,0x00,0x00,0x30,0x30,0x00,0x00,0x00,0x00}, {0x00,0x00,0x00,0x00,0x03,0x03,0x00,0x00,0x00,0x00}}, // :
+	{{0x00,0x00,0x00,0x00,0x30,0x30,0x00,0x00,0x00,0x00}, {0x00,0x00,0x30,0x30,0x0F,0x0F,0x00,0x00,0x00,0x00}}, // ;
+	{{0x00,0x00,0xC0,0xC0,0x30,0x30,0x0C,0x0C,0x03,0x03}, {0x00,0x00,0x00,0x00,0x03,0x03,0x0C,0x0C,0x30,0x30}}, // <
+	{{0x30,0x30,0x30,0x30,0x30,0x30,0x30,0x30,0x30,0x30}, {0x03,0x03,0x03,0x03,0x03,0x03,0x03,0x03,0x03,0x03}}, // =
+	{{0x00,0x00,0x03,0x03,0x0C,0x0C,0x30,0x30,0xC0,0xC0}, {0x00,0x00,0x30,0x30,0x0C,0x0C,0x03,0x03,0x00,0x00}}, // >
+	{{0x0C,0x0C,0x03,0x03,0xC3,0xC3,0xC3,0xC3,0x3C,0x3C}, {0x00,0x00,0x00,0x00,0x33,0x33,0x00,0x00,0x00,0x00}}, // ?
+	{{0xFC,0xFC,0x03,0x03,0xF3,0xF3,0xC3,0xC3,0xFC,0xFC}, {0x0F,0x0F,0x30,0x30,0x33,0x33,0x33,0x33,0x30,0x30}}, // @
+	{{0xC0,0xE0,0x70,0x38,0x1C,0x1C,0x38,0x70,0xE0,0xC0}, {0xFF,0xFF,0x0C,0x0C,0x0C,0x0C,0x0C,0x0C,0xFF,0xFF}}, // A
+	{{0xFC,0xFC,0x0C,0x0C,0x0C,0x0C,0x0C,0x9C,0xF8,0xF0}, {0xFF,0xFF,0xC3,0xC3,0xC3,0xC3,0xC3,0xE7,0x7F,0x3C}}, // B
+	{{0xF0,0xF8,0x1C,0x0C,0x0C,0x0C,0x0C,0x1C,0x38,0x30}, {0x3F,0x7F,0xE0,0xC0,0xC0,0xC0,0xC0,0xE0,0x70,0x30}}, // C
+	{{0xFC,0xFC,0x0C,0x0C,0x0C,0x0C,0x0C,0x1C,0xF8,0xF0}, {0xFF,0xFF,0xC0,0xC0,0xC0,0xC0,0xC0,0xE0,0x7F,0x3F}}, // D
+	{{0xFC,0xFC,0x0C,0x0C,0x0C,0x0C,0x0C,0x0C,0x0C,0x0C}, {0xFF,0xFF,0xC3,0xC3,0xC3,0xC3,0xC3,0xC3,0xC0,0xC0}}, // E
+	{{0xFC,0xFC,0x0C,0x0C,0x0C,0x0C,0x0C,0x0C,0x0C,0x0C}, {0xFF,0xFF,0x03,0x03,0x03,0x03,0x03,0x03,0x00,0x00}}, // F
+	{{0xF0,0xF8,0x1C,0x0C,0x0C,0x0C,0x0C,0x1C,0x38,0x30}, {0x3F,0x7F,0xE0,0xC0,0xC0,0xC3,0xC3,0xE3,0x7F,0x3F}}, // G
+	{{0xFC,0xFC,0x00,0x00,0x00,0x00,0x00,0x00,0xFC,0xFC}, {0xFF,0xFF,0x03,0x03,0x03,0x03,0x03,0x03,0xFF,0xFF}}, // H
+	{{0x00,0x00,0x0C,0x0C,0xFC,0xFC,0x0C,0x0C,0x00,0x00}, {0x00,0x00,0xC0,0xC0,0xFF,0xFF,0xC0,0xC0,0x00,0x00}}, // I
+	{{0x00,0x00,0x00,0x00,0x0C,0x0C,0xFC,0xFC,0x0C,0x0C}, {0x30,0x70,0xE0,0xC0,0xC0,0xE0,0x7F,0x3F,0x00,0x00}}, // J
+	{{0xFC,0xFC,0x00,0x80,0xC0,0xE0,0x70,0x38,0x1C,0x0C}, {0xFF,0xFF,0x03,0x07,0x0F,0x1C,0x38,0x70,0xE0,0xC0}}, // K
+	{{0xFC,0xFC,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00}, {0xFF,0xFF,0xC0,0xC0,0xC0,0xC0,0xC0,0xC0,0xC0,0xC0}}, // L
+	{{0xFC,0xFC,0x70,0xE0,0xC0,0xC0,0xE0,0x70,0xFC,0xFC}, {0xFF,0xFF,0x00,0x00,0x03,0x03,0x00,0x00,0xFF,0xFF}}, // M
+	{{0xFC,0xFC,0xE0,0xC0,0x80,0x00,0x00,0x00,0xFC,0xFC}, {0xFF,0xFF,0x00,0x01,0x03,0x07,0x0E,0x1C,0xFF,0xFF}}, // N
+	{{0xF0,0xF8,0x1C,0x0C,0x0C,0x0C,0x0C,0x1C,0xF8,0xF0}, {0x3F,0x7F,0xE0,0xC0,0xC0,0xC0,0xC0,0xE0,0x7F,0x3F}}, // O
+	{{0xFC,0xFC,0x0C,0x0C,0x0C,0x0C,0x0C,0x9C,0xF8,0xF0}, {0xFF,0xFF,0x03,0x03,0x03,0x03,0x03,0x03,0x01,0x00}}, // P
+	{{0xF0,0xF8,0x1C,0x0C,0x0C,0x0C,0x0C,0x1C,0xF8,0xF0}, {0x3F,0x7F,0xE0,0xC0,0xCC,0xDC,0x78,0x70,0xFF,0xDF}}, // Q
+	{{0xFC,0xFC,0x0C,0x0C,0x0C,0x0C,0x0C,0x9C,0xF8,0xF0}, {0xFF,0xFF,0x03,0x07,0x0F,0x1F,0x3B,0x73,0xE1,0xC0}}, // R
+	{{0xF0,0xF8,0x9C,0x0C,0x0C,0x0C,0x0C,0x1C,0x38,0x30}, {0x30,0x71,0xE3,0xC3,0xC3,0xC3,0xC3,0xE7,0x7E,0x3C}}, // S
+	{{0x0C,0x0C,0x0C,0x0C,0xFC,0xFC,0x0C,0x0C,0x0C,0x0C}, {0x00,0x00,0x00,0x00,0xFF,0xFF,0x00,0x00,0x00,0x00}}, // T
+	{{0xFC,0xFC,0x00,0x00,0x00,0x00,0x00,0x00,0xFC,0xFC}, {0x3F,0x7F,0xE0,0xC0,0xC0,0xC0,0xC0,0xE0,0x7F,0x3F}}, // U
+	{{0xFC,0xFC,0x00,0x00,0x00,0x00,0x00,0x00,0xFC,0xFC}, {0x0F,0x1F,0x38,0x70,0xE0,0xE0,0x70,0x38,0x1F,0x0F}}, // V
+	{{0xFC,0xFC,0x00,0x00,0x00,0x00,0x00,0x00,0xFC,0xFC}, {0x3F,0x7F,0xE0,0xE0,0x7F,0x7F,0xE0,0xE0,0x7F,0x3F}}, // W
+	{{0x3C,0x7C,0xE0,0xC0,0x80,0x80,0xC0,0xE0,0x7C,0x3C}, {0xF0,0xF8,0x1C,0x0F,0x07,0x07,0x0F,0x1C,0xF8,0xF0}}, // X
+	{{0xFC,0xFC,0x80,0x00,0x00,0x00,0x00,0x80,0xFC,0xFC}, {0x00,0x01,0x03,0x07,0xFE,0xFE,0x07,0x03,0x01,0x00}}, // Y
+	{{0x0C,0x0C,0x0C,0x0C,0x0C,0x8C,0xCC,0xEC,0x7C,0x3C}, {0xF0,0xF8,0xDC,0xCE,0xC7,0xC3,0xC1,0xC0,0xC0,0xC0}}, // Z
+	{{0x00,0x00,0xFF,0xFF,0x03,0x03,0x03,0x03,0x03,0x03}, {0x00,0x00,0x3F,0x3F,0x30,0x30,0x30,0x30,0x30,0x30}}, // [
+	{{0x0C,0x0C,0x30,0x30,0xC0,0xC0,0x00,0x00,0x00,0x00}, {0x00,0x00,0x00,0x00,0x00,0x00,0x03,0x03,0x0C,0x0C}}, // backslash
+	{{0x00,0x00,0x03,0x03,0x03,0x03,0x03,0x03,0xFF,0xFF}, {0x00,0x00,0x30,0x30,0x30,0x30,0x30,0x30,0x3F,0x3F}}, // ]
+	{{0x30,0x30,0x0C,0x0C,0x03,0x03,0x0C,0x0C,0x30,0x30}, {0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00}}, // ^
+	{{0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00}, {0x30,0x30,0x30,0x30,0x30,0x30,0x30,0x30,0x30,0x30}}, // _
+	{{0x00,0x00,0x0F,0x0F,0x3F,0x3F,0xC0,0xC0,0x00,0x00}, {0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00}}, // `
+	{{0x00,0x00,0x30,0x30,0x30,0x30,0xC0,0xC0,0x00,0x00}, {0x0C,0x0C,0x33,0x33,0x33,0x33,0x3F,0x3F,0x30,0x30}}, // a
+	{{0xFF,0xFF,0xC0,0xC0,0x30,0x30,0x30,0x30,0xC0,0xC0}, {0x3F,0x3F,0x0C,0x0C,0x30,0x30,0x30,0x30,0x0F,0x0F}}, // b
+	{{0xC0,0xC0,0x30,0x30,0x30,0x30,0x30,0x30,0xC0,0xC0}, {0x0F,0x0F,0x30,0x30,0x30,0x30,0x30,0x30,0x0C,0x0C}}, // c
+	{{0xC0,0xC0,0x30,0x30,0x30,0x30,0xC0,0xC0,0xFF,0xFF}, {0x0F,0x0F,0x30,0x30,0x30,0x30,0x0C,0x0C,0x3F,0x3F}}, // d
+	{{0xC0,0xC0,0x30,0x30,0x30,0x30,0x30,0x30,0xC0,0xC0}, {0x0F,0x0F,0x33,0x33,0x33,0x33,0x33,0x33,0x03,0x03}}, // e
+	{{0x00,0x00,0xC0,0xC0,0xFC,0xFC,0xC3,0xC3,0x0C,0x0C}, {0x00,0x00,0x00,0x00,0x3F,0x3F,0x00,0x00,0x00,0x00}}, // f
+	{{0xC0,0xC0,0x30,0x30,0x30,0x30,0xF0,0xF0,0xC0,0xC0}, {0x03,0x03,0xCC,0xCC,0xCC,0xCC,0xC3,0xC3,0x3F,0x3F}}, // g
+	{{0xFF,0xFF,0xC0,0xC0,0x30,0x30,0x30,0x30,0xC0,0xC0}, {0x3F,0x3F,0x00,0x00,0x00,0x00,0x00,0x00,0x3F,0x3F}}, // h
+	{{0x00,0x00,0x30,0x30,0xF3,0xF3,0x00,0x00,0x00,0x00}, {0x00,0x00,0x30,0x30,0x3F,0x3F,0x30,0x30,0x00,0x00}}, // i
+	{{0x00,0x00,0x00,0x00,0x00,0x00,0xF3,0xF3,0x00,0x00}, {0x0C,0x0C,0x30,0x30,0x30,0x30,0x0F,0x0F,0x00,0x00}}, // j
+	{{0xFF,0xFF,0x00,0x00,0xC0,0xC0,0x30,0x30,0x00,0x00}, {0x3F,0x3F,0x03,0x03,0x0C,0x0C,0x30,0x30,0x00,0x00}}, // k
+	{{0x00,0x00,0x03,0x03,0xFF,0xFF,0x00,0x00,0x00,0x00}, {0x00,0x00,0x30,0x30,0x3F,0x3F,0x30,0x30,0x00,0x00}}, // l
+	{{0xF0,0xF0,0x30,0x30,0xC0,0xC0,0x30,0x30,0xC0,0xC0}, {0x3F,0x3F,0x00,0x00,0x3F,0x3F,0x00,0x00,0x3F,0x3F}}, // m
+	{{0xF0,0xF0,0xC0,0xC0,0x30,0x30,0x30,0x30,0xC0,0xC0}, {0x3F,0x3F,0x00,0x00,0x00,0x00,0x00,0x00,0x3F,0x3F}}, // n
+	{{0xC0,0xC0,0x30,0x30,0x30,0x30,0x30,0x30,0xC0,0xC0}, {0x0F,0x0F,0x30,0x30,0x30,0x30,0x30,0x30,0x0F,0x0F}}, // o
+	{{0xF0,0xF0,0xC0,0xC0,0x30,0x30,0x30,0x30,0xC0,0xC0}, {0xFF,0xFF,0x03,0x03,0x0C,0x0C,0x0C,0x0C,0x03,0x03}}, // p
+	{{0xC0,0xC0,0x30,0x30,0x30,0x30,0xC0,0xC0,0xF0,0xF0}, {0x03,0x03,0x0C,0x0C,0x0C,0x0C,0x03,0x03,0xFF,0xFF}}, // q
+	{{0xF0,0xF0,0xC0,0xC0,0x30,0x30,0x30,0x30,0xC0,0xC0}, {0x3F,0x3F,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00}}, // r
+	{{0xC0,0xC0,0x30,0x30,0x30,0x30,0x30,0x30,0x30,0x30}, {0x30,0x30,0x33,0x33,0x33,0x33,0x33,0x33,0x0C,0x0C}}, // s
+	{{0x30,0x30,0x30,0x30,0xFF,0xFF,0x30,0x30,0x30,0x30}, {0x00,0x00,0x00,0x00,0x0F,0x0F,0x30,0x30,0x0C,0x0C}}, // t
+	{{0xF0,0xF0,0x00,0x00,0x00,0x00,0x00,0x00,0xF0,0xF0}, {0x0F,0x0F,0x30,0x30,0x30,0x30,0x0C,0x0C,0x3F,0x3F}}, // u
+	{{0xF0,0xF0,0x00,0x00,0x00,0x00,0x00,0x00,0xF0,0xF0}, {0x03,0x03,0x0C,0x0C,0x30,0x30,0x0C,0x0C,0x03,0x03}}, // v
+	{{0xF0,0xF0,0x00,0x00,0x00,0x00,0x00,0x00,0xF0,0xF0}, {0x0F,0x0F,0x30,0x30,0x0F,0x0F,0x30,0x30,0x0F,0x0F}}, // w
+	{{0x30,0x30,0xC0,0xC0,0x00,0x00,0xC0,0xC0,0x30,0x30}, {0x30,0x30,0x0C,0x0C,0x03,0x03,0x0C,0x0C,0x30,0x30}}, // x
+	{{0xF0,0xF0,0x00,0x00,0x00,0x00,0x00,0x00,0xF0,0xF0}, {0x30,0x30,0xC3,0xC3,0xC3,0xC3,0xC3,0xC3,0x3F,0x3F}}, // y
+	{{0x30,0x30,0x30,0x30,0x30,0x30,0xF0,0xF0,0x30,0x30}, {0x30,0x30,0x3C,0x3C,0x33,0x33,0x30,0x30,0x30,0x30}}, // z
+	{{0x00,0x00,0xC0,0xC0,0x3C,0x3C,0x03,0x03,0x00,0x00}, {0x00,0x00,0x00,0x00,0x0F,0x0F,0x30,0x30,0x00,0x00}}, // {
+	{{0x00,0x00,0x00,0x00,0x3F,0x3F,0x00,0x00,0x00,0x00}, {0x00,0x00,0x00,0x00,0x3F,0x3F,0x00,0x00,0x00,0x00}}, // |
+	{{0x00,0x00,0x03,0x03,0x3C,0x3C,0xC0,0xC0,0x00,0x00}, {0x00,0x00,0x30,0x30,0x0F,0x0F,0x00,0x00,0x00,0x00}}, // }
+	{{0x0C,0x0C,0x03,0x03,0x0C,0x0C,0x30,0x30,0x0C,0x0C}, {0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00}}, // ~
+};
@@ -0,0 +1,32 @@
+#ifndef _CLOCK_H
+#define _CLOCK_H
+
+#include <stdint.h>
+#include "FreeRTOS.h"
+#include "task.h"
+
+/*
+    the step period is kept as an exact fraction of microseconds,
+    15000000 / tempo. whole holds the integer part and rem/den the remainder,
+    which is carried from step to step so the clock never drifts against the
+    ideal tempo, it only jitters by up to 1us
+*/
+typedef struct {
+    uint32_t whole;
+    uint32_t rem;
+    uint32_t den;
+    uint32_t acc;
+    uint32_t deadline;
+} master_clock_t;
+
+void clock_set_period(master_clock_t* c, uint16_t tempo);
+uint32_t clock_advance(master_clock_t* c);
+
+uint32_t clock_timer_hz();
+void clock_init(TaskHandle_t play_task);
+void clock_set_tempo(uint16_t tempo);
+uint32_t clock_get_period_us();
+uint32_t clock_now();
+uint32_t clock_next_deadline();
+
+#endif // _CLOCK_H
@@ -1,10 +1,18 @@
 #ifndef _DISPLAY_H
 #define _DISPLAY_H
 
-void num_to_str(uint8_t n, char* s, uint8_t len);
+#include <stdint.h>
+
+void display_init();
+void display_start();
+void display_serve();
+void display_print_stats();
 void display_line(char* s, uint8_t line);
 void clear_display();
-void diplay_number(uint8_t n, uint8_t line);
+void display_columns(uint8_t page, uint8_t col, const uint8_t* data, uint8_t len);
+void display_text(const char* s, uint8_t len, uint8_t line, uint8_t pos);
+void display_digits(uint32_t n, uint8_t digits, uint8_t line, uint8_t pos);
+void display_number(uint8_t n, uint8_t line);
 void clear_line(uint8_t line);
 void update_display();
 void display_piano_roll();
@@ -1,13 +1,52 @@
 #ifndef _FLASH_H
 #define _FLASH_H
 
+#include <stdint.h>
+#include "FreeRTOS.h"
+#include "semphr.h"
+
+#define FLASH_OP_READ 0
+#define FLASH_OP_FAST_READ 1
+#define FLASH_OP_PROGRAM 2
+#define FLASH_OP_ERASE_SECTOR 3
+#define FLASH_OP_ERASE_CHIP 4
+
+/*
+    a request to the flash task. a request must stay in place until it is
+    complete, the flash task only holds a pointer to it
+
+    @param op       one of the FLASH_OP_ values
+    @param addr     flash address the operation starts at
+    @param tx       data to program, or clocked out during a FLASH_OP_READ
+    @param rx       buffer the data is read into
+    @param len      number of bytes to read or program
+    @param callback called by the flash task once the request is complete,
+                    or NULL
+    @param done     given once the request is complete, or NULL
+*/
+typedef struct flash_request {
+    uint8_t op;
+    uint32_t addr;
+    uint8_t* tx;
+    uint8_t* rx;
+    uint32_t len;
+    void (*callback)(struct flash_request* r);
+    SemaphoreHandle_t done;
+} flash_request_t;
+
+void flash_init();
+void flash_submit(flash_request_t* r);
+void flash_run(flash_request_t* r);
+void flash_serve();
+
 /*
-    these functions are wrappers for those found in w25q128jv.c in the platform.
-    the wrapping allows for the use of mutexes
+    these wait for the operation to complete. the calling task sleeps while
+    the flash task carries it out, it doesn't spin
 */
 void flash_eraseSector(uint32_t addr);
 void flash_eraseChip();
-void flash_programPage(uint32_t addr, uint8_t* tx, uint8_t* rx, uint16_t len);
+void flash_programPage(uint32_t addr, uint8_t* tx, uint16_t len);
 void flash_SPIRead(uint32_t addr, uint8_t* tx, uint8_t* rx, uint32_t len);
+void flash_fastRead(uint32_t addr, uint8_t* rx, uint32_t len);
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,30 @@
+#ifndef _KEY_MATRIX_H
+#define _KEY_MATRIX_H
+
+#include <stdint.h>
+#include "FreeRTOS.h"
+
+#define KEY_PRESS 0
+#define KEY_RELEASE 1
+#define KEY_HOLD 2
+
+/*
+    a change in a key's debounced state
+
+    @param key      key code, the row in the top nibble and the column in the
+                    bottom, the codes the menu decodes
+    @param type     KEY_PRESS, KEY_RELEASE, or KEY_HOLD once a key has been
+                    down for CONFIG_KEY_HOLD_MS
+    @param time     tick count when the change was debounced
+*/
+typedef struct {
+    uint8_t key;
+    uint8_t type;
+    TickType_t time;
+} key_event_t;
+
+void key_matrix_init();
+uint8_t key_matrix_get(key_event_t* ev, TickType_t wait);
+void key_matrix_print_stats();
+
+#endif // _KEY_MATRIX_H
@@ -3,18 +3,24 @@
 
 #include "midi.h"
 
+/*
+    single producer, single consumer fifo of midi packets. head is only ever
+    written by the producer and tail only by the consumer, so one task can fill
+    the buffer while another drains it without a mutex. one slot is always left
+    empty to tell a full buffer from an empty one, so a buffer of size n holds
+    n - 1 packets
+*/
 typedef struct {
     MIDIPacket_t* buffer;
-    int16_t head;
-    int16_t max;
-    int8_t full;
+    volatile uint16_t head;
+    volatile uint16_t tail;
+    uint16_t max;
+    uint32_t overflows;
 } midi_buf_t;
 
 typedef midi_buf_t* mbuf_handle_t;
 
-mbuf_handle_t mbuf_init(MIDIPacket_t* buffer, int16_t size);
-
-void mbuf_free(mbuf_handle_t k);
+mbuf_handle_t mbuf_init(midi_buf_t* m, MIDIPacket_t* buffer, uint16_t size);
 
 void mbuf_reset(mbuf_handle_t k);
 
@@ -24,8 +30,10 @@ int8_t mbuf_empty(mbuf_handle_t k);
 
 int16_t mbuf_size(mbuf_handle_t k);
 
-void mbuf_push(mbuf_handle_t k, MIDIPacket_t d);
+int8_t mbuf_push(mbuf_handle_t k, MIDIPacket_t d);
+
+int8_t mbuf_pop(mbuf_handle_t k, MIDIPacket_t* d);
 
-void mbuf_pop(mbuf_handle_t k, MIDIPacket_t* d);
+uint32_t mbuf_overflows(mbuf_handle_t k);
 
-#endif // _MIDI_NOTE_BUFFER
\ No newline at end of file
+#endif // _MIDI_NOTE_BUFFER
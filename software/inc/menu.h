@@ -56,6 +56,9 @@ typedef enum {
     S_ST_PASTE,
     S_SQ_COPY,
     S_SQ_PASTE,
+    S_BANK,
+    S_BANK_SELECT,
+    S_SQ_VIEW,
 } MenuState_t;
 
 typedef enum {
@@ -63,6 +66,7 @@ typedef enum {
     E_TEMPO = 0x01,
     E_SQ_PRESCALE = 0x02,
     E_SQ_MIDI = 0x03,
+    E_BANK = 0x04,
     E_SHIFT = 0x05,
     E_CTRL = 0x06,
     E_QUEUE = 0x07,
@@ -71,6 +75,7 @@ typedef enum {
     E_SQ_COPY = 0x0A,
     E_SQ_PASTE = 0x0B,
     E_SQ_EDIT = 0x0C,
+    E_SQ_VIEW = 0x0D,
     E_SAVE = 0x0E,
     E_SQ_CLR = 0x0F,
     E_SQ_SELECT,
@@ -102,6 +107,8 @@ static const MenuTransition_t state_table[] = {
     {S_MAIN_MENU, E_SQ_SELECT, S_SQ_SELECT},
     {S_MAIN_MENU, E_SAVE, S_SAVE},
     {S_MAIN_MENU, E_TEMPO, S_TEMPO},
+    {S_MAIN_MENU, E_BANK, S_BANK},
+    {S_MAIN_MENU, E_SQ_VIEW, S_SQ_VIEW},
 
     {S_SQ_SELECT, E_AUTO, S_SQ_MENU},
 
@@ -117,6 +124,7 @@ static const MenuTransition_t state_table[] = {
     {S_SQ_MENU, E_SQ_PRESCALE, S_SQ_PRESCALE},
     {S_SQ_MENU, E_SQ_COPY, S_SQ_COPY},
     {S_SQ_MENU, E_SQ_PASTE, S_SQ_PASTE},
+    {S_SQ_MENU, E_SQ_VIEW, S_SQ_VIEW},
     
     {S_SQ_MIDI, E_MAIN_MENU, S_MAIN_MENU},
     {S_SQ_MIDI, E_ENCODER_UP, S_SQ_MIDI},
@@ -191,6 +199,18 @@ static const MenuTransition_t state_table[] = {
     {S_SQ_COPY, E_AUTO, S_SQ_MENU},
 
     {S_SQ_PASTE, E_AUTO, S_SQ_MENU},
+
+    {S_BANK, E_ENCODER_DOWN, S_BANK},
+    {S_BANK, E_ENCODER_UP, S_BANK},
+    {S_BANK, E_MAIN_MENU, S_MAIN_MENU},
+    {S_BANK, E_BANK, S_BANK_SELECT},
+
+    {S_BANK_SELECT, E_AUTO, S_MAIN_MENU},
+
+    {S_SQ_VIEW, E_SQ_SELECT, S_SQ_VIEW},
+    {S_SQ_VIEW, E_SQ_EN, S_SQ_EN},
+    {S_SQ_VIEW, E_SQ_VIEW, S_MAIN_MENU},
+    {S_SQ_VIEW, E_MAIN_MENU, S_MAIN_MENU},
 };
 
 #define STATE_TABLE_SIZE (sizeof(state_table) / sizeof(state_table[0]))
@@ -201,5 +221,6 @@ typedef struct {
 } StateMachine_t;
 
 void menu(uint16_t key, uint16_t hold);
+void menu_refresh();
 
 #endif // _MENU_H
\ No newline at end of file
@@ -0,0 +1,122 @@
+#ifndef _MIDI_OUT_H
+#define _MIDI_OUT_H
+
+#include "midi.h"
+#include "autoconf.h"
+
+#define NUM_MIDI_PORTS 4
+
+// largest encoding of a single channel message
+#define MIDI_OUT_MAX_MESSAGE 3
+
+// 1 start bit, 8 data bits and 1 stop bit at 31250 baud
+#define MIDI_OUT_BYTE_US 320
+
+// room for a few messages echoed from the midi input
+#define MIDI_OUT_THRU_LENGTH (MIDI_OUT_MAX_MESSAGE * 4)
+
+/*
+    MIDI_OUT_RUNNING_STATUS     leave out the status byte when it matches the
+                                previous message on the port, and send note offs
+                                as note ons with velocity 0 so that they share
+                                the note on status
+*/
+#define MIDI_OUT_RUNNING_STATUS 0x01
+
+/*
+    not a midi status. a packet with this status queued on a port sends a note
+    off for every note still sounding on the packet's channel, in place of an
+    all notes off controller
+*/
+#define MIDI_OUT_RELEASE 0x00
+
+// buffer index of the midi input echo, 0 and 1 are the step buffers
+#define MIDI_OUT_THRU 2
+#define MIDI_OUT_NO_BUFFER 0xFF
+
+/*
+    each port has two step transmit buffers. one is filled with the next step
+    while the other is sent by dma
+
+    @param fill     step buffer the encoder is writing into
+    @param active   buffer the dma is sending, MIDI_OUT_NO_BUFFER if idle
+    @param pending  step buffer waiting for the dma to finish
+    @param tx_start master clock count when the last dma transfer started
+    @param tx_end   master clock count when the last dma transfer finished
+    @param active_notes one bit per note sounding on each channel, as queued
+    @param overloaded   the step being filled has gone over the byte budget
+    @param overloads    steps that went over the byte budget
+    @param notes_dropped    note ons left out to keep a step within budget
+*/
+typedef struct {
+    USART_TypeDef* uart;
+    DMA_Stream_TypeDef* dma;
+    volatile uint32_t* dma_isr;
+    volatile uint32_t* dma_ifcr;
+    uint32_t dma_flags;
+    uint32_t dma_tc;
+    uint32_t dma_cr;
+
+    uint8_t tx[2][CONFIG_MIDI_TX_BUFFER_LENGTH] __attribute__((aligned(32)));
+    uint16_t tx_len[2];
+    uint8_t thru[MIDI_OUT_THRU_LENGTH] __attribute__((aligned(32)));
+    volatile uint8_t thru_len;
+
+    uint8_t fill;
+    volatile uint8_t active;
+    volatile uint8_t pending;
+    volatile uint32_t tx_start;
+    volatile uint32_t tx_end;
+
+    uint8_t flags;
+    uint8_t running_status;
+    uint32_t bytes;
+    uint32_t bytes_saved;
+    uint32_t dropped;
+
+    uint32_t active_notes[16][4];
+
+    uint8_t overloaded;
+    uint32_t overloads;
+    uint32_t notes_dropped;
+} midi_port_t;
+
+void midi_out_init();
+midi_port_t* midi_out_port(uint8_t port);
+uint8_t midi_out_encode(midi_port_t* m, MIDIPacket_t* p, uint8_t* buf);
+uint8_t midi_out_cost(midi_port_t* m, MIDIPacket_t* p);
+uint16_t midi_out_budget(uint32_t period_us);
+void midi_out_lock();
+void midi_out_unlock();
+void midi_out_queue(uint8_t port, MIDIPacket_t* p);
+void midi_out_note(uint8_t port, MIDIPacket_t* p);
+void midi_out_control(uint8_t port, MIDICC_t* cc);
+void midi_out_release(uint8_t port, uint8_t channel);
+void midi_out_commit();
+void midi_out_thru(uint8_t port, MIDIPacket_t* p);
+void midi_out_set_flags(uint8_t port, uint8_t flags);
+void midi_out_print_stats();
+
+#ifdef CONFIG_MIDI_OUT_TRACE
+/*
+    the header of a step buffer in the trace, its bytes follow it. the step
+    number makes the trace the same from run to run whatever the interrupt
+    timing, the clock count shows when the step was actually handed over
+
+    @param step     number of steps committed since start up
+    @param now      master clock count at the commit
+    @param port     index of the port (0-3)
+    @param len      number of midi bytes
+*/
+typedef struct {
+    uint32_t step;
+    uint32_t now;
+    uint8_t port;
+    uint16_t len;
+} midi_out_trace_t;
+
+uint8_t midi_out_trace_read(midi_out_trace_t* t, uint8_t* data);
+uint32_t midi_out_trace_dropped();
+#endif
+
+#endif // _MIDI_OUT_H
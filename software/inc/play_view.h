@@ -0,0 +1,9 @@
+#ifndef _PLAY_VIEW_H
+#define _PLAY_VIEW_H
+
+#include <stdint.h>
+
+void play_view_reset();
+void play_view_update(uint8_t sq_index);
+
+#endif // _PLAY_VIEW_H
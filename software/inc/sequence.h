@@ -16,20 +16,45 @@ typedef struct {
     MIDINote_t note_off[CONFIG_MAX_POLYPHONY];
 } step_t;
 
+typedef struct {
+    uint8_t note_off;
+    uint8_t note_on;
+} step_events_t;
+
+/*
+    what the ui shows of playback, see read_play_snapshot()
+
+    @param playing      bit field of the sequences playing
+    @param playhead     the step each playing sequence rendered last, the one
+                        sent on the next clock edge. only valid for the
+                        sequences playing
+*/
+typedef struct {
+    uint32_t playing[2];
+    uint8_t playhead[CONFIG_TOTAL_SEQUENCES];
+} play_snapshot_t;
+
 uint8_t init_sequences();
 uint32_t get_step_data_offset(uint8_t sq_index);
 void toggle_sequence(uint8_t seq);
 void toggle_sequences(uint32_t* select_mask, uint8_t max);
 void enable_sequence(uint8_t sq_index);
 void disable_sequence(uint8_t sq_index);
-void load_sequences(UARTTaskParams_t* port_buffers, uint8_t num_ports);
+void load_sequences(port_buffers_t* port_buffers, uint8_t num_ports);
 void break_sequence(uint8_t sq_index);
 void clear_sequence(uint8_t sq_index);
-void save_data();
-void play_notes(mbuf_handle_t m, USART_TypeDef* port);
+void play_notes(mbuf_handle_t m, uint8_t port);
 void set_midi_channel(uint8_t sq_index, MIDIChannel_t channel);
 MIDIChannel_t get_channel(uint8_t sq_index);
 uint8_t is_sq_enabled(uint8_t sq_index);
-step_t get_step_from_index(uint16_t st_index);
+uint8_t num_enabled_sequences();
+step_t* get_step_from_index(uint16_t st_index);
+void compile_step(uint16_t st_index);
+void compile_sequence(uint8_t sq_index);
+void compile_steps(step_t* st, step_events_t* ev);
+void play_steps_from(uint8_t sq_index, const step_t* st, const step_events_t* ev);
+void adopt_steps(uint8_t sq_index, const step_t* st, const step_events_t* ev);
+void release_sequences(port_buffers_t* port_buffers, uint8_t num_ports);
+void read_play_snapshot(play_snapshot_t* s);
 
 #endif // _SEQUENCE_H
\ No newline at end of file
@@ -0,0 +1,129 @@
+#ifndef _STORE_H
+#define _STORE_H
+
+#include <stdint.h>
+#include "tasks.h"
+#include "autoconf.h"
+
+#define STORE_SECTOR_SIZE 0x1000
+#define STORE_PAGE_SIZE 0x100
+#define STORE_PAGES_PER_SECTOR (STORE_SECTOR_SIZE / STORE_PAGE_SIZE)
+
+#define STORE_MAGIC 0x5351
+
+/*
+    the version written in every record's header. a record with any other
+    version is skipped, so older firmware never misreads a newer format and a
+    change of format is detected record by record
+*/
+#define STORE_FORMAT_VERSION 1
+
+#define STORE_RECORD_METADATA 0x01
+#define STORE_RECORD_SEQUENCE 0x02
+#define STORE_RECORD_CHECKPOINT 0x03
+#define STORE_RECORD_INDEX 0x04
+
+// number of sequences held in a metadata record
+#define STORE_SEQS_PER_RECORD 16
+
+#define STORE_METADATA_RECORDS (CONFIG_TOTAL_SEQUENCES / STORE_SEQS_PER_RECORD)
+
+/*
+    a bank has a block for each metadata record followed by one for the steps
+    of each sequence. the blocks of every bank are indexed, one bank after
+    another
+*/
+#define STORE_BANK_BLOCKS (STORE_METADATA_RECORDS + CONFIG_TOTAL_SEQUENCES)
+#define STORE_RECORDS (CONFIG_STORE_BANKS * STORE_BANK_BLOCKS)
+
+#define STORE_NO_RECORD 0xFFFFFFFF
+#define STORE_NO_PAGE 0xFFFF
+#define STORE_NO_BANK 0xFF
+
+/*
+    checkpoints and index records are versioned apart from the other records,
+    their layout changes with the banks
+*/
+#define STORE_CHECKPOINT_VERSION 1
+
+// what store_save() did
+#define STORE_SAVE_OK 0
+#define STORE_SAVE_FULL 1
+
+// what store_swap_bank() did
+#define STORE_SWAP_NONE 0
+#define STORE_SWAP_DONE 1
+#define STORE_SWAP_DIRTY 2
+#define STORE_SWAP_RESTAGE 3
+
+/*
+    every record starts on a page of its own, and takes as many pages after it
+    as its payload needs. the crc covers the header, with crc set to 0, and the
+    payload
+
+    @param magic    STORE_MAGIC, an erased page reads 0xFFFF
+    @param type     STORE_RECORD_METADATA or STORE_RECORD_SEQUENCE
+    @param version  STORE_FORMAT_VERSION
+    @param index    which block of sequences, or which sequence, the payload
+                    holds. the bank is counted in, a metadata record of bank b
+                    has an index of b * STORE_METADATA_RECORDS onwards and a
+                    sequence of bank b one of b * CONFIG_TOTAL_SEQUENCES
+                    onwards, so the records of bank 0 read the same as before
+                    there were banks
+    @param length   number of payload bytes following the header
+    @param seq_no   incremented for every record written, the record with the
+                    highest seq_no for a block is the current one
+*/
+typedef struct {
+    uint16_t magic;
+    uint8_t type;
+    uint8_t version;
+    uint16_t index;
+    uint16_t length;
+    uint32_t seq_no;
+    uint32_t crc;
+} store_header_t;
+
+/*
+    the two sectors following the log hold the checkpoints, taken after every
+    save and compaction. the checkpoint is written with a store_header_t in
+    front of it, its seq_no taken from the log's. the record index of each
+    bank is appended to the log as a STORE_RECORD_INDEX record, which holds
+    the page the current record of each of the bank's blocks starts on,
+    counted from CONFIG_STORE_BASE_ADDR, or STORE_NO_PAGE. the checkpoint
+    only holds where those are, so it fits in a page
+
+    @param head_sector      sector the next record goes in
+    @param head_page        page the next record goes in
+    @param bank             the bank in ram when the checkpoint was written
+    @param free_sectors     erased sectors following the head
+    @param next_seq_no      seq_no of the next record
+    @param index_page       page the index record of each bank starts on,
+                            STORE_NO_PAGE for a bank with no records
+*/
+typedef struct {
+    uint16_t head_sector;
+    uint8_t head_page;
+    uint8_t bank;
+    uint16_t free_sectors;
+    uint16_t reserved;
+    uint32_t next_seq_no;
+    uint16_t index_page[CONFIG_STORE_BANKS];
+} store_checkpoint_t;
+
+void store_load();
+void store_load_sequence(uint8_t sq_index);
+uint32_t store_loaded_mask(uint8_t w);
+void store_mark_step(uint16_t st_index);
+void store_mark_metadata(uint8_t sq_index);
+void store_preserve_step(uint16_t st_index);
+void store_preserve_sequence(uint8_t sq_index);
+void store_preserve_metadata(uint8_t sq_index);
+uint8_t store_save();
+void store_compact();
+void store_select_bank(uint8_t bank);
+void store_stage_bank();
+uint8_t store_swap_bank(port_buffers_t* port_buffers, uint8_t num_ports);
+uint8_t store_bank();
+
+#endif // _STORE_H
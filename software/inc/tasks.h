@@ -2,12 +2,24 @@
 #define _TASKS_H
 
 #include "m_buf.h"
+#include "midi_out.h"
 
 typedef struct {
-    USART_TypeDef* port;
+    uint8_t port;
     mbuf_handle_t note_on;
     mbuf_handle_t note_off;
-} UARTTaskParams_t;
+} port_buffers_t;
+
+/*
+    notification bits of the save task
+
+    SAVE_TASK_SAVE  save the sequences in ram
+    SAVE_TASK_BANK  save them and read in the bank picked by store_select_bank()
+    SAVE_TASK_LOAD  load the sequences of a bank swapped in that weren't playing
+*/
+#define SAVE_TASK_SAVE 0x01
+#define SAVE_TASK_BANK 0x02
+#define SAVE_TASK_LOAD 0x04
 
 void sq_play_task();
 
@@ -15,4 +27,20 @@ void key_scan_task();
 
 void save_task();
 
+void flash_task();
+
+void display_task();
+
+void prefetch_task();
+
+void print_note_buffer_stats();
+
+#ifdef CONFIG_MIDI_OUT_TRACE
+void trace_task();
+#endif
+
+#ifdef CONFIG_PROFILE_TICK
+void print_tick_profile();
+#endif
+
 #endif // _TASKS_H
\ No newline at end of file
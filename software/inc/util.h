@@ -12,5 +12,7 @@ void set_bit_range(uint32_t* field, uint8_t start, uint8_t end, uint8_t max);
 uint8_t one_bit_set(uint32_t* field);
 uint8_t find_last_bit(uint32_t* field);
 uint8_t find_first_bit(uint32_t* field);
+uint8_t u32_to_str(uint32_t n, char* s);
+uint32_t crc32(uint32_t crc, uint8_t* data, uint32_t len);
 
 #endif // _UTIL_H
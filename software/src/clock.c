@@ -0,0 +1,145 @@
+#include "FreeRTOSConfig.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "clock.h"
+#include "autoconf.h"
+#include "stm32f722xx.h"
+
+/*
+    the master clock runs off TIM2, a 32 bit timer counting in microseconds. the
+    counter free runs and capture/compare channel 1 is loaded with the absolute
+    timer count of the next step. because every deadline is derived from the
+    previous deadline, and not from when the play task got round to running,
+    interrupt latency and task preemption never accumulate into tempo drift
+*/
+
+#define US_PER_MINUTE_PER_16TH 15000000
+
+/*
+    the period of CONFIG_TEMPO is there from start up, so midi_out_init() can
+    size the byte budget of the first step before the clock is started
+*/
+static master_clock_t clk = {
+    .whole = US_PER_MINUTE_PER_16TH / CONFIG_TEMPO,
+    .rem = US_PER_MINUTE_PER_16TH % CONFIG_TEMPO,
+    .den = CONFIG_TEMPO,
+};
+static TaskHandle_t clock_task;
+
+/*
+    the APB1 timers run at the APB1 clock when its prescaler is 1 and at twice
+    the APB1 clock otherwise. SystemCoreClock is HCLK
+
+    @return the clock of TIM2 to TIM7 in Hz
+*/
+uint32_t clock_timer_hz() {
+    static const uint8_t apb_div[8] = {1, 1, 1, 1, 2, 4, 8, 16};
+    uint8_t div = apb_div[(RCC->CFGR & RCC_CFGR_PPRE1) >> RCC_CFGR_PPRE1_Pos];
+
+    if(div == 1) {
+        return SystemCoreClock;
+    }
+
+    return (SystemCoreClock / div) * 2;
+}
+
+/*
+    set the step period for a tempo. the remainder accumulator is reset so the
+    new tempo starts cleanly from the current deadline
+
+    @param c        clock state
+    @param tempo    tempo in bpm, one step is a 16th note
+*/
+void clock_set_period(master_clock_t* c, uint16_t tempo) {
+    if(tempo == 0) {
+        tempo = 1;
+    }
+
+    c->whole = US_PER_MINUTE_PER_16TH / tempo;
+    c->rem = US_PER_MINUTE_PER_16TH % tempo;
+    c->den = tempo;
+    c->acc = 0;
+}
+
+/*
+    move the deadline on by one step period. the fractional part of the period
+    is accumulated and an extra microsecond is added whenever it adds up to a
+    whole one
+
+    @param c    clock state
+
+    @return the new deadline in timer counts
+*/
+uint32_t clock_advance(master_clock_t* c) {
+    uint32_t period = c->whole;
+
+    c->acc += c->rem;
+    if(c->acc >= c->den) {
+        c->acc -= c->den;
+        period++;
+    }
+
+    c->deadline += period;
+
+    return c->deadline;
+}
+
+/*
+    start the master clock. the play task is notified once per step
+
+    @param play_task    handle of the task to wake on every step
+*/
+void clock_init(TaskHandle_t play_task) {
+    clock_task = play_task;
+    clock_set_period(&clk, CONFIG_TEMPO);
+
+    RCC->APB1ENR |= RCC_APB1ENR_TIM2EN;
+
+    // 1 count per microsecond
+    TIM2->CR1 = 0;
+    TIM2->PSC = (clock_timer_hz() / 1000000) - 1;
+    TIM2->ARR = 0xFFFFFFFF;
+    TIM2->EGR = TIM_EGR_UG;
+    TIM2->SR = 0;
+
+    // the first step is played 1ms after the clock starts
+    clk.deadline = TIM2->CNT + 1000;
+    TIM2->CCR1 = clk.deadline;
+    TIM2->DIER |= TIM_DIER_CC1IE;
+
+    // the isr uses the FromISR api so it must sit below the syscall priority
+    NVIC_SetPriority(TIM2_IRQn, configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY + 1);
+    NVIC_EnableIRQ(TIM2_IRQn);
+
+    TIM2->CR1 |= TIM_CR1_CEN;
+}
+
+void clock_set_tempo(uint16_t tempo) {
+    taskENTER_CRITICAL();
+    clock_set_period(&clk, tempo);
+    taskEXIT_CRITICAL();
+}
+
+uint32_t clock_get_period_us() {
+    return clk.whole;
+}
+
+uint32_t clock_now() {
+    return TIM2->CNT;
+}
+
+uint32_t clock_next_deadline() {
+    return clk.deadline;
+}
+
+void TIM2_IRQHandler(void) {
+    if(TIM2->SR & TIM_SR_CC1IF) {
+        TIM2->SR &= ~TIM_SR_CC1IF;
+
+        TIM2->CCR1 = clock_advance(&clk);
+
+        BaseType_t woken = pdFALSE;
+        vTaskNotifyGiveFromISR(clock_task, &woken);
+        portYIELD_FROM_ISR(woken);
+    }
+}
@@ -5,84 +5,362 @@
 #include "common.h"
 #include "midi.h"
 #include "uart.h"
+#include "util.h"
+#include "FreeRTOSConfig.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+#include "stm32f722xx.h"
+
+/*
+    drawing only changes display_buffer and marks the columns it touched in
+    each ssd1306 page. update_display(), called by menu() once after each key
+    press, copies the marked columns into the frame and wakes the display
+    task. the display task owns the panel, it sends at most CONFIG_DISPLAY_FPS
+    frames a second, and every page of a frame in one dma transfer after
+    trimming off any columns at either end that already match what the panel
+    shows. drawing done while a frame waits is merged into it, and counted as
+    a dropped frame
+*/
+#define DISPLAY_PAGES (DISPLAY_BUFFER_SIZE / WIDTH)
+
+// a 16px character and the blank column after it, and how many fit a line
+#define DISPLAY_CHAR_WIDTH (FONT16_WIDTH + 1)
+#define DISPLAY_LINE_CHARS (WIDTH / DISPLAY_CHAR_WIDTH)
+
+// the i2c bus and address init_i2c() and init_ssd1306() set up
+#define DISPLAY_I2C I2C1
+#define DISPLAY_ADDR 0x3C
+
+// i2c1 tx is dma1 stream 7 channel 1, its flags are at bit 22 of HISR
+#define DISPLAY_DMA DMA1_Stream7
+#define DISPLAY_DMA_CHANNEL 1
+#define DISPLAY_DMA_FLAGS (0x3D << 22)
+
+#define DISPLAY_PERIOD pdMS_TO_TICKS(1000 / CONFIG_DISPLAY_FPS)
+
+// a page takes about 3ms at 400kHz, give up on a transfer well after that
+#define DISPLAY_TIMEOUT pdMS_TO_TICKS(20)
+
+#define SSD1306_CONTROL_COMMAND 0x00
+#define SSD1306_CONTROL_DATA 0x40
+#define SSD1306_MEMORY_MODE 0x20
+#define SSD1306_HORIZONTAL 0x00
+#define SSD1306_COLUMN_ADDR 0x21
+#define SSD1306_PAGE_ADDR 0x22
 
 extern uint8_t display_buffer[DISPLAY_BUFFER_SIZE];
+extern TaskHandle_t displayTask;
+
+/*
+    the first and last column of each page drawn on since the last update. a
+    page is clean when its first column is past its last
+*/
+static uint8_t dirty_first[DISPLAY_PAGES];
+static uint8_t dirty_last[DISPLAY_PAGES];
+
+/*
+    the frame handed to the display task, and the columns of each page
+    updated since it last took them. both sides only touch these with the
+    scheduler suspended
+*/
+static uint8_t frame[DISPLAY_BUFFER_SIZE];
+static uint8_t frame_first[DISPLAY_PAGES];
+static uint8_t frame_last[DISPLAY_PAGES];
+static uint8_t frame_pending;
+
+// the frame as last sent to the panel, only the display task uses it
+static uint8_t shown[DISPLAY_BUFFER_SIZE];
+
+/*
+    what the dma sends, the control byte followed by the commands or the
+    columns of a page. aligned to a cache line so cleaning them leaves the
+    neighbours alone
+*/
+static uint8_t cmd_tx[32] __attribute__((aligned(32)));
+static uint8_t data_tx[WIDTH + 1] __attribute__((aligned(32)));
+
+static SemaphoreHandle_t i2c_done;
+static volatile uint8_t i2c_nack;
+static TickType_t last_frame;
+
+static uint32_t frames_sent;
+static uint32_t frames_dropped;
+static uint32_t i2c_errors;
+
+/*
+    mark a run of display_buffer as drawn on, the run may cross pages
+
+    @param index    index of the first byte in display_buffer
+    @param len      number of bytes
+*/
+static void mark_dirty(uint16_t index, uint16_t len) {
+    uint16_t end = index + len;
+
+    if(end > DISPLAY_BUFFER_SIZE) {
+        end = DISPLAY_BUFFER_SIZE;
+    }
+
+    while(index < end) {
+        uint8_t page = index / WIDTH;
+        uint16_t page_end = (page + 1) * WIDTH;
+        uint8_t first = index % WIDTH;
+        uint8_t last = ((end < page_end) ? end : page_end) - 1 - (page * WIDTH);
+
+        if(first < dirty_first[page]) {
+            dirty_first[page] = first;
+        }
+
+        // a clean page's last column is 0, so this holds for it too
+        if(last > dirty_last[page]) {
+            dirty_last[page] = last;
+        }
+
+        index = page_end;
+    }
+}
+
+/*
+    send a buffer to the ssd1306 in one i2c transfer and sleep until the stop
+    condition. only the display task calls this
+
+    @param buf      the control byte followed by the commands or data
+    @param len      number of bytes, control byte included
+    @return         0 on success, 1 if the panel didn't acknowledge or the
+                    transfer never finished
+*/
+static uint8_t i2c_send(uint8_t* buf, uint8_t len) {
+    uint8_t err = 0;
+
+    // the buffer may still be sitting in the data cache
+    SCB_CleanDCache_by_Addr((uint32_t*)buf, len);
+
+    DMA1->HIFCR = DISPLAY_DMA_FLAGS;
+    DISPLAY_DMA->M0AR = (uint32_t)buf;
+    DISPLAY_DMA->NDTR = len;
+    DISPLAY_DMA->CR = (DISPLAY_DMA_CHANNEL << DMA_SxCR_CHSEL_Pos) | DMA_SxCR_MINC | DMA_SxCR_DIR_0 | DMA_SxCR_EN;
+
+    i2c_nack = 0;
+
+    DISPLAY_I2C->CR2 = (DISPLAY_ADDR << 1)
+        | ((uint32_t)len << I2C_CR2_NBYTES_Pos)
+        | I2C_CR2_AUTOEND
+        | I2C_CR2_START;
+
+    if(xSemaphoreTake(i2c_done, DISPLAY_TIMEOUT) != pdTRUE) {
+        // reset the peripheral, clearing a transfer stuck on the bus
+        DISPLAY_I2C->CR1 &= ~I2C_CR1_PE;
+        while(DISPLAY_I2C->CR1 & I2C_CR1_PE);
+        DISPLAY_I2C->CR1 |= I2C_CR1_PE;
+        err = 1;
+    }
+
+    if(i2c_nack) {
+        err = 1;
+    }
+
+    // after a nack the stream is left holding the bytes that weren't sent
+    DISPLAY_DMA->CR = 0;
+    while(DISPLAY_DMA->CR & DMA_SxCR_EN);
+
+    if(err) {
+        i2c_errors++;
+    }
 
-static uint16_t utf_to_index(char c) {
-    return c * 5;
+    return err;
 }
 
-void num_to_str(uint8_t n, char* s, uint8_t len) {
-    while(len > 0) {
-        uint8_t i = (n % 10);
-        s[len-1] = i + 48;
-        n /= 10;
-        len--;
+void I2C1_EV_IRQHandler(void) {
+    BaseType_t woken = pdFALSE;
+    uint32_t isr = DISPLAY_I2C->ISR;
+
+    // autoend follows a nack with a stop, which ends the transfer below
+    if(isr & I2C_ISR_NACKF) {
+        i2c_nack = 1;
+        DISPLAY_I2C->ICR = I2C_ICR_NACKCF;
     }
+
+    if(isr & I2C_ISR_STOPF) {
+        DISPLAY_I2C->ICR = I2C_ICR_STOPCF;
+        xSemaphoreGiveFromISR(i2c_done, &woken);
+    }
+
+    portYIELD_FROM_ISR(woken);
+}
+
+/*
+    called once after init_ssd1306(), before the scheduler starts. from here
+    on only the display task talks to the panel, through the dma. what the
+    panel shows isn't known, so the first frame sends every page
+*/
+void display_init() {
+    i2c_done = xSemaphoreCreateBinary();
+
+    memset(shown, 0xFF, sizeof(shown));
+    memset(frame_first, WIDTH, sizeof(frame_first));
+    memset(frame_last, 0, sizeof(frame_last));
+    mark_dirty(0, DISPLAY_BUFFER_SIZE);
+
+    RCC->AHB1ENR |= RCC_AHB1ENR_DMA1EN;
+
+    DISPLAY_DMA->CR = 0;
+    DISPLAY_DMA->PAR = (uint32_t)&DISPLAY_I2C->TXDR;
+
+    DISPLAY_I2C->CR1 |= I2C_CR1_TXDMAEN | I2C_CR1_STOPIE | I2C_CR1_NACKIE;
+
+    NVIC_SetPriority(I2C1_EV_IRQn, configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY + 1);
+    NVIC_EnableIRQ(I2C1_EV_IRQn);
+}
+
+/*
+    called by the display task before it serves any frame. the column and
+    page address commands used to send part of a page only take effect in
+    horizontal addressing mode
+*/
+void display_start() {
+    cmd_tx[0] = SSD1306_CONTROL_COMMAND;
+    cmd_tx[1] = SSD1306_MEMORY_MODE;
+    cmd_tx[2] = SSD1306_HORIZONTAL;
+
+    i2c_send(cmd_tx, 3);
+
+    last_frame = xTaskGetTickCount() - DISPLAY_PERIOD;
 }
 
 void _display_line(char* s, uint8_t line) {
     uint16_t line_index = line * WIDTH;
-    uint16_t eol = line_index + WIDTH-1;
+    uint16_t eol = line_index + WIDTH - 5;
     uint16_t string_index = 0;
 
     char c = s[string_index];
 
     memset(display_buffer + line_index, 0, WIDTH);
+    mark_dirty(line_index, WIDTH);
 
-    while(line_index < eol && c != '\0') {
-        uint16_t utf = utf_to_index(c);
-        c = s[++string_index];
+    while(line_index <= eol && c != '\0') {
+        // font has a glyph for every byte, the cast keeps the top half positive
+        memcpy(&display_buffer[line_index], &font[(uint8_t)c * 5], 5);
 
-        memcpy(&display_buffer[line_index], &font[utf], 5);
-        line_index+=6;
+        c = s[++string_index];
+        line_index += 6;
     }
+}
 
-    display_ssd1306(display_buffer);
+/*
+    copy a run of columns into one page of display_buffer
+
+    @param page     ssd1306 page, 8 rows high
+    @param col      first column
+    @param data     one byte per column, bit 0 the top row
+    @param len      number of columns, the run must stay inside the page
+*/
+void display_columns(uint8_t page, uint8_t col, const uint8_t* data, uint8_t len) {
+    uint16_t index = (page * WIDTH) + col;
+
+    memcpy(&display_buffer[index], data, len);
+    mark_dirty(index, len);
 }
 
 void clear_display() {
     memset(display_buffer, 0, DISPLAY_BUFFER_SIZE);
+    mark_dirty(0, DISPLAY_BUFFER_SIZE);
 }
 
-static uint16_t utf_to_font16(uint16_t utf) {
-    if(utf > 47 && utf < 58) {
-        return (1 + (utf - 48)) * 20;
-    } else if(utf > 64 && utf < 90) {
-        return (11 + (utf - 65)) * 20;
-    } else if(utf == 32) {
-        return 0;
-    } 
-    else {
-        return 0xFFFF;
+/*
+    the 16px font glyph for a byte, its top page followed by its bottom page.
+    bytes outside the printable range, which the font has no glyph for, show
+    as a space
+*/
+static const uint8_t* glyph16(char c) {
+    uint8_t i = (uint8_t)c - FONT16_FIRST;
+
+    if(i >= FONT16_GLYPHS) {
+        i = 0;
     }
+
+    return &font16[i][0][0];
+}
+
+/*
+    draw a fixed number of characters in the 16px font, each glyph written
+    straight into both pages of the line with the column after it blanked.
+    characters that would run off the end of the line are dropped
+
+    @param s        characters to draw, not needing a terminator
+    @param len      number of characters
+    @param line     line of the display, 0 to 3
+    @param pos      character position on the line the first one goes in
+*/
+void display_text(const char* s, uint8_t len, uint8_t line, uint8_t pos) {
+    if(line > 3 || pos >= DISPLAY_LINE_CHARS) {
+        return;
+    }
+
+    if(len > DISPLAY_LINE_CHARS - pos) {
+        len = DISPLAY_LINE_CHARS - pos;
+    }
+
+    uint16_t start = (line * (WIDTH * 2)) + (pos * DISPLAY_CHAR_WIDTH);
+    uint8_t* top = &display_buffer[start];
+    uint8_t* bottom = top + WIDTH;
+
+    for(uint8_t i = 0; i < len; i++) {
+        const uint8_t* g = glyph16(s[i]);
+
+        for(uint8_t col = 0; col < FONT16_WIDTH; col++) {
+            top[col] = g[col];
+            bottom[col] = g[FONT16_WIDTH + col];
+        }
+
+        top[FONT16_WIDTH] = 0;
+        bottom[FONT16_WIDTH] = 0;
+
+        top += DISPLAY_CHAR_WIDTH;
+        bottom += DISPLAY_CHAR_WIDTH;
+    }
+
+    mark_dirty(start, len * DISPLAY_CHAR_WIDTH);
+    mark_dirty(start + WIDTH, len * DISPLAY_CHAR_WIDTH);
 }
 
 void display_line(char* s, uint8_t line) {
-    uint16_t string_index = 0;
-    char c = s[string_index];
-    
-    uint16_t line_index = line * (WIDTH * 2);
-    uint16_t eol = line_index + WIDTH-1;
-    
-    while(c != '\0' && line_index < eol) {
-        uint16_t font16_index = utf_to_font16((uint16_t)(c));
-    
-        memcpy(&display_buffer[line_index], &font16[font16_index], 10);
-        memcpy(&display_buffer[line_index + WIDTH], &font16[font16_index+10], 10);
+    uint8_t len = 0;
 
-        c = s[++string_index];
-        line_index += 11;
+    while(len < DISPLAY_LINE_CHARS && s[len] != '\0') {
+        len++;
     }
 
-    display_ssd1306(display_buffer);
+    display_text(s, len, line, 0);
+}
+
+/*
+    draw a number in the 16px font, padded with leading zeros. digits past the
+    width are dropped from the front
+
+    @param n        the number
+    @param digits   number of digits drawn, at most 10
+    @param line     line of the display, 0 to 3
+    @param pos      character position on the line the first digit goes in
+*/
+void display_digits(uint32_t n, uint8_t digits, uint8_t line, uint8_t pos) {
+    char s[11];
+    uint8_t len = u32_to_str(n, s);
+
+    if(digits > 10) {
+        digits = 10;
+    }
+
+    if(len >= digits) {
+        display_text(&s[len - digits], digits, line, pos);
+        return;
+    }
+
+    display_text("0000000000", digits - len, line, pos);
+    display_text(s, len, line, pos + digits - len);
 }
 
 void display_number(uint8_t n, uint8_t line) {
-    char s[4];
-    memset(s, '\0', 4);
-    num_to_str(n, s, 3);
-    display_line(s, line);
+    display_digits(n, 3, line, 0);
 }
 
 void clear_line(uint8_t line) {
@@ -99,10 +377,169 @@ void clear_line(uint8_t line) {
 
     memset(&display_buffer[line_index], 0, WIDTH);
     memset(&display_buffer[line_index+WIDTH], 0, WIDTH);
+    mark_dirty(line_index, WIDTH * 2);
 }
 
+/*
+    hand the columns drawn on since the last update to the display task.
+    this never waits on the panel, if the display task hasn't taken the last
+    frame yet the two are merged and the last is counted as dropped. menu()
+    draws the first screen in setup(), before the scheduler is started, when
+    there is nothing to suspend
+*/
 void update_display() {
-    display_ssd1306(display_buffer);
+    uint8_t updated = 0;
+    uint8_t running = xTaskGetSchedulerState() != taskSCHEDULER_NOT_STARTED;
+
+    if(running) {
+        vTaskSuspendAll();
+    }
+
+    for(uint8_t page = 0; page < DISPLAY_PAGES; page++) {
+        uint8_t first = dirty_first[page];
+        uint8_t last = dirty_last[page];
+        uint16_t base = page * WIDTH;
+
+        dirty_first[page] = WIDTH;
+        dirty_last[page] = 0;
+
+        if(first > last) {
+            continue;
+        }
+
+        memcpy(&frame[base + first], &display_buffer[base + first], last - first + 1);
+
+        if(first < frame_first[page]) {
+            frame_first[page] = first;
+        }
+
+        if(last > frame_last[page]) {
+            frame_last[page] = last;
+        }
+
+        updated = 1;
+    }
+
+    if(updated) {
+        if(frame_pending) {
+            frames_dropped++;
+        }
+
+        frame_pending = 1;
+    }
+
+    if(running) {
+        xTaskResumeAll();
+    }
+
+    // before the display task exists the frame waits for it to start
+    if(updated && displayTask != NULL) {
+        xTaskNotifyGive(displayTask);
+    }
+}
+
+/*
+    called by the display task when woken. waits out the rest of the frame
+    period, then sends what changed in the frame one page at a time. each
+    page is copied out with the scheduler suspended, so the ui can update the
+    frame while a page is on the bus. a frame only counts as sent if a page
+    of it went out, one that matched what the panel shows or failed doesn't
+*/
+void display_serve() {
+    uint8_t sent = 0;
+
+    if(!frame_pending) {
+        return;
+    }
+
+    TickType_t elapsed = xTaskGetTickCount() - last_frame;
+
+    if(elapsed < DISPLAY_PERIOD) {
+        vTaskDelay(DISPLAY_PERIOD - elapsed);
+    }
+
+    last_frame = xTaskGetTickCount();
+
+    vTaskSuspendAll();
+    frame_pending = 0;
+    xTaskResumeAll();
+
+    for(uint8_t page = 0; page < DISPLAY_PAGES; page++) {
+        uint16_t base = page * WIDTH;
+        uint8_t len = 0;
+
+        vTaskSuspendAll();
+
+        uint8_t first = frame_first[page];
+        uint8_t last = frame_last[page];
+
+        frame_first[page] = WIDTH;
+        frame_last[page] = 0;
+
+        while(first <= last && frame[base + first] == shown[base + first]) {
+            first++;
+        }
+
+        while(last > first && frame[base + last] == shown[base + last]) {
+            last--;
+        }
+
+        if(first <= last) {
+            len = last - first + 1;
+            memcpy(&data_tx[1], &frame[base + first], len);
+            memcpy(&shown[base + first], &frame[base + first], len);
+        }
+
+        xTaskResumeAll();
+
+        if(len == 0) {
+            continue;
+        }
+
+        cmd_tx[0] = SSD1306_CONTROL_COMMAND;
+        cmd_tx[1] = SSD1306_COLUMN_ADDR;
+        cmd_tx[2] = first;
+        cmd_tx[3] = last;
+        cmd_tx[4] = SSD1306_PAGE_ADDR;
+        cmd_tx[5] = page;
+        cmd_tx[6] = page;
+
+        data_tx[0] = SSD1306_CONTROL_DATA;
+
+        if(i2c_send(cmd_tx, 7) || i2c_send(data_tx, len + 1)) {
+            // what the panel shows of the page is unknown, send all of it next frame
+            vTaskSuspendAll();
+            memset(&shown[base], 0xFF, WIDTH);
+            frame_first[page] = 0;
+            frame_last[page] = WIDTH - 1;
+            frame_pending = 1;
+            xTaskResumeAll();
+
+            xTaskNotifyGive(displayTask);
+        } else {
+            sent = 1;
+        }
+    }
+
+    if(sent) {
+        frames_sent++;
+    }
+}
+
+void display_print_stats() {
+    char s[11];
+    uint8_t len;
+
+    send_uart(USART3, "display frames ", 15);
+    len = u32_to_str(frames_sent, s);
+    send_uart(USART3, s, len);
+    send_uart(USART3, " dropped ", 9);
+    len = u32_to_str(frames_dropped, s);
+    send_uart(USART3, s, len);
+    send_uart(USART3, " i2c errors ", 12);
+    len = u32_to_str(i2c_errors, s);
+    send_uart(USART3, s, len);
+    send_uart(USART3, "\n\r", 2);
 }
 
 void clear_and_update() {
@@ -116,6 +553,7 @@ void display_piano_roll() {
     uint8_t line = 3;
     uint16_t line_index = line * (WIDTH * 2);
 
+    // clear_line() marks both pages of the line
     clear_line(3);
 
     uint8_t black_key_width = 9;
@@ -151,6 +589,8 @@ void show_note(uint8_t note) {
 
     uint8_t note_class = note%12;
 
+    mark_dirty(line_index, WIDTH * 2);
+
     switch(note_class) {
         // C, F
         case 0:
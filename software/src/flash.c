@@ -1,33 +1,446 @@
 #include "w25q128jv.h"
+#include "spi.h"
 #include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
 #include "semphr.h"
+#include "flash.h"
+#include "autoconf.h"
+#include "stm32f722xx.h"
 
-extern SemaphoreHandle_t flash_mutex;
+#define FLASH_FAST_READ 0x0B
 
-void flash_eraseSector(uint32_t addr) {
-    if(xSemaphoreTake(flash_mutex, portMAX_DELAY) == pdTRUE) {
-        eraseSector(addr);
-        xSemaphoreGive(flash_mutex);
+#define FLASH_CS_GPIO GPIOA
+#define FLASH_CS_PIN 4
+
+// largest transfer a dma stream can count
+#define FLASH_DMA_MAX 0xFFFF
+
+// all of the interrupt flags of DMA2 streams 0 and 3 in LISR
+#define FLASH_DMA_RX_FLAGS (0x3D << 0)
+#define FLASH_DMA_TX_FLAGS (0x3D << 22)
+
+#define FLASH_NO_SECTOR 0xFFFFFFFF
+
+/*
+    the flash is driven by the flash task alone. other tasks queue requests to
+    it and either wait to be told the request is done or carry on and are
+    called back. reads have a queue of their own which is always served first,
+    so a sequence being loaded doesn't wait behind a save's page programs and
+    erases. the busy flag of a program or erase is polled once a tick with the
+    task asleep in between, and a sector erase is suspended to serve any reads
+    that arrive while it runs
+
+    before the scheduler is started requests are carried out in place by the
+    calling code, store_load() reads the flash this way at start up
+*/
+#define FLASH_WRITE_ENABLE 0x06
+#define FLASH_READ_STATUS_1 0x05
+#define FLASH_READ_STATUS_2 0x35
+#define FLASH_PAGE_PROGRAM 0x02
+#define FLASH_SECTOR_ERASE 0x20
+#define FLASH_CHIP_ERASE 0xC7
+#define FLASH_SUSPEND 0x75
+#define FLASH_RESUME 0x7A
+
+// status register 1 and 2
+#define FLASH_STATUS_BUSY 0x01
+#define FLASH_STATUS_SUS 0x80
+
+#define FLASH_SECTOR_SIZE 0x1000
+#define FLASH_PAGE_SIZE 0x100
+
+// tasks that can wait on a request at once, any more wait for a turn
+#define FLASH_WAITERS 4
+
+extern TaskHandle_t flashTask;
+
+static QueueHandle_t read_queue;
+static QueueHandle_t write_queue;
+
+// binary semaphores free for a waiting task to be given through
+static QueueHandle_t waiters;
+
+// clocked in while a page is programmed
+static uint8_t scratch[FLASH_PAGE_SIZE];
+
+static void fast_read(uint32_t addr, uint8_t* rx, uint32_t len);
+
+static void command(uint8_t cmd) {
+    uint8_t rx;
+
+    CS_low(FLASH_CS_GPIO, FLASH_CS_PIN);
+    SPI_tx_rx(SPI1, &cmd, &rx, 1);
+    CS_high(FLASH_CS_GPIO, FLASH_CS_PIN);
+}
+
+static void address_command(uint8_t cmd, uint32_t addr) {
+    uint8_t tx[4] = {
+        cmd,
+        (addr >> 16) & 0xFF,
+        (addr >> 8) & 0xFF,
+        addr & 0xFF,
+    };
+    uint8_t rx[4];
+
+    SPI_tx_rx(SPI1, tx, rx, sizeof(tx));
+}
+
+static uint8_t read_status(uint8_t cmd) {
+    uint8_t tx[2] = {cmd, 0x00};
+    uint8_t rx[2];
+
+    CS_low(FLASH_CS_GPIO, FLASH_CS_PIN);
+    SPI_tx_rx(SPI1, tx, rx, sizeof(tx));
+    CS_high(FLASH_CS_GPIO, FLASH_CS_PIN);
+
+    return rx[1];
+}
+
+static uint8_t scheduler_running() {
+    return xTaskGetSchedulerState() == taskSCHEDULER_RUNNING;
+}
+
+static void complete(flash_request_t* r) {
+    if(r->callback) {
+        r->callback(r);
+    }
+
+    if(r->done) {
+        xSemaphoreGive(r->done);
     }
 }
 
-void flash_eraseChip() {
-    if(xSemaphoreTake(flash_mutex, portMAX_DELAY) == pdTRUE) {
-        eraseChip();
-        xSemaphoreGive(flash_mutex);
+static void run_read(flash_request_t* r) {
+    if(r->op == FLASH_OP_FAST_READ) {
+        fast_read(r->addr, r->rx, r->len);
+    } else {
+        SPIRead(r->addr, r->tx, r->rx, r->len);
+    }
+
+    complete(r);
+}
+
+/*
+    serve the reads queued while an erase is suspended. a read of the sector
+    being erased would return nothing useful, it is held back and returned to
+    be run once the erase has finished
+
+    @param sector   address of the sector being erased
+
+    @return a read held back, or NULL
+*/
+static flash_request_t* serve_suspended_reads(uint32_t sector) {
+    flash_request_t* r;
+
+    while(xQueueReceive(read_queue, &r, 0) == pdTRUE) {
+        uint32_t end = r->addr + r->len;
+
+        if(r->addr < sector + FLASH_SECTOR_SIZE && end > sector) {
+            return r;
+        }
+
+        run_read(r);
+    }
+
+    return NULL;
+}
+
+/*
+    wait for a page program to finish. a program takes well under a tick, so
+    the status register is polled until it's done rather than once a tick
+*/
+static void wait_program() {
+    while(read_status(FLASH_READ_STATUS_1) & FLASH_STATUS_BUSY);
+}
+
+/*
+    wait for an erase to finish. once the scheduler is running the status
+    register is polled once a tick and the task sleeps in between. a sector
+    erase is suspended while any queued reads are served, it is only
+    suspended once a tick so it always makes progress
+
+    @param sector   address of the sector being erased, or FLASH_NO_SECTOR to
+                    never suspend
+
+    @return a read held back until the erase finished, or NULL
+*/
+static flash_request_t* wait_ready(uint32_t sector) {
+    flash_request_t* held = NULL;
+
+    while(read_status(FLASH_READ_STATUS_1) & FLASH_STATUS_BUSY) {
+        if(!scheduler_running()) {
+            continue;
+        }
+
+        if(sector != FLASH_NO_SECTOR && !held && uxQueueMessagesWaiting(read_queue)) {
+            command(FLASH_SUSPEND);
+
+            // the erase stops within 20us
+            while(read_status(FLASH_READ_STATUS_1) & FLASH_STATUS_BUSY);
+
+            // it may have finished before the suspend was taken
+            if(read_status(FLASH_READ_STATUS_2) & FLASH_STATUS_SUS) {
+                held = serve_suspended_reads(sector);
+                command(FLASH_RESUME);
+            }
+        }
+
+        vTaskDelay(1);
+    }
+
+    return held;
+}
+
+static void run_write(flash_request_t* r) {
+    flash_request_t* held = NULL;
+
+    command(FLASH_WRITE_ENABLE);
+
+    switch(r->op) {
+        case FLASH_OP_PROGRAM:
+            CS_low(FLASH_CS_GPIO, FLASH_CS_PIN);
+            address_command(FLASH_PAGE_PROGRAM, r->addr);
+            SPI_tx_rx(SPI1, r->tx, scratch, r->len);
+            CS_high(FLASH_CS_GPIO, FLASH_CS_PIN);
+
+            wait_program();
+            break;
+
+        case FLASH_OP_ERASE_SECTOR:
+            CS_low(FLASH_CS_GPIO, FLASH_CS_PIN);
+            address_command(FLASH_SECTOR_ERASE, r->addr);
+            CS_high(FLASH_CS_GPIO, FLASH_CS_PIN);
+
+            held = wait_ready(r->addr & ~(FLASH_SECTOR_SIZE - 1));
+            break;
+
+        case FLASH_OP_ERASE_CHIP:
+            command(FLASH_CHIP_ERASE);
+
+            wait_ready(FLASH_NO_SECTOR);
+            break;
+
+        default:
+            break;
+    }
+
+    complete(r);
+
+    if(held) {
+        run_read(held);
+    }
+}
+
+static void run(flash_request_t* r) {
+    if(r->op == FLASH_OP_READ || r->op == FLASH_OP_FAST_READ) {
+        run_read(r);
+    } else {
+        run_write(r);
     }
 }
 
-void flash_programPage(uint32_t addr, uint8_t* tx, uint8_t* rx, uint16_t len) {
-    if(xSemaphoreTake(flash_mutex, portMAX_DELAY) == pdTRUE) {
-        programPage(addr, tx, rx, len);
-        xSemaphoreGive(flash_mutex);
+void flash_init() {
+    read_queue = xQueueCreate(CONFIG_FLASH_QUEUE_LENGTH, sizeof(flash_request_t*));
+    write_queue = xQueueCreate(CONFIG_FLASH_QUEUE_LENGTH, sizeof(flash_request_t*));
+    waiters = xQueueCreate(FLASH_WAITERS, sizeof(SemaphoreHandle_t));
+
+    for(uint8_t i = 0; i < FLASH_WAITERS; i++) {
+        SemaphoreHandle_t done = xSemaphoreCreateBinary();
+        xQueueSend(waiters, &done, 0);
+    }
+}
+
+/*
+    queue a request for the flash task and return straight away. the request
+    is complete once its callback is called or its done semaphore given.
+    requests of the same kind, reads or writes, are carried out in the order
+    they are queued
+
+    @param r    the request, left in place until it is complete
+*/
+void flash_submit(flash_request_t* r) {
+    if(!scheduler_running()) {
+        run(r);
+        return;
+    }
+
+    if(r->op == FLASH_OP_READ || r->op == FLASH_OP_FAST_READ) {
+        xQueueSend(read_queue, &r, portMAX_DELAY);
+    } else {
+        xQueueSend(write_queue, &r, portMAX_DELAY);
     }
+
+    xTaskNotifyGive(flashTask);
+}
+
+/*
+    queue a request and sleep until it is complete
+
+    @param r    the request, its done semaphore is filled in here
+*/
+void flash_run(flash_request_t* r) {
+    if(!scheduler_running()) {
+        r->done = NULL;
+        run(r);
+        return;
+    }
+
+    SemaphoreHandle_t done;
+
+    xQueueReceive(waiters, &done, portMAX_DELAY);
+
+    r->done = done;
+    flash_submit(r);
+    xSemaphoreTake(done, portMAX_DELAY);
+
+    xQueueSend(waiters, &done, 0);
+}
+
+/*
+    carry out the queued requests until both queues are empty, run by the
+    flash task each time it is notified. a read queued at any point goes
+    ahead of the writes still waiting
+*/
+void flash_serve() {
+    flash_request_t* r;
+
+    while(1) {
+        if(xQueueReceive(read_queue, &r, 0) == pdTRUE) {
+            run_read(r);
+        } else if(xQueueReceive(write_queue, &r, 0) == pdTRUE) {
+            run_write(r);
+        } else {
+            break;
+        }
+    }
+}
+
+void flash_eraseSector(uint32_t addr) {
+    flash_request_t r = {
+        .op = FLASH_OP_ERASE_SECTOR,
+        .addr = addr,
+    };
+
+    flash_run(&r);
+}
+
+void flash_eraseChip() {
+    flash_request_t r = {
+        .op = FLASH_OP_ERASE_CHIP,
+    };
+
+    flash_run(&r);
+}
+
+/*
+    @param addr     address of the page, a program doesn't cross into the next
+    @param tx       the data
+    @param len      number of bytes, at most a page
+*/
+void flash_programPage(uint32_t addr, uint8_t* tx, uint16_t len) {
+    flash_request_t r = {
+        .op = FLASH_OP_PROGRAM,
+        .addr = addr,
+        .tx = tx,
+        .len = len,
+    };
+
+    flash_run(&r);
 }
 
 void flash_SPIRead(uint32_t addr, uint8_t* tx, uint8_t* rx, uint32_t len) {
-    if(xSemaphoreTake(flash_mutex, portMAX_DELAY) == pdTRUE) {
-        SPIRead(addr, tx, rx, len);
-        xSemaphoreGive(flash_mutex);
+    flash_request_t r = {
+        .op = FLASH_OP_READ,
+        .addr = addr,
+        .tx = tx,
+        .rx = rx,
+        .len = len,
+    };
+
+    flash_run(&r);
+}
+
+void flash_fastRead(uint32_t addr, uint8_t* rx, uint32_t len) {
+    flash_request_t r = {
+        .op = FLASH_OP_FAST_READ,
+        .addr = addr,
+        .rx = rx,
+        .len = len,
+    };
+
+    flash_run(&r);
+}
+
+/*
+    read from the flash with the fast read command, the data phase is moved by
+    dma rather than by polling the spi a byte at a time. the dma is waited on
+    by polling, a transfer of a few pages is over well within a tick. the
+    chip select and spi are the ones set up in setup()
+
+    the rx buffer's cache lines are invalidated after the transfer, so nothing
+    sharing a cache line with either end of it may be written while it runs
+
+    @param addr     flash address to start reading from
+    @param rx       buffer to read into
+    @param len      number of bytes to read
+*/
+static void fast_read(uint32_t addr, uint8_t* rx, uint32_t len) {
+    // clocked out on mosi while the data is read
+    static uint8_t dummy = 0;
+
+    uint8_t cmd[5] = {
+        FLASH_FAST_READ,
+        (addr >> 16) & 0xFF,
+        (addr >> 8) & 0xFF,
+        addr & 0xFF,
+        0x00,
+    };
+    uint8_t cmd_rx[5];
+
+    RCC->AHB1ENR |= RCC_AHB1ENR_DMA2EN;
+
+    SCB_CleanInvalidateDCache_by_Addr((uint32_t*)rx, len);
+
+    CS_low(FLASH_CS_GPIO, FLASH_CS_PIN);
+    SPI_tx_rx(SPI1, cmd, cmd_rx, sizeof(cmd));
+
+    uint8_t* dst = rx;
+    uint32_t remaining = len;
+
+    while(remaining > 0) {
+        uint16_t chunk = remaining > FLASH_DMA_MAX ? FLASH_DMA_MAX : remaining;
+
+        // SPI1_RX is DMA2 stream 0 channel 3, SPI1_TX is DMA2 stream 3 channel 3
+        DMA2_Stream0->CR = 0;
+        DMA2_Stream3->CR = 0;
+        DMA2->LIFCR = FLASH_DMA_RX_FLAGS | FLASH_DMA_TX_FLAGS;
+
+        DMA2_Stream0->PAR = (uint32_t)&SPI1->DR;
+        DMA2_Stream0->M0AR = (uint32_t)dst;
+        DMA2_Stream0->NDTR = chunk;
+        DMA2_Stream0->CR = (3 << DMA_SxCR_CHSEL_Pos) | DMA_SxCR_MINC;
+
+        DMA2_Stream3->PAR = (uint32_t)&SPI1->DR;
+        DMA2_Stream3->M0AR = (uint32_t)&dummy;
+        DMA2_Stream3->NDTR = chunk;
+        DMA2_Stream3->CR = (3 << DMA_SxCR_CHSEL_Pos) | DMA_SxCR_DIR_0;
+
+        // rx dma goes first so no byte is missed once tx starts clocking
+        SPI1->CR2 |= SPI_CR2_RXDMAEN;
+        DMA2_Stream0->CR |= DMA_SxCR_EN;
+        DMA2_Stream3->CR |= DMA_SxCR_EN;
+        SPI1->CR2 |= SPI_CR2_TXDMAEN;
+
+        while(!(DMA2->LISR & DMA_LISR_TCIF0));
+
+        SPI1->CR2 &= ~(SPI_CR2_RXDMAEN | SPI_CR2_TXDMAEN);
+
+        dst += chunk;
+        remaining -= chunk;
     }
+
+    CS_high(FLASH_CS_GPIO, FLASH_CS_PIN);
+
+    SCB_InvalidateDCache_by_Addr((uint32_t*)rx, len);
 }
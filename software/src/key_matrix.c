@@ -0,0 +1,261 @@
+#include "FreeRTOSConfig.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include "key_matrix.h"
+#include "keyboard.h"
+#include "uart.h"
+#include "util.h"
+#include "clock.h"
+#include "autoconf.h"
+#include "stm32f722xx.h"
+
+/*
+    the matrix is scanned from TIM7, one column per interrupt. the columns are
+    the outputs of two 74hc164 shift registers in series, a single 1 is
+    clocked through them so one column is driven at a time. each interrupt
+    reads the rows of the column driven by the last one and moves the 1 on,
+    so the rows get a whole timer period to settle and the isr never waits.
+    every key is sampled about once a millisecond
+
+    that is 16000 interrupts a second, so the columns are only scanned while
+    a key is down or integrating. otherwise the matrix idles with every column
+    driven and the rows read once every KEY_IDLE_US, a single register read
+    an interrupt. any row reading down starts the scan again from the first
+    column, and the scan goes back to idling after a pass with every key up
+    and settled
+
+    each key has an integrator, counting up for every sample it reads down
+    and down for every sample it reads up. the key is only taken as pressed
+    once the count reaches CONFIG_KEY_DEBOUNCE_MS, and as released once it is
+    back at 0, so a bouncing contact has to settle before anything happens.
+    only columns with a key changing or still integrating are walked
+*/
+#define KEY_COLUMNS 16
+#define KEY_ROWS 8
+
+#define KEY_TIMER TIM7
+#define KEY_TIMER_IRQ TIM7_IRQn
+#define KEY_COLUMN_US (1000 / KEY_COLUMNS)
+#define KEY_IDLE_US 1000
+
+// the shift registers' clear, clock and serial data inputs, on port d
+#define KEY_SR_GPIO GPIOD
+#define KEY_SR_CLEAR CLR
+#define KEY_SR_CLOCK (1 << 6)
+#define KEY_SR_DATA (1 << 7)
+
+// the row inputs are consecutive pins of port c
+#define KEY_ROW_GPIO GPIOC
+
+static QueueHandle_t key_queue;
+
+static uint8_t column;
+static uint8_t scanning;
+static uint8_t pressed[KEY_COLUMNS];
+static uint8_t integrating[KEY_COLUMNS];
+static uint8_t hold_sent[KEY_COLUMNS];
+static uint8_t integrator[KEY_COLUMNS][KEY_ROWS];
+static TickType_t press_time[KEY_COLUMNS][KEY_ROWS];
+
+static uint32_t events_dropped;
+
+/*
+    clock the shift registers once, the data input is shifted into the first
+    column. the reads in between stretch the data setup and the clock pulse
+    past what the 74hc164 needs at 3.3V
+*/
+static void shift_column(uint8_t data) {
+    KEY_SR_GPIO->BSRR = data ? KEY_SR_DATA : (KEY_SR_DATA << 16);
+    (void)KEY_SR_GPIO->ODR;
+    KEY_SR_GPIO->BSRR = KEY_SR_CLOCK;
+    (void)KEY_SR_GPIO->ODR;
+    KEY_SR_GPIO->BSRR = KEY_SR_CLOCK << 16;
+}
+
+/*
+    set the time to the next interrupt. called from the isr just after an
+    update, while the count is still well below either period
+
+    @param us   microseconds to the next interrupt
+*/
+static void set_period(uint16_t us) {
+    KEY_TIMER->ARR = us - 1;
+    KEY_TIMER->CNT = 0;
+}
+
+// drive every column, the rows then read down for any key down
+static void idle() {
+    for(uint8_t i = 0; i < KEY_COLUMNS; i++) {
+        shift_column(1);
+    }
+
+    scanning = 0;
+    set_period(KEY_IDLE_US);
+}
+
+// drive the first column alone, the next interrupt reads it
+static void start_scan() {
+    KEY_SR_GPIO->BSRR = KEY_SR_CLEAR << 16;
+    (void)KEY_SR_GPIO->ODR;
+    KEY_SR_GPIO->BSRR = KEY_SR_CLEAR;
+    shift_column(1);
+
+    column = 0;
+    scanning = 1;
+    set_period(KEY_COLUMN_US);
+}
+
+static void post_event(uint8_t key, uint8_t type, TickType_t time, BaseType_t* woken) {
+    key_event_t ev = {
+        .key = key,
+        .type = type,
+        .time = time,
+    };
+
+    if(xQueueSendToBackFromISR(key_queue, &ev, woken) != pdTRUE) {
+        events_dropped++;
+    }
+}
+
+/*
+    start scanning. events are queued from here on, for key_matrix_get()
+*/
+void key_matrix_init() {
+    key_queue = xQueueCreate(CONFIG_KEY_QUEUE_LENGTH, sizeof(key_event_t));
+
+    RCC->APB1ENR |= RCC_APB1ENR_TIM7EN;
+
+    // counts microseconds, the timer clock depends on the APB1 prescaler
+    KEY_TIMER->CR1 = 0;
+    KEY_TIMER->PSC = (clock_timer_hz() / 1000000) - 1;
+    KEY_TIMER->EGR = TIM_EGR_UG;
+
+    // the scan starts idle, with the shift registers cleared first
+    KEY_SR_GPIO->BSRR = KEY_SR_CLEAR << 16;
+    (void)KEY_SR_GPIO->ODR;
+    KEY_SR_GPIO->BSRR = KEY_SR_CLEAR;
+    idle();
+
+    KEY_TIMER->SR = 0;
+    KEY_TIMER->DIER |= TIM_DIER_UIE;
+
+    // the isr uses the FromISR api so it must sit below the syscall priority
+    NVIC_SetPriority(KEY_TIMER_IRQ, configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY + 1);
+    NVIC_EnableIRQ(KEY_TIMER_IRQ);
+
+    KEY_TIMER->CR1 |= TIM_CR1_CEN;
+}
+
+/*
+    wait for the next key event
+
+    @param ev       where the event is copied to
+    @param wait     ticks to wait for one
+
+    @return 1 if there was an event, 0 if the wait ran out
+*/
+uint8_t key_matrix_get(key_event_t* ev, TickType_t wait) {
+    return xQueueReceive(key_queue, ev, wait) == pdTRUE;
+}
+
+void key_matrix_print_stats() {
+    char s[11];
+    uint8_t len;
+
+    send_uart(USART3, "key events dropped ", 19);
+    len = u32_to_str(events_dropped, s);
+    send_uart(USART3, s, len);
+    send_uart(USART3, "\n\r", 2);
+}
+
+void TIM7_IRQHandler(void) {
+    BaseType_t woken = pdFALSE;
+
+    KEY_TIMER->SR = 0;
+
+    uint8_t c = column;
+    uint8_t rows = (KEY_ROW_GPIO->IDR >> ROW_INPUT_0_PIN) & 0xFF;
+
+    if(!scanning) {
+        if(rows) {
+            start_scan();
+        }
+
+        return;
+    }
+
+    // move on to the next column now, it settles until the next interrupt
+    column = (c + 1) % KEY_COLUMNS;
+    shift_column(column == 0);
+
+    uint8_t moving = (rows ^ pressed[c]) | integrating[c];
+    uint8_t held = pressed[c] & ~hold_sent[c];
+    TickType_t now = 0;
+
+    if(moving | held) {
+        now = xTaskGetTickCountFromISR();
+    }
+
+    while(moving) {
+        uint8_t row = __builtin_ctz(moving);
+        uint8_t bit = 1 << row;
+        uint8_t* n = &integrator[c][row];
+        moving &= moving - 1;
+
+        if(rows & bit) {
+            if(*n < CONFIG_KEY_DEBOUNCE_MS) {
+                (*n)++;
+            }
+
+            if(*n == CONFIG_KEY_DEBOUNCE_MS && !(pressed[c] & bit)) {
+                pressed[c] |= bit;
+                hold_sent[c] &= ~bit;
+                press_time[c][row] = now;
+                post_event((row << 4) | c, KEY_PRESS, now, &woken);
+            }
+        } else {
+            if(*n > 0) {
+                (*n)--;
+            }
+
+            if(*n == 0 && (pressed[c] & bit)) {
+                pressed[c] &= ~bit;
+                post_event((row << 4) | c, KEY_RELEASE, now, &woken);
+            }
+        }
+
+        if(*n == 0 || *n == CONFIG_KEY_DEBOUNCE_MS) {
+            integrating[c] &= ~bit;
+        } else {
+            integrating[c] |= bit;
+        }
+    }
+
+    held = pressed[c] & ~hold_sent[c];
+
+    while(held) {
+        uint8_t row = __builtin_ctz(held);
+        held &= held - 1;
+
+        if((now - press_time[c][row]) >= pdMS_TO_TICKS(CONFIG_KEY_HOLD_MS)) {
+            hold_sent[c] |= (1 << row);
+            post_event((row << 4) | c, KEY_HOLD, now, &woken);
+        }
+    }
+
+    // a pass over every column is done, idle if nothing is down or settling
+    if(column == 0) {
+        uint8_t busy = 0;
+
+        for(uint8_t i = 0; i < KEY_COLUMNS; i++) {
+            busy |= pressed[i] | integrating[i];
+        }
+
+        if(!busy) {
+            idle();
+        }
+    }
+
+    portYIELD_FROM_ISR(woken);
+}
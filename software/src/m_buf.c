@@ -1,69 +1,110 @@
 #include "midi.h"
 #include "FreeRTOS.h"
 #include "m_buf.h"
+#include "stm32f722xx.h"
 
-static void advance_head_pointer(mbuf_handle_t k) {
-    k->head++;
-    if(k->head >= k->max) {
-        k->head = k->max-1;
-        k->full = 1;
-    }
-}
-
-static void retreat_head_pointer(mbuf_handle_t k) {
-    if(--k->head < -1) {
-        k->head = -1;
+static uint16_t next_index(mbuf_handle_t k, uint16_t i) {
+    i++;
+    if(i >= k->max) {
+        i = 0;
     }
 
-    k->full = 0;
+    return i;
 }
 
-mbuf_handle_t mbuf_init(MIDIPacket_t* buffer, int16_t size) {
-    mbuf_handle_t mbuf = pvPortMalloc(sizeof(midi_buf_t));
-    if(!mbuf) return NULL;
+/*
+    set up a buffer using a statically allocated control block
 
-    mbuf->buffer = buffer;
-    mbuf->max = size;
-    mbuf_reset(mbuf);
+    @param m        control block for the buffer
+    @param buffer   storage for the packets
+    @param size     number of elements in buffer
 
-    return mbuf;
-}
+    @return a handle to the buffer
+*/
+mbuf_handle_t mbuf_init(midi_buf_t* m, MIDIPacket_t* buffer, uint16_t size) {
+    m->buffer = buffer;
+    m->max = size;
+    mbuf_reset(m);
 
-void mbuf_free(mbuf_handle_t m) {
-    vPortFree(m);
+    return m;
 }
 
+/*
+    empty the buffer. this is not safe while either side is using the buffer
+*/
 void mbuf_reset(mbuf_handle_t m) {
-    m->head = -1;
-    m->full = 0;
+    m->head = 0;
+    m->tail = 0;
+    m->overflows = 0;
 }
 
-
 int8_t mbuf_full(mbuf_handle_t k) {
-    return k->full;
+    return next_index(k, k->head) == k->tail;
 }
 
 int8_t mbuf_empty(mbuf_handle_t k) {
-    if(k->head >= 0) {
-        return 0;
-    } else {
-        return 1;
-    }
+    return k->head == k->tail;
 }
 
 int16_t mbuf_size(mbuf_handle_t k) {
-    return k->head+1;   // return number of elements in array
+    uint16_t head = k->head;
+    uint16_t tail = k->tail;
+
+    if(head >= tail) {
+        return head - tail;
+    }
+
+    return k->max - tail + head;
 }
 
-void mbuf_push(mbuf_handle_t k, MIDIPacket_t data) {
-    advance_head_pointer(k);
-    k->buffer[k->head] = data;
+/*
+    add a packet to the back of the buffer. called by the producer only
 
+    @return 0 on success, 1 if the buffer was full and the packet was dropped
+*/
+int8_t mbuf_push(mbuf_handle_t k, MIDIPacket_t data) {
+    uint16_t head = k->head;
+    uint16_t next = next_index(k, head);
+
+    if(next == k->tail) {
+        k->overflows++;
+        return 1;
+    }
+
+    k->buffer[head] = data;
+
+    // the packet must be in memory before the consumer can see the new head
+    __DMB();
+    k->head = next;
+
+    return 0;
 }
 
-void mbuf_pop(mbuf_handle_t k, MIDIPacket_t* data) {
-    if(!mbuf_empty(k)) {
-        *data = k->buffer[k->head];
-        retreat_head_pointer(k);
+/*
+    take the packet at the front of the buffer. called by the consumer only
+
+    @return 0 on success, 1 if the buffer was empty
+*/
+int8_t mbuf_pop(mbuf_handle_t k, MIDIPacket_t* data) {
+    uint16_t tail = k->tail;
+
+    if(tail == k->head) {
+        return 1;
     }
-}
\ No newline at end of file
+
+    __DMB();
+    *data = k->buffer[tail];
+
+    // finish reading the slot before handing it back to the producer
+    __DMB();
+    k->tail = next_index(k, tail);
+
+    return 0;
+}
+
+/*
+    @return the number of packets dropped because the buffer was full
+*/
+uint32_t mbuf_overflows(mbuf_handle_t k) {
+    return k->overflows;
+}
@@ -7,20 +7,22 @@
 #include "setup.h"
 #include <string.h>
 #include "sequence.h"
+#include "midi_out.h"
+#include "flash.h"
 #include "stm32f722xx.h"
 
-SemaphoreHandle_t flash_mutex, midi_uart_mutex;
 MIDISequence_t sequences[CONFIG_TOTAL_SEQUENCES];
 step_t steps[CONFIG_TOTAL_SEQUENCES * CONFIG_STEPS_PER_SEQUENCE];
 TaskHandle_t saveTask;
+TaskHandle_t flashTask;
+TaskHandle_t displayTask;
 
 void vApplicationStackOverflowHook(TaskHandle_t xTask, char *pcTaskName) {
     __disable_irq();
 }
 
 int main(void) {
-    flash_mutex = xSemaphoreCreateMutex();
-    midi_uart_mutex = xSemaphoreCreateMutex();
+    flash_init();
     
     memset(sequences, 0, sizeof(sequences));
     memset(steps, 0, sizeof(steps));
@@ -31,9 +33,19 @@ int main(void) {
     all_channels_off(UART4);
     all_channels_off(USART6);
 
+    midi_out_init();
+
     xTaskCreate(sq_play_task, "sq_play_task", 2048, NULL, 3, NULL);
     xTaskCreate(key_scan_task, "key_scan_task", 2048, NULL, 2, NULL);
+    xTaskCreate(flash_task, "flash task", 512, NULL, 2, &flashTask);
     xTaskCreate(save_task, "save task", 512, NULL, 1, &saveTask);
+    xTaskCreate(prefetch_task, "prefetch task", 512, NULL, 1, NULL);
+    xTaskCreate(display_task, "display task", 512, NULL, 1, &displayTask);
+
+    #ifdef CONFIG_MIDI_OUT_TRACE
+        xTaskCreate(trace_task, "trace task", 512, NULL, 1, NULL);
+    #endif
+
     vTaskStartScheduler();
     while(1){
 
@@ -1,12 +1,18 @@
 #include "uart.h"
 #include "menu.h"
 #include "sequence.h"
+#include "store.h"
 // #include "step_edit_buffer.h"
 #include "step_editor.h"
 #include "midi.h"
 #include "k_buf.h"
 #include "util.h"
 #include "display.h"
+#include "play_view.h"
+#include "clock.h"
+#include "tasks.h"
+#include "midi_out.h"
+#include "key_matrix.h"
 #include <string.h>
 #include "FreeRTOS.h"
 #include "semphr.h"
@@ -16,7 +22,6 @@
 
 extern kbuf_handle_t uart_intr_kbuf;
 extern MIDISequence_t sequences[CONFIG_TOTAL_SEQUENCES];
-extern SemaphoreHandle_t midi_uart_mutex;
 extern TaskHandle_t saveTask;
 
 uint32_t SQ_MSEL_MASK[2];  // 64 bit field to identify multi selected sq
@@ -41,6 +46,7 @@ static MenuEvent_t decode_key(MenuState_t current, uint16_t key) {
         case S_MAIN_MENU:
         case S_SQ_MENU:
         case S_QUEUE_TRIG_SEL:
+        case S_SQ_VIEW:
             if(key > 0x0F && key < 0x50) {
                 return E_SQ_SELECT;
             }
@@ -103,7 +109,6 @@ static MIDINote_t key_to_note(uint16_t key) {
 volatile uint8_t ACTIVE_SQ; 
 volatile uint8_t ACTIVE_ST; 
 static MenuState_t current_state = S_MAIN_MENU;
-extern float TEMPO_PERIOD_MS;
 
 static void advance_active_st() {
     ACTIVE_ST++;
@@ -134,6 +139,15 @@ static void main_menu(uint16_t key, uint16_t hold) {
     display_line("SELECT SQ", 0);
     #ifdef CONFIG_DEBUG_PRINT
         send_uart(USART3, "select sequence\n\r", 17);
+
+        midi_out_print_stats();
+        print_note_buffer_stats();
+        display_print_stats();
+        key_matrix_print_stats();
+
+        #ifdef CONFIG_PROFILE_TICK
+            print_tick_profile();
+        #endif
     #endif
 }
 
@@ -150,6 +164,8 @@ static void sq_select(uint16_t key, uint16_t hold) {
         set_bit(SQ_MSEL_MASK, sq_val, CONFIG_TOTAL_SEQUENCES);
     }
 
+    // the steps have to be in memory before they can be edited
+    store_load_sequence(sq_val);
     ACTIVE_SQ = sq_val;
 
     menu(E_AUTO, E_NO_HOLD);
@@ -159,9 +175,8 @@ static void sq_menu(uint16_t key, uint16_t hold) {
     clear_line(0);
     clear_line(1);
 
-    char s[] = "SQ XXX";
-    num_to_str(ACTIVE_SQ, &s[3], 3);
-    display_line(s, 0);
+    display_text("SQ ", 3, 0, 0);
+    display_digits(ACTIVE_SQ, 3, 0, 3);
 
     #ifdef CONFIG_DEBUG_PRINT
         send_uart(USART3, "edit sequence ", 14);
@@ -223,17 +238,13 @@ static void sq_midi(uint16_t key, uint16_t hold) {
         send_uart(USART3, "\n\r", 2);
     #endif
 
-    
-    char s[] = "MIDI XX XX";
-    
     uint8_t port_num = (uint8_t)(((channel & 0xF0) >> 4) + 1);
-    num_to_str(port_num, &s[5], 2);
-    
     uint8_t channel_num = (uint8_t)((channel & 0x0F)+1); 
-    num_to_str(channel_num, &s[8], 2);
     
     clear_line(1);
-    display_line(s, 1);
+    display_text("MIDI ", 5, 1, 0);
+    display_digits(port_num, 2, 1, 5);
+    display_digits(channel_num, 2, 1, 8);
 }
 
 static void st_landing(uint16_t key, uint16_t hold) {
@@ -271,43 +282,17 @@ static void st_select(uint16_t key, uint16_t hold) {
 
 static void st_menu(uint16_t key, uint16_t hold) {
     clear_line(1);
-    char s[] = "ST XXX";
-    num_to_str(ACTIVE_ST, &s[3], 3);
-    display_line(s, 1);
+    display_text("ST ", 3, 1, 0);
+    display_digits(ACTIVE_ST, 3, 1, 3);
     clear_line(3);
     display_step_notes(ACTIVE_SQ, ACTIVE_ST);
 
     if(!is_sq_enabled(ACTIVE_SQ)) {
         uint8_t port = (sequences[ACTIVE_SQ].channel & 0xF0) >> 4;
-        
-        USART_TypeDef* uart;
-
-        switch(port) {
-            case 0:
-                uart = USART1;
-                break;
-            case 1:
-                uart = USART2;
-                break;
-            case 2:
-                uart = UART4;
-                break;
-            case 3:
-                uart = USART6;
-                break;
-            default:
-                uart = USART1;
-                #ifdef CONFIG_DEBUG_PRINT
-                    send_uart(USART3, "incorrect port num\n\r", 20);
-                #endif
-                break;
-        }
 
-        MIDICC_t cc = {
-            .status = CONTROLLER,
+        MIDIPacket_t release = {
             .channel = sequences[ACTIVE_SQ].channel & 0x0F,
-            .control = ALL_NOTES_OFF,
-            .value = 0,
+            .status = MIDI_OUT_RELEASE,
         };
         
         MIDIPacket_t p = {
@@ -319,31 +304,31 @@ static void st_menu(uint16_t key, uint16_t hold) {
         uint16_t seq_base_index = ((uint16_t)ACTIVE_SQ * CONFIG_STEPS_PER_SEQUENCE);
         uint16_t step_index = seq_base_index + (uint16_t)ACTIVE_ST;
 
-        step_t step = get_step_from_index(step_index);
+        step_t* step = get_step_from_index(step_index);
 
-        xSemaphoreTake(midi_uart_mutex, portMAX_DELAY);
-        send_midi_control(uart, &cc);
+        midi_out_lock();
+        midi_out_queue(port, &release);
 
         for(uint8_t i = 0; i < CONFIG_MAX_POLYPHONY; i++) {
-            if(step.note_off[i] >= A0 && step.note_off[i] <= C8) {
-                p.note = step.note_off[i];
-                send_midi_note(uart, &p);
+            if(step->note_off[i] >= A0 && step->note_off[i] <= C8) {
+                p.note = step->note_off[i];
+                midi_out_queue(port, &p);
             }
         }
 
         p.status = NOTE_ON;
         for(uint8_t i = 0; i < CONFIG_MAX_POLYPHONY; i++) {
-            if(step.note_on[i].note >= A0 && step.note_on[i].note <= C8) {
-                p.note = step.note_on[i].note;
-                p.velocity = step.note_on[i].velocity;
+            if(step->note_on[i].note >= A0 && step->note_on[i].note <= C8) {
+                p.note = step->note_on[i].note;
+                p.velocity = step->note_on[i].velocity;
 
                 #ifdef CONFIG_PLAY_ST_MENU_NOTE
-                    send_midi_note(uart, &p);
+                    midi_out_queue(port, &p);
                 #endif
             }
         }
 
-        xSemaphoreGive(midi_uart_mutex);
+        midi_out_unlock();
     }
 
     #ifdef CONFIG_DEBUG_PRINT
@@ -482,11 +467,10 @@ static void st_next(uint16_t key, uint16_t hold) {
 }
 
 static void display_velocity() {
-    char s[] = "VEL XXX";
-
     uint8_t velocity = get_step_velocity(ACTIVE_SQ, ACTIVE_ST);
-    num_to_str(velocity, &s[4], 3);
-    display_line(s, 2);
+
+    display_text("VEL ", 4, 2, 0);
+    display_digits(velocity, 3, 2, 4);
 }
 
 static void st_vel_down(uint16_t key, uint16_t hold) {
@@ -549,7 +533,7 @@ static void save(uint16_t key, uint16_t hold) {
         send_uart(USART3, "saving\n\r", 8);
     #endif
 
-    xTaskNotifyGive(saveTask);
+    xTaskNotify(saveTask, SAVE_TASK_SAVE, eSetBits);
 
     menu(E_AUTO, E_NO_HOLD);
 }
@@ -624,7 +608,7 @@ static void tempo(uint16_t key, uint16_t hold) {
             break;
     }
 
-    TEMPO_PERIOD_MS = 15000/tempo;
+    clock_set_tempo(tempo);
 
     #ifdef CONFIG_DEBUG_PRINT
         send_uart(USART3, "tempo ", 6);
@@ -633,9 +617,8 @@ static void tempo(uint16_t key, uint16_t hold) {
     #endif
 
     clear_line(0);
-    char s[] = "TEMPO XXX";
-    num_to_str(tempo, &s[6], 3);
-    display_line(s, 0);
+    display_text("TEMPO ", 6, 0, 0);
+    display_digits(tempo, 3, 0, 6);
 }
 
 static void sq_prescale(uint16_t key, uint16_t hold) {
@@ -664,7 +647,10 @@ static void sq_prescale(uint16_t key, uint16_t hold) {
             break;
     }
 
+    store_load_sequence(ACTIVE_SQ);
+    store_preserve_metadata(ACTIVE_SQ);
     sequences[ACTIVE_SQ].prescale_value = prescale;
+    store_mark_metadata(ACTIVE_SQ);
 
     #ifdef CONFIG_DEBUG_PRINT
         send_uart(USART3, "prescale ", 9);
@@ -673,9 +659,89 @@ static void sq_prescale(uint16_t key, uint16_t hold) {
     #endif
 
     clear_line(1);
-    char s[] = "PSC XXX";
-    num_to_str(prescale, &s[4], 3);
-    display_line(s, 1);
+    display_text("PSC ", 4, 1, 0);
+    display_digits(prescale, 3, 1, 4);
+}
+
+/*
+    pick a bank with the encoder, pressing the bank key again switches to it.
+    the switch takes effect at the start of the next bar, once the save task
+    has saved the sequences in ram and read in the new bank
+*/
+static uint8_t bank_val;
+
+static void bank(uint16_t key, uint16_t hold) {
+    switch(key) {
+        case E_BANK:
+            bank_val = store_bank();
+            break;
+        case E_ENCODER_UP:
+            if(bank_val < CONFIG_STORE_BANKS - 1) {
+                bank_val++;
+            }
+
+            break;
+        case E_ENCODER_DOWN:
+            if(bank_val > 0) {
+                bank_val--;
+            }
+
+            break;
+        default:
+            break;
+    }
+
+    #ifdef CONFIG_DEBUG_PRINT
+        send_uart(USART3, "bank ", 5);
+        send_hex(USART3, bank_val);
+        send_uart(USART3, "\n\r", 2);
+    #endif
+
+    clear_line(0);
+    display_text("BANK ", 5, 0, 0);
+    display_digits(bank_val, 2, 0, 5);
+}
+
+static void bank_select(uint16_t key, uint16_t hold) {
+    store_select_bank(bank_val);
+    xTaskNotify(saveTask, SAVE_TASK_BANK, eSetBits);
+
+    menu(E_AUTO, E_NO_HOLD);
+}
+
+/*
+    the playback view of a sequence, see play_view.c. a sequence key shows
+    that sequence instead, and the sequence enable key starts or stops it.
+    menu_refresh() keeps the view moving between key presses
+*/
+static void sq_view(uint16_t key, uint16_t hold) {
+    if(key == E_SQ_VIEW) {
+        if(ACTIVE_SQ >= CONFIG_TOTAL_SEQUENCES) {
+            ACTIVE_SQ = 0;
+        }
+
+        clear_display();
+    } else if(key > 0x0F && key < 0x50) {
+        ACTIVE_SQ = key_to_sq_st(key);
+    } else {
+        play_view_update(ACTIVE_SQ);
+        return;
+    }
+
+    // the sequence enable key acts on the sequence shown
+    clear_field(SQ_MSEL_MASK, CONFIG_TOTAL_SEQUENCES);
+    set_bit(SQ_MSEL_MASK, ACTIVE_SQ, CONFIG_TOTAL_SEQUENCES);
+    play_view_reset();
+
+    store_load_sequence(ACTIVE_SQ);
+
+    #ifdef CONFIG_DEBUG_PRINT
+        send_uart(USART3, "view sequence ", 14);
+        send_hex(USART3, ACTIVE_SQ);
+        send_uart(USART3, "\n\r", 2);
+    #endif
+
+    play_view_update(ACTIVE_SQ);
 }
 
 static void st_copy_paste(uint16_t key, uint16_t hold) {
@@ -764,12 +830,23 @@ StateMachine_t state_machine[] = {
     { S_ST_PASTE, st_copy_paste },
     { S_SQ_COPY, sq_copy_paste },
     { S_SQ_PASTE, sq_copy_paste },
+    { S_BANK, bank },
+    { S_BANK_SELECT, bank_select },
+    { S_SQ_VIEW, sq_view },
 };
 
+/*
+    states that pass straight on to another call menu() again from inside
+    their function. the display is only updated once the outermost call
+    returns, so a key press sends one update however many lines it redrew
+*/
 void menu(uint16_t key, uint16_t hold) {
     static MenuState_t previous = S_MAIN_MENU;
+    static uint8_t depth = 0;
 
     MenuEvent_t event = decode_key(current_state, key);
+
+    depth++;
     
     for(uint8_t i = 0; i < STATE_TABLE_SIZE; i++) {
         if((state_table[i].current == current_state && state_table[i].event == event) ||
@@ -786,6 +863,23 @@ void menu(uint16_t key, uint16_t hold) {
             break;
         }
     }
+
+    depth--;
+
+    if(depth == 0) {
+        update_display();
+    }
+}
+
+/*
+    called by the key scan task when there was no key press. views that
+    follow playback redraw here, only the cells that changed
+*/
+void menu_refresh() {
+    if(current_state == S_SQ_VIEW) {
+        play_view_update(ACTIVE_SQ);
+        update_display();
+    }
 }
 
 
@@ -803,32 +897,12 @@ void USART1_IRQHandler(void) {
                 p.note = uart_intr_kbuf->buffer[1];
                 p.velocity = uart_intr_kbuf->buffer[2];
                 
-                USART_TypeDef* port = USART1;
+                uint8_t port = 0;
 
                 if(ACTIVE_SQ < CONFIG_TOTAL_SEQUENCES) {
                     p.status = uart_intr_kbuf->buffer[0] & 0xF0;
                     p.channel = sequences[ACTIVE_SQ].channel & 0x0F;
-
-                    switch(sequences[ACTIVE_SQ].channel & 0xF0) {
-                        case PORT_A:
-                            port = USART1;
-                            break;
-                        
-                        case PORT_B:
-                            port = USART2;
-                            break;
-                        
-                        case PORT_C:
-                            port = UART4;
-                            break;
-                    
-                        case PORT_D:
-                            port = USART1;
-                            break;
-
-                        default:
-                            break;
-                    }
+                    port = (sequences[ACTIVE_SQ].channel & 0xF0) >> 4;
                 } else {
                     p.status = uart_intr_kbuf->buffer[0];
                     p.channel = uart_intr_kbuf->buffer[0];
@@ -838,7 +912,12 @@ void USART1_IRQHandler(void) {
                     kbuf_reset(uart_intr_kbuf);
                 }
 
-                send_midi_note(port, &p);
+                /*
+                    this can interrupt a task that is part way through encoding
+                    a step, so the echo goes out through its own buffer with
+                    the full status
+                */
+                midi_out_thru(port, &p);
             }
         }
     }
@@ -0,0 +1,664 @@
+#include "FreeRTOSConfig.h"
+#include "FreeRTOS.h"
+#include "semphr.h"
+#include "midi.h"
+#include "midi_out.h"
+#include "clock.h"
+#include "uart.h"
+#include "util.h"
+#include "autoconf.h"
+#include <string.h>
+#include "stm32f722xx.h"
+
+/*
+    all note and controller messages for the four midi outputs are encoded
+    here. at 31250 baud every byte costs 320us on the wire, so with running
+    status a chord of note ons, or a chord of note offs sent as note ons with
+    velocity 0, costs 2 bytes per note after the first instead of 3.
+
+    the encoded bytes for a step are collected in one contiguous buffer per port
+    and sent by dma when the step is due, so no task sits waiting on the uart
+    while a step goes out.
+
+    a step buffer also has to be on the wire before the next step is due, or
+    every later step on the port starts late. each step is given a byte budget
+    from the step period. note offs and controllers are always queued so no
+    note is left hanging, note ons over the budget are dropped. as
+    load_sequences() visits sequences in index order, the lower numbered
+    sequences on a port win when it is overloaded.
+
+    every note queued on a port is tracked per channel, so stopping a sequence
+    releases exactly the notes that are sounding instead of sending all notes
+    off
+*/
+
+static midi_port_t ports[NUM_MIDI_PORTS];
+static SemaphoreHandle_t tx_mutex;
+static uint16_t step_budget;
+static uint32_t step_count;
+
+/*
+    dma stream flags for streams 4 to 7 sit in HISR at these offsets
+*/
+static uint32_t dma_flag_shift(uint8_t stream) {
+    switch(stream % 4) {
+        case 0:
+            return 0;
+        case 1:
+            return 6;
+        case 2:
+            return 16;
+        default:
+            return 22;
+    }
+}
+
+static void init_port(
+    midi_port_t* m,
+    USART_TypeDef* uart,
+    DMA_TypeDef* dma,
+    DMA_Stream_TypeDef* stream,
+    uint8_t stream_num,
+    uint8_t channel,
+    IRQn_Type irq
+) {
+    uint32_t shift = dma_flag_shift(stream_num);
+
+    m->uart = uart;
+    m->dma = stream;
+    m->dma_isr = &dma->HISR;
+    m->dma_ifcr = &dma->HIFCR;
+    m->dma_flags = 0x3D << shift;
+    m->dma_tc = 0x20 << shift;
+
+    // memory to peripheral, byte wide, memory increment, interrupt on complete
+    m->dma_cr = (channel << DMA_SxCR_CHSEL_Pos) | DMA_SxCR_MINC | DMA_SxCR_DIR_0 | DMA_SxCR_TCIE;
+
+    m->fill = 0;
+    m->active = MIDI_OUT_NO_BUFFER;
+    m->pending = MIDI_OUT_NO_BUFFER;
+    m->tx_len[0] = 0;
+    m->tx_len[1] = 0;
+    m->thru_len = 0;
+
+    m->running_status = 0;
+    m->bytes = 0;
+    m->bytes_saved = 0;
+    m->dropped = 0;
+
+    memset(m->active_notes, 0, sizeof(m->active_notes));
+
+    m->overloaded = 0;
+    m->overloads = 0;
+    m->notes_dropped = 0;
+
+    stream->CR = 0;
+    stream->PAR = (uint32_t)&uart->TDR;
+    uart->CR3 |= USART_CR3_DMAT;
+
+    // the isr uses no rtos calls but stays below the syscall priority anyway
+    NVIC_SetPriority(irq, configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY + 1);
+    NVIC_EnableIRQ(irq);
+}
+
+void midi_out_init() {
+    tx_mutex = xSemaphoreCreateMutex();
+    step_budget = midi_out_budget(clock_get_period_us());
+
+    RCC->AHB1ENR |= RCC_AHB1ENR_DMA1EN | RCC_AHB1ENR_DMA2EN;
+
+    init_port(&ports[0], USART1, DMA2, DMA2_Stream7, 7, 4, DMA2_Stream7_IRQn);
+    init_port(&ports[1], USART2, DMA1, DMA1_Stream6, 6, 4, DMA1_Stream6_IRQn);
+    init_port(&ports[2], UART4, DMA1, DMA1_Stream4, 4, 4, DMA1_Stream4_IRQn);
+    init_port(&ports[3], USART6, DMA2, DMA2_Stream6, 6, 5, DMA2_Stream6_IRQn);
+
+    #ifdef CONFIG_MIDI_RUNNING_STATUS_PORT_A
+        ports[0].flags |= MIDI_OUT_RUNNING_STATUS;
+    #endif
+
+    #ifdef CONFIG_MIDI_RUNNING_STATUS_PORT_B
+        ports[1].flags |= MIDI_OUT_RUNNING_STATUS;
+    #endif
+
+    #ifdef CONFIG_MIDI_RUNNING_STATUS_PORT_C
+        ports[2].flags |= MIDI_OUT_RUNNING_STATUS;
+    #endif
+
+    #ifdef CONFIG_MIDI_RUNNING_STATUS_PORT_D
+        ports[3].flags |= MIDI_OUT_RUNNING_STATUS;
+    #endif
+}
+
+midi_port_t* midi_out_port(uint8_t port) {
+    if(port >= NUM_MIDI_PORTS) {
+        return &ports[0];
+    }
+
+    return &ports[port];
+}
+
+/*
+    encode a note or controller packet into the bytes to be sent on a port
+
+    @param m    the port the packet is going out on
+    @param p    the packet, controller packets carry the control in note and
+                the value in velocity
+    @param buf  at least MIDI_OUT_MAX_MESSAGE bytes to write the message into
+
+    @return the number of bytes written to buf
+*/
+uint8_t midi_out_encode(midi_port_t* m, MIDIPacket_t* p, uint8_t* buf) {
+    uint8_t status = p->status & 0xF0;
+    uint8_t velocity = p->velocity & 0x7F;
+    uint8_t len = 0;
+
+    if(m->flags & MIDI_OUT_RUNNING_STATUS) {
+        if(status == NOTE_OFF) {
+            status = NOTE_ON;
+            velocity = 0;
+        }
+
+        status |= (p->channel & 0x0F);
+
+        if(status != m->running_status) {
+            buf[len++] = status;
+            m->running_status = status;
+        }
+    } else {
+        buf[len++] = status | (p->channel & 0x0F);
+    }
+
+    buf[len++] = p->note & 0x7F;
+    buf[len++] = velocity;
+
+    m->bytes += len;
+    m->bytes_saved += MIDI_OUT_MAX_MESSAGE - len;
+
+    return len;
+}
+
+/*
+    number of bytes a packet will take on a port, without encoding it
+
+    @param m    the port the packet is going out on
+    @param p    the packet
+*/
+uint8_t midi_out_cost(midi_port_t* m, MIDIPacket_t* p) {
+    if(!(m->flags & MIDI_OUT_RUNNING_STATUS)) {
+        return MIDI_OUT_MAX_MESSAGE;
+    }
+
+    uint8_t status = p->status & 0xF0;
+
+    if(status == NOTE_OFF) {
+        status = NOTE_ON;
+    }
+
+    status |= (p->channel & 0x0F);
+
+    return status == m->running_status ? MIDI_OUT_MAX_MESSAGE - 1 : MIDI_OUT_MAX_MESSAGE;
+}
+
+/*
+    number of bytes a port can send in one step period. room is kept for the
+    midi input echo
+
+    @param period_us    step period in microseconds
+*/
+uint16_t midi_out_budget(uint32_t period_us) {
+    uint32_t bytes = period_us / MIDI_OUT_BYTE_US;
+
+    if(bytes <= CONFIG_MIDI_BUDGET_RESERVE_BYTES) {
+        return 0;
+    }
+
+    bytes -= CONFIG_MIDI_BUDGET_RESERVE_BYTES;
+
+    if(bytes > CONFIG_MIDI_TX_BUFFER_LENGTH) {
+        bytes = CONFIG_MIDI_TX_BUFFER_LENGTH;
+    }
+
+    return bytes;
+}
+
+/*
+    start sending one of the port's buffers. must be called with interrupts
+    disabled
+*/
+static void start_tx(midi_port_t* m, uint8_t buffer) {
+    uint8_t* data;
+    uint16_t len;
+
+    if(buffer == MIDI_OUT_THRU) {
+        data = m->thru;
+        len = m->thru_len;
+    } else {
+        data = m->tx[buffer];
+        len = m->tx_len[buffer];
+    }
+
+    // the buffer may still be sitting in the data cache
+    SCB_CleanDCache_by_Addr((uint32_t*)data, len);
+
+    *m->dma_ifcr = m->dma_flags;
+    m->dma->M0AR = (uint32_t)data;
+    m->dma->NDTR = len;
+    m->dma->CR = m->dma_cr | DMA_SxCR_EN;
+
+    m->active = buffer;
+    m->tx_start = clock_now();
+}
+
+/*
+    start the next waiting buffer if the dma is idle. input echoes go first.
+    must be called with interrupts disabled
+*/
+static void kick(midi_port_t* m) {
+    if(m->active != MIDI_OUT_NO_BUFFER) {
+        return;
+    }
+
+    if(m->thru_len > 0) {
+        start_tx(m, MIDI_OUT_THRU);
+    } else if(m->pending != MIDI_OUT_NO_BUFFER) {
+        uint8_t buffer = m->pending;
+        m->pending = MIDI_OUT_NO_BUFFER;
+        start_tx(m, buffer);
+    }
+}
+
+/*
+    the midi input interrupt runs above the rtos syscall priority, so the port
+    state is guarded by masking interrupts outright rather than with
+    taskENTER_CRITICAL
+*/
+static uint32_t port_lock() {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    return primask;
+}
+
+static void port_unlock(uint32_t primask) {
+    __set_PRIMASK(primask);
+}
+
+static void dma_complete(midi_port_t* m) {
+    if(!(*m->dma_isr & m->dma_tc)) {
+        return;
+    }
+
+    *m->dma_ifcr = m->dma_flags;
+
+    uint32_t primask = port_lock();
+
+    if(m->active == MIDI_OUT_THRU) {
+        m->thru_len = 0;
+    } else if(m->active != MIDI_OUT_NO_BUFFER) {
+        m->tx_len[m->active] = 0;
+    }
+
+    m->active = MIDI_OUT_NO_BUFFER;
+    m->tx_end = clock_now();
+
+    kick(m);
+
+    port_unlock(primask);
+}
+
+void midi_out_lock() {
+    xSemaphoreTake(tx_mutex, portMAX_DELAY);
+}
+
+void midi_out_unlock() {
+    xSemaphoreGive(tx_mutex);
+}
+
+static void track_note(midi_port_t* m, MIDIPacket_t* p) {
+    uint8_t status = p->status & 0xF0;
+    uint8_t note = p->note & 0x7F;
+    uint32_t* channel_notes = m->active_notes[p->channel & 0x0F];
+
+    if(status == NOTE_ON && (p->velocity & 0x7F) > 0) {
+        channel_notes[note / 32] |= (1UL << (note % 32));
+    } else if(status == NOTE_ON || status == NOTE_OFF) {
+        channel_notes[note / 32] &= ~(1UL << (note % 32));
+    }
+}
+
+static void queue_packet(midi_port_t* m, MIDIPacket_t* p) {
+    uint8_t fill = m->fill;
+
+    /*
+        both step buffers are still in use when the previous step hasn't
+        finished going out yet
+    */
+    if(m->active == fill || m->pending == fill) {
+        m->dropped++;
+        return;
+    }
+
+    if(m->tx_len[fill] + MIDI_OUT_MAX_MESSAGE > CONFIG_MIDI_TX_BUFFER_LENGTH) {
+        m->dropped++;
+        return;
+    }
+
+    /*
+        note offs and controllers are over budget only when the step is so
+        full of them that the buffer itself runs out
+    */
+    if((p->status & 0xF0) == NOTE_ON && m->tx_len[fill] + midi_out_cost(m, p) > step_budget) {
+        if(!m->overloaded) {
+            m->overloaded = 1;
+            m->overloads++;
+        }
+
+        m->notes_dropped++;
+        return;
+    }
+
+    m->tx_len[fill] += midi_out_encode(m, p, &m->tx[fill][m->tx_len[fill]]);
+
+    track_note(m, p);
+}
+
+/*
+    queue a note off for every note sounding on a channel. the set bits are
+    walked with count trailing zeros so a channel with nothing sounding costs
+    nothing on the wire
+*/
+static void release_channel(midi_port_t* m, uint8_t channel) {
+    uint32_t* channel_notes = m->active_notes[channel & 0x0F];
+
+    MIDIPacket_t p = {
+        .channel = channel & 0x0F,
+        .status = NOTE_OFF,
+        .velocity = 0,
+    };
+
+    for(uint8_t w = 0; w < 4; w++) {
+        uint32_t sounding = channel_notes[w];
+
+        while(sounding) {
+            uint8_t bit = __builtin_ctz(sounding);
+            sounding &= sounding - 1;
+
+            p.note = (w * 32) + bit;
+            queue_packet(m, &p);
+        }
+    }
+}
+
+/*
+    encode a packet into the step buffer of a port. the caller must hold the
+    midi_out lock. the packet goes out when the next step is committed
+
+    @param port     index of the port (0-3)
+    @param p        the packet to send, or a MIDI_OUT_RELEASE packet to release
+                    the notes sounding on its channel
+*/
+void midi_out_queue(uint8_t port, MIDIPacket_t* p) {
+    midi_port_t* m = midi_out_port(port);
+
+    if(p->status == MIDI_OUT_RELEASE) {
+        release_channel(m, p->channel);
+    } else {
+        queue_packet(m, p);
+    }
+}
+
+void midi_out_note(uint8_t port, MIDIPacket_t* p) {
+    midi_out_lock();
+    midi_out_queue(port, p);
+    midi_out_unlock();
+}
+
+void midi_out_control(uint8_t port, MIDICC_t* cc) {
+    // a control change carries the controller number in the note byte
+    MIDIPacket_t p = {
+        .channel = cc->channel,
+        .status = CONTROLLER,
+        .note = (MIDINote_t)cc->control,
+        .velocity = cc->value,
+    };
+
+    midi_out_note(port, &p);
+}
+
+/*
+    release the notes sounding on a channel of a port at the next step
+
+    @param port     index of the port (0-3)
+    @param channel  midi channel (0-15)
+*/
+void midi_out_release(uint8_t port, uint8_t channel) {
+    midi_out_lock();
+    release_channel(midi_out_port(port), channel);
+    midi_out_unlock();
+}
+
+#ifdef CONFIG_MIDI_OUT_TRACE
+/*
+    every step buffer committed is copied into this ring with its step number
+    and clock count, and printed later by trace_task(), see tasks.c, so the
+    commit never waits on the debug uart. midi_out_commit() is the only
+    producer and trace_task() the only consumer, so as with m_buf no lock is
+    shared between them. head and tail count bytes from start up and are
+    wrapped into the ring as they are used. an entry that doesn't fit is
+    dropped whole and counted
+*/
+#define TRACE_MASK (CONFIG_MIDI_OUT_TRACE_BYTES - 1)
+
+_Static_assert((CONFIG_MIDI_OUT_TRACE_BYTES & TRACE_MASK) == 0, "CONFIG_MIDI_OUT_TRACE_BYTES must be a power of two");
+
+static uint8_t trace_ring[CONFIG_MIDI_OUT_TRACE_BYTES];
+static volatile uint32_t trace_head;
+static volatile uint32_t trace_tail;
+static uint32_t trace_dropped;
+
+static void trace_put(uint32_t pos, const uint8_t* data, uint16_t len) {
+    for(uint16_t i = 0; i < len; i++) {
+        trace_ring[(pos + i) & TRACE_MASK] = data[i];
+    }
+}
+
+static void trace_get(uint32_t pos, uint8_t* data, uint16_t len) {
+    for(uint16_t i = 0; i < len; i++) {
+        data[i] = trace_ring[(pos + i) & TRACE_MASK];
+    }
+}
+
+static void trace_write(uint8_t port, uint32_t step, uint32_t now, uint8_t* data, uint16_t len) {
+    midi_out_trace_t t = {
+        .step = step,
+        .now = now,
+        .port = port,
+        .len = len,
+    };
+    uint32_t head = trace_head;
+
+    if(sizeof(t) + len > CONFIG_MIDI_OUT_TRACE_BYTES - (head - trace_tail)) {
+        trace_dropped++;
+        return;
+    }
+
+    trace_put(head, (uint8_t*)&t, sizeof(t));
+    trace_put(head + sizeof(t), data, len);
+
+    // the entry must be in memory before the consumer can see the new head
+    __DMB();
+    trace_head = head + sizeof(t) + len;
+}
+
+/*
+    take the oldest entry from the trace. called by the consumer only
+
+    @param t        filled in with the step number, clock count, port and
+                    length of the entry
+    @param data     at least CONFIG_MIDI_TX_BUFFER_LENGTH bytes for the midi
+                    bytes of the entry
+
+    @return 1 if an entry was taken, 0 if the trace was empty
+*/
+uint8_t midi_out_trace_read(midi_out_trace_t* t, uint8_t* data) {
+    uint32_t tail = trace_tail;
+
+    if(tail == trace_head) {
+        return 0;
+    }
+
+    __DMB();
+    trace_get(tail, (uint8_t*)t, sizeof(*t));
+    trace_get(tail + sizeof(*t), data, t->len);
+
+    // finish reading the entry before handing its bytes back to the producer
+    __DMB();
+    trace_tail = tail + sizeof(*t) + t->len;
+
+    return 1;
+}
+
+/*
+    @return the number of entries dropped because the trace was full
+*/
+uint32_t midi_out_trace_dropped() {
+    return trace_dropped;
+}
+#endif
+
+/*
+    hand the step buffer of every port to its dma. this is all that happens on
+    the clock edge. if a port is still sending the previous step the buffer is
+    started from the dma complete interrupt instead
+*/
+void midi_out_commit() {
+    midi_out_lock();
+
+    // a tempo change takes effect from the next step
+    step_budget = midi_out_budget(clock_get_period_us());
+
+    for(uint8_t i = 0; i < NUM_MIDI_PORTS; i++) {
+        midi_port_t* m = &ports[i];
+        uint8_t fill = m->fill;
+
+        if(m->tx_len[fill] == 0) {
+            m->overloaded = 0;
+            continue;
+        }
+
+        uint32_t primask = port_lock();
+        uint8_t committed = 0;
+        uint16_t len = m->tx_len[fill];
+
+        if(m->active != fill && m->pending != fill) {
+            m->pending = fill;
+            m->fill = fill ^ 1;
+            kick(m);
+
+            /*
+                each step buffer starts with a full status byte so that an
+                input echo can be sent between two steps without upsetting the
+                running status
+            */
+            m->running_status = 0;
+            m->overloaded = 0;
+            committed = 1;
+        }
+
+        port_unlock(primask);
+
+        #ifdef CONFIG_MIDI_OUT_TRACE
+            if(committed) {
+                trace_write(i, step_count, clock_now(), m->tx[fill], len);
+            }
+        #else
+            (void)committed;
+            (void)len;
+        #endif
+    }
+
+    step_count++;
+
+    midi_out_unlock();
+}
+
+/*
+    echo a packet from the midi input straight out of a port. this is called
+    from the usart interrupt and is sent ahead of any waiting step buffer. the
+    full status is always sent
+
+    @param port     index of the port (0-3)
+    @param p        the packet to send
+*/
+void midi_out_thru(uint8_t port, MIDIPacket_t* p) {
+    midi_port_t* m = midi_out_port(port);
+
+    uint32_t primask = port_lock();
+
+    if(m->active == MIDI_OUT_THRU || m->thru_len + MIDI_OUT_MAX_MESSAGE > MIDI_OUT_THRU_LENGTH) {
+        m->dropped++;
+    } else {
+        uint8_t len = m->thru_len;
+        m->thru[len++] = (p->status & 0xF0) | (p->channel & 0x0F);
+        m->thru[len++] = p->note & 0x7F;
+        m->thru[len++] = p->velocity & 0x7F;
+        m->thru_len = len;
+
+        kick(m);
+    }
+
+    port_unlock(primask);
+}
+
+void midi_out_set_flags(uint8_t port, uint8_t flags) {
+    midi_port_t* m = midi_out_port(port);
+
+    midi_out_lock();
+    m->flags = flags;
+    m->running_status = 0;
+    midi_out_unlock();
+}
+
+void midi_out_print_stats() {
+    char s[11];
+    uint8_t len;
+
+    for(uint8_t i = 0; i < NUM_MIDI_PORTS; i++) {
+        send_uart(USART3, "port ", 5);
+        send_hex(USART3, i);
+        send_uart(USART3, " bytes ", 7);
+        len = u32_to_str(ports[i].bytes, s);
+        send_uart(USART3, s, len);
+        send_uart(USART3, " saved ", 7);
+        len = u32_to_str(ports[i].bytes_saved, s);
+        send_uart(USART3, s, len);
+        send_uart(USART3, " dropped ", 9);
+        len = u32_to_str(ports[i].dropped, s);
+        send_uart(USART3, s, len);
+        send_uart(USART3, " overloads ", 11);
+        len = u32_to_str(ports[i].overloads, s);
+        send_uart(USART3, s, len);
+        send_uart(USART3, " notes dropped ", 15);
+        len = u32_to_str(ports[i].notes_dropped, s);
+        send_uart(USART3, s, len);
+        send_uart(USART3, " last tx us ", 12);
+        len = u32_to_str(ports[i].tx_end - ports[i].tx_start, s);
+        send_uart(USART3, s, len);
+        send_uart(USART3, "\n\r", 2);
+    }
+}
+
+void DMA2_Stream7_IRQHandler(void) {
+    dma_complete(&ports[0]);
+}
+
+void DMA1_Stream6_IRQHandler(void) {
+    dma_complete(&ports[1]);
+}
+
+void DMA1_Stream4_IRQHandler(void) {
+    dma_complete(&ports[2]);
+}
+
+void DMA2_Stream6_IRQHandler(void) {
+    dma_complete(&ports[3]);
+}
@@ -0,0 +1,138 @@
+#include "play_view.h"
+#include "sequence.h"
+#include "display.h"
+#include "ssd1306.h"
+#include "util.h"
+#include <string.h>
+
+extern MIDISequence_t sequences[CONFIG_TOTAL_SEQUENCES];
+
+extern step_t steps[CONFIG_TOTAL_SEQUENCES * CONFIG_STEPS_PER_SEQUENCE];
+
+/*
+    the steps of one sequence in rows of 16 cells, one page high, across the
+    top half of the display, and every sequence in rows of 32 narrower cells
+    across the bottom two pages. a cell is only drawn when what it shows has
+    changed, so a refresh with the playhead moved on by one step redraws two
+    cells of the grid
+*/
+#define STEP_CELL_WIDTH 8
+#define STEP_CELLS_PER_ROW (WIDTH / STEP_CELL_WIDTH)
+#define SLOT_CELL_WIDTH 4
+#define SLOT_CELLS_PER_ROW (WIDTH / SLOT_CELL_WIDTH)
+#define SLOT_FIRST_PAGE (8 - (CONFIG_TOTAL_SEQUENCES / SLOT_CELLS_PER_ROW))
+
+#define CELL_DISABLED 0
+#define CELL_EMPTY 1
+#define CELL_NOTES 2
+#define CELL_MUTED 3
+#define CELL_STOPPED 0
+#define CELL_PLAYING 1
+
+// the cell is inverted, set on the playhead and on the sequence shown
+#define CELL_MARKED 0x80
+#define CELL_NONE 0xFF
+
+static const uint8_t step_cells[][STEP_CELL_WIDTH] = {
+    [CELL_DISABLED] = {0x00, 0x00, 0x00, 0x18, 0x18, 0x00, 0x00, 0x00},
+    [CELL_EMPTY] = {0x00, 0x7E, 0x42, 0x42, 0x42, 0x42, 0x7E, 0x00},
+    [CELL_NOTES] = {0x00, 0x7E, 0x7E, 0x7E, 0x7E, 0x7E, 0x7E, 0x00},
+    [CELL_MUTED] = {0x00, 0x7E, 0x46, 0x4A, 0x52, 0x62, 0x7E, 0x00},
+};
+
+static const uint8_t slot_cells[][SLOT_CELL_WIDTH] = {
+    [CELL_STOPPED] = {0x00, 0x18, 0x18, 0x00},
+    [CELL_PLAYING] = {0x3C, 0x3C, 0x3C, 0x00},
+};
+
+// what each cell showed when last drawn
+static uint8_t drawn_steps[CONFIG_STEPS_PER_SEQUENCE];
+static uint8_t drawn_slots[CONFIG_TOTAL_SEQUENCES];
+
+static void draw_cell(uint8_t page, uint8_t col, const uint8_t* glyph, uint8_t width, uint8_t marked) {
+    uint8_t cell[STEP_CELL_WIDTH];
+
+    for(uint8_t i = 0; i < width; i++) {
+        cell[i] = marked ? ~glyph[i] : glyph[i];
+    }
+
+    display_columns(page, col, cell, width);
+}
+
+/*
+    forget what the cells show, the next update draws all of them. called
+    after the display was cleared, or to show another sequence
+*/
+void play_view_reset() {
+    memset(drawn_steps, CELL_NONE, sizeof(drawn_steps));
+    memset(drawn_slots, CELL_NONE, sizeof(drawn_slots));
+}
+
+/*
+    redraw the cells that changed since the last update. this only reads the
+    snapshot published by the play task, it never holds up playback
+
+    @param sq_index     the sequence whose steps are shown
+*/
+void play_view_update(uint8_t sq_index) {
+    play_snapshot_t snap;
+    MIDISequence_t* sq = &sequences[sq_index];
+    uint16_t base = sq_index * CONFIG_STEPS_PER_SEQUENCE;
+
+    read_play_snapshot(&snap);
+
+    uint8_t playing = check_bit(snap.playing, sq_index, CONFIG_TOTAL_SEQUENCES);
+
+    for(uint8_t st = 0; st < CONFIG_STEPS_PER_SEQUENCE; st++) {
+        uint8_t cell;
+
+        // a set bit in enabled_steps marks the step disabled
+        if(check_bit(sq->enabled_steps, st, CONFIG_STEPS_PER_SEQUENCE)) {
+            cell = CELL_DISABLED;
+        } else if(check_bit(sq->muted_steps, st, CONFIG_STEPS_PER_SEQUENCE)) {
+            cell = CELL_MUTED;
+        } else if(steps[base + st].note_on[0].note != 0) {
+            cell = CELL_NOTES;
+        } else {
+            cell = CELL_EMPTY;
+        }
+
+        if(playing && snap.playhead[sq_index] == st) {
+            cell |= CELL_MARKED;
+        }
+
+        if(cell == drawn_steps[st]) {
+            continue;
+        }
+
+        drawn_steps[st] = cell;
+        draw_cell(
+            st / STEP_CELLS_PER_ROW,
+            (st % STEP_CELLS_PER_ROW) * STEP_CELL_WIDTH,
+            step_cells[cell & ~CELL_MARKED],
+            STEP_CELL_WIDTH,
+            cell & CELL_MARKED
+        );
+    }
+
+    for(uint8_t i = 0; i < CONFIG_TOTAL_SEQUENCES; i++) {
+        uint8_t cell = check_bit(snap.playing, i, CONFIG_TOTAL_SEQUENCES) ? CELL_PLAYING : CELL_STOPPED;
+
+        if(i == sq_index) {
+            cell |= CELL_MARKED;
+        }
+
+        if(cell == drawn_slots[i]) {
+            continue;
+        }
+
+        drawn_slots[i] = cell;
+        draw_cell(
+            SLOT_FIRST_PAGE + (i / SLOT_CELLS_PER_ROW),
+            (i % SLOT_CELLS_PER_ROW) * SLOT_CELL_WIDTH,
+            slot_cells[cell & ~CELL_MARKED],
+            SLOT_CELL_WIDTH,
+            cell & CELL_MARKED
+        );
+    }
+}
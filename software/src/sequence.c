@@ -1,5 +1,6 @@
 #include "FreeRTOS.h"
 #include "semphr.h"
+#include "task.h"
 #include "midi.h"
 #include "sequence.h"
 #include "uart.h"
@@ -9,6 +10,8 @@
 #include "util.h"
 #include <string.h>
 #include "tasks.h"
+#include "midi_out.h"
+#include "store.h"
 #include "autoconf.h"
 #include "stm32f722xx.h"
 
@@ -16,10 +19,35 @@ extern MIDISequence_t sequences[CONFIG_TOTAL_SEQUENCES];
 
 extern step_t steps[CONFIG_TOTAL_SEQUENCES * CONFIG_STEPS_PER_SEQUENCE];
 
+/*
+    the number of valid note offs and note ons held at the front of each step in
+    steps[]. these are written by compile_step() whenever a step is edited so
+    playback never has to scan or range check a step
+*/
+static step_events_t step_events[CONFIG_TOTAL_SEQUENCES * CONFIG_STEPS_PER_SEQUENCE];
+
+/*
+    where the play task reads the steps of each sequence and their events.
+    these are the sequence's own part of steps[] and step_events[], except
+    after a bank swap, when the sequences that were playing are read from the
+    copies the store decoded ahead of it until it copies them into steps[]
+*/
+static const step_t* play_steps[CONFIG_TOTAL_SEQUENCES];
+static const step_events_t* play_events[CONFIG_TOTAL_SEQUENCES];
+
 static uint32_t enabled_sequences[2];
 static uint32_t break_sequences[2];
 static uint32_t queued_sequences[2];
 
+/*
+    the playback state load_sequences() publishes for the ui. the play task
+    is the only writer, it makes snapshot_seq odd before writing and even
+    again after. a reader that sees the same even value either side of its
+    copy has a consistent snapshot, and neither side ever waits on the other
+*/
+static volatile uint32_t snapshot_seq;
+static play_snapshot_t snapshot;
+
 /*
     read the midi channel of the sequence from flash memory. The sequence
     metadata is stored in the first sector of the block. The midi channel
@@ -32,75 +60,190 @@ static uint32_t queued_sequences[2];
 uint8_t init_sequences() {
     memset(enabled_sequences, 0, sizeof(uint32_t) * 2);
 
-    uint32_t addr = CONFIG_METADATA_BASE_ADDR;
-    // TODO handle this metadata shite
-    // it would be cool to read the data directly into the sequence array instead
-    // of using an inbetween buffer
-    uint8_t metadata[CONFIG_METADATA_BYTES_PER_SEQ] = {0};
-    
-    for(int i = 0; i < CONFIG_TOTAL_SEQUENCES; i++) {
-
-        flash_SPIRead(addr, metadata, metadata, CONFIG_METADATA_BYTES_PER_SEQ);
-        sequences[i].channel = metadata[0];
-        sequences[i].prescale_value = metadata[1];
-        memcpy(sequences[i].enabled_steps, &metadata[2], sizeof(sequences[i].enabled_steps));
+    for(uint8_t i = 0; i < CONFIG_TOTAL_SEQUENCES; i++) {
+        uint16_t base = (uint16_t)i * CONFIG_STEPS_PER_SEQUENCE;
 
-        addr+=CONFIG_METADATA_BYTES_PER_SEQ;
+        play_steps[i] = &steps[base];
+        play_events[i] = &step_events[base];
     }
 
-    flash_SPIRead(CONFIG_STEPS_BASE_ADDR, (uint8_t*)steps, (uint8_t*)steps, sizeof(steps));
+    // the steps are loaded later, by store_load_sequence()
+    store_load();
 
     return 0;
 }
 
+static uint8_t is_valid_note(uint8_t n) {
+    return (n <= C8 && n >= A0);
+}
+
+/*
+    drop any note outside A0 - C8 and pack the remaining notes to the front of
+    note_off and note_on
+
+    @return the counts of the notes left
+*/
+static step_events_t validate_step(step_t* st) {
+    step_events_t ev = {0};
+
+    for(uint8_t i = 0; i < CONFIG_MAX_POLYPHONY; i++) {
+        uint8_t n = st->note_off[i];
+
+        if(is_valid_note(n)) {
+            st->note_off[ev.note_off++] = n;
+        }
+    }
+
+    for(uint8_t i = 0; i < CONFIG_MAX_POLYPHONY; i++) {
+        note_t n = st->note_on[i];
+
+        if(is_valid_note(n.note)) {
+            n.velocity &= 0x7F;
+            st->note_on[ev.note_on++] = n;
+        }
+    }
+
+    for(uint8_t i = ev.note_off; i < CONFIG_MAX_POLYPHONY; i++) {
+        st->note_off[i] = 0;
+    }
+
+    for(uint8_t i = ev.note_on; i < CONFIG_MAX_POLYPHONY; i++) {
+        st->note_on[i].note = 0;
+        st->note_on[i].velocity = 0;
+    }
+
+    return ev;
+}
+
+/*
+    validate a step after it has been edited. the counts of its notes are
+    recorded in step_events. this moves all of the checking out of the
+    playback path and into the editors
+
+    @param st_index     index of the step in steps[]
+*/
+void compile_step(uint16_t st_index) {
+    step_events[st_index] = validate_step(&steps[st_index]);
+
+    store_mark_step(st_index);
+}
+
+void compile_sequence(uint8_t sq_index) {
+    uint16_t seq_base_index = ((uint16_t)sq_index * CONFIG_STEPS_PER_SEQUENCE);
+
+    for(uint16_t i = 0; i < CONFIG_STEPS_PER_SEQUENCE; i++) {
+        compile_step(seq_base_index + i);
+    }
+}
+
+/*
+    compile the steps of a sequence held outside steps[], a sequence of a bank
+    decoded ahead of the swap. nothing is marked to be saved
+
+    @param st   CONFIG_STEPS_PER_SEQUENCE steps
+    @param ev   where their events are written
+*/
+void compile_steps(step_t* st, step_events_t* ev) {
+    for(uint8_t i = 0; i < CONFIG_STEPS_PER_SEQUENCE; i++) {
+        ev[i] = validate_step(&st[i]);
+    }
+}
+
+/*
+    play a sequence from compiled steps held outside steps[]. called by the
+    play task as it swaps a bank in
+
+    @param st   CONFIG_STEPS_PER_SEQUENCE steps, compiled with compile_steps()
+    @param ev   their events
+*/
+void play_steps_from(uint8_t sq_index, const step_t* st, const step_events_t* ev) {
+    play_steps[sq_index] = st;
+    play_events[sq_index] = ev;
+}
+
+/*
+    copy a sequence played from outside steps[] into it and play it from there
+    again. the copies are the same so the play task can read either side of
+    the switch
+
+    @param st   the steps play_steps_from() was given
+    @param ev   their events
+*/
+void adopt_steps(uint8_t sq_index, const step_t* st, const step_events_t* ev) {
+    uint16_t base = (uint16_t)sq_index * CONFIG_STEPS_PER_SEQUENCE;
+
+    memcpy(&steps[base], st, sizeof(step_t) * CONFIG_STEPS_PER_SEQUENCE);
+    memcpy(&step_events[base], ev, sizeof(step_events_t) * CONFIG_STEPS_PER_SEQUENCE);
+    __DMB();
+
+    play_steps[sq_index] = &steps[base];
+    play_events[sq_index] = &step_events[base];
+}
 
 /*
-    load the notes contained in the step into the note_on and note_off buffers
+    queue a release of the notes sounding on the channel of every enabled
+    sequence, ahead of the notes of the next step. the ports send a note off
+    for each of them with the step
+
+    @param port_buffers     note on and note off buffers for each port
+    @param num_ports        number of elements in port_buffers
+*/
+void release_sequences(port_buffers_t* port_buffers, uint8_t num_ports) {
+    for(uint8_t i = 0; i < CONFIG_TOTAL_SEQUENCES; i++) {
+        uint8_t port = (sequences[i].channel & 0xF0) >> 4;
+
+        if(!is_sq_enabled(i) || port >= num_ports) {
+            continue;
+        }
+
+        MIDIPacket_t p = {
+            .channel = sequences[i].channel & 0x0F,
+            .status = MIDI_OUT_RELEASE,
+        };
+
+        mbuf_push(port_buffers[port].note_off, p);
+    }
+}
+
+/*
+    load the notes contained in the step into the note_on and note_off buffers.
+    the step has already been compiled, so the first step_events counts of
+    note_off and note_on are known to be valid
 
     @param note_on_mbuf
     @param note_off_mbuf
     @param c        The midi channel the notes should be played over
     @param muted    A flag to mark muted or unmuted state for the step
-    @param st       A pointer to a step struct containing note_on, and note_off
-                    notes, and the end of step byte (0x00 or 0xFF depending on
-                    if it's the end of the step or the whole sequence)
+    @param st       The step
+    @param ev       The counts of its notes
 */
 static void load_step_notes(
     mbuf_handle_t note_on_mbuf,
     mbuf_handle_t note_off_mbuf,
     MIDIChannel_t c,
     uint8_t muted,
-    step_t* st
+    const step_t* st,
+    step_events_t ev
 ) {
-    for(int i = 0; i < CONFIG_MAX_POLYPHONY; i++) {
-        MIDINote_t n = st->note_off[i] & 0x7F;
 
-        if(n <= C8 && n >= A0) {
-            MIDIPacket_t p = {
-                .channel = c,
-                .status = NOTE_OFF,
-                .note = n,
-                .velocity = 0,
-            };
+    MIDIPacket_t p = {
+        .channel = c,
+        .status = NOTE_OFF,
+        .velocity = 0,
+    };
 
-            mbuf_push(note_off_mbuf, p);
-        }
+    for(uint8_t i = 0; i < ev.note_off; i++) {
+        p.note = st->note_off[i];
+        mbuf_push(note_off_mbuf, p);
     }
 
     if(!muted) {
-        for(int i = 0; i < CONFIG_MAX_POLYPHONY; i++) {
-            MIDINote_t n = st->note_on[i].note & 0x7F;
-    
-            if(n <= C8 && n >= A0) {
-                MIDIPacket_t p = {
-                    .channel = c,
-                    .status = NOTE_ON,
-                    .note = n,
-                    .velocity = st->note_on[i].velocity,
-                };
-        
-                mbuf_push(note_on_mbuf, p);
-            }
+        p.status = NOTE_ON;
+
+        for(uint8_t i = 0; i < ev.note_on; i++) {
+            p.note = st->note_on[i].note;
+            p.velocity = st->note_on[i].velocity;
+            mbuf_push(note_on_mbuf, p);
         }
     }
 }
@@ -149,126 +292,167 @@ static uint8_t is_muted(uint32_t* muted_steps, uint8_t step) {
     return ret;
 }
 
-step_t get_step_from_index(uint16_t step_index) {
-    return steps[step_index];
+step_t* get_step_from_index(uint16_t step_index) {
+    return &steps[step_index];
 }
 
-static void load_sequence(uint8_t sq_index, mbuf_handle_t note_on_mbuf, mbuf_handle_t note_off_mbuf) {
+/*
+    load the current step of an enabled sequence and advance its counter
+
+    @param sq_index         index of the sequence
+    @param note_on_mbuf     note on buffer of the sequence's port
+    @param note_off_mbuf    note off buffer of the sequence's port
+
+    @return 1 if the sequence looped back to its start, else 0
+*/
+static uint8_t load_sequence(uint8_t sq_index, mbuf_handle_t note_on_mbuf, mbuf_handle_t note_off_mbuf) {
     MIDISequence_t* sq = &sequences[sq_index];
+    uint8_t looped = 0;
+    uint8_t prev_counter = sq->counter;
 
-    if(check_bit(enabled_sequences, sq_index, CONFIG_TOTAL_SEQUENCES)) {
-        uint8_t prev_counter = sq->counter;
+    if(sq->prescale_counter == 0) {
+        uint8_t prev_step = sq->counter - 1;
+        if(sq->counter == 0) {
+            prev_step = CONFIG_STEPS_PER_SEQUENCE - 1;
+        }
+        
+        /*
+            this is rendered ahead of the clock so the release is queued with
+            the step's note offs rather than sent immediately. the port sends
+            a note off for each note still sounding on the channel
+        */
+        if(is_disabled(sq->enabled_steps, prev_step)) {
+            MIDIPacket_t p = {
+                .channel = sq->channel & 0x0F,
+                .status = MIDI_OUT_RELEASE,
+            };
 
-        if(sq->prescale_counter == 0) {
-            uint8_t prev_step = sq->counter - 1;
-            if(sq->counter == 0) {
-                prev_step = CONFIG_STEPS_PER_SEQUENCE - 1;
-            }
-            
-            if(is_disabled(sq->enabled_steps, prev_step)) {
-                MIDICC_t p = {
-                    .status = CONTROLLER,
-                    .channel = sq->channel & 0x0F,
-                    .control = ALL_NOTES_OFF,
-                    .value = 0,
-                };
-    
-                uint8_t port = (p.channel & 0xF0) >> 4;
-    
-                switch(port) {
-                case 0:
-                    send_midi_control(USART1, &p);
-                    break;
-                case 1:
-                    send_midi_control(USART2, &p);
-                    break;
-                case 2:
-                    send_midi_control(UART4, &p);
-                    break;
-                case 3:
-                    send_midi_control(USART6, &p);
-                    break;
-                default:
-                    #ifdef CONFIG_DEBUG_PRINT
-                        send_uart(USART3, "incorrect port num\n\r", 20);
-                    #endif
-                    break;
-                }
-            }
-            
-            uint16_t seq_base_index = ((uint16_t)sq_index * CONFIG_STEPS_PER_SEQUENCE);
-            uint16_t step_index = seq_base_index + (uint16_t)sq->counter;
-            step_t st = get_step_from_index(step_index);
-    
-            // uint8_t err = get_step(sq, sq_index, &st);
-    
-            uint8_t muted = is_muted(sq->muted_steps, sq->counter);
-    
-            load_step_notes(
-                note_on_mbuf,
-                note_off_mbuf,
-                sq->channel,
-                muted,
-                &st);
+            mbuf_push(note_off_mbuf, p);
         }
-            
-        sq->prescale_counter++;
-
-        if(sq->prescale_counter > sq->prescale_value) {
-            goto_next_enabled_step(&sq->counter, sq->enabled_steps);
-            
-            if(sq->counter <= prev_counter) {
-                queued_sequences[0] |= sq->queue[0];
-                queued_sequences[1] |= sq->queue[1];
-                memset(sq->queue, 0, sizeof(uint32_t) * 2);
-    
-                if(check_bit(break_sequences, sq_index, CONFIG_TOTAL_SEQUENCES)) {
-                    disable_sequence(sq_index);
-                    clear_bit(break_sequences, sq_index, CONFIG_TOTAL_SEQUENCES);
-                }
-            }
-    
-            sq->prescale_counter = 0;
+        
+        uint8_t muted = is_muted(sq->muted_steps, sq->counter);
+
+        load_step_notes(
+            note_on_mbuf,
+            note_off_mbuf,
+            sq->channel,
+            muted,
+            &play_steps[sq_index][sq->counter],
+            play_events[sq_index][sq->counter]);
+    }
+        
+    sq->prescale_counter++;
+
+    if(sq->prescale_counter > sq->prescale_value) {
+        goto_next_enabled_step(&sq->counter, sq->enabled_steps);
+        
+        if(sq->counter <= prev_counter) {
+            queued_sequences[0] |= sq->queue[0];
+            queued_sequences[1] |= sq->queue[1];
+            memset(sq->queue, 0, sizeof(uint32_t) * 2);
+
+            looped = 1;
         }
+
+        sq->prescale_counter = 0;
     }
+
+    return looped;
 }
 
 /*
-    play the current steps in the currently active sequences
-
-    @param note_on_mbuf     midi packet buffer for note on packets
-    @param note_off_mbuf    midi packet buffer for note off packets
+    play the current steps in the currently active sequences. only the enabled
+    sequences are visited, each word of enabled_sequences is walked by taking
+    the lowest set bit with count trailing zeros and then clearing it, so the
+    cost of a tick follows the number of playing sequences rather than
+    CONFIG_TOTAL_SEQUENCES
+
+    @param port_buffers     note on and note off buffers for each port
+    @param num_ports        number of elements in port_buffers
 */
-void load_sequences(UARTTaskParams_t* port_buffers, uint8_t num_ports) {
-    for(int i = 0; i < CONFIG_TOTAL_SEQUENCES; i++) {
-        uint8_t port = (sequences[i].channel & 0xF0) >> 4;
-        load_sequence(i, port_buffers[port].note_on, port_buffers[port].note_off);
+void load_sequences(port_buffers_t* port_buffers, uint8_t num_ports) {
+    uint32_t looped_sequences[2] = {0};
+
+    snapshot_seq++;
+    __DMB();
+
+    for(uint8_t w = 0; w < 2; w++) {
+        // a sequence whose steps are still on flash is skipped until loaded
+        uint32_t active = enabled_sequences[w] & store_loaded_mask(w);
+
+        while(active) {
+            uint8_t bit = __builtin_ctz(active);
+            active &= active - 1;
+
+            uint8_t i = (w * 32) + bit;
+            uint8_t port = (sequences[i].channel & 0xF0) >> 4;
+
+            if(port >= num_ports) {
+                continue;
+            }
+
+            snapshot.playhead[i] = sequences[i].counter;
+
+            if(load_sequence(i, port_buffers[port].note_on, port_buffers[port].note_off)) {
+                looped_sequences[w] |= (1U << bit);
+            }
+        }
     }
 
     /*
-        if a sequence is queued but is already playing then we don't want to
-        restart it so we will unset that bit in queued_sequences
+        sequences marked to break stop once they have played through to the
+        end. disable_sequence() resets each one so those still go one by one
     */
-    queued_sequences[0] &= ~enabled_sequences[0];
-    queued_sequences[1] &= ~enabled_sequences[1];
+    for(uint8_t w = 0; w < 2; w++) {
+        uint32_t broken = looped_sequences[w] & break_sequences[w];
+        break_sequences[w] &= ~broken;
+
+        while(broken) {
+            uint8_t bit = __builtin_ctz(broken);
+            broken &= broken - 1;
+
+            disable_sequence((w * 32) + bit);
+        }
+    }
 
     /*
+        if a sequence is queued but is already playing then we don't want to
+        restart it. setting the queued bits leaves those sequences untouched.
+
         there may be a case where sequence N is triggering on sequence M where
-        N < M. N will have already been processed in the first load_sequences()
-        but will not be playing yet as it hasn't been enabled. we look at
-        the sequences that are queued are are not already enabled, then enable
-        them. This will keep N in sync with M
+        N < M. N will have already been skipped in the walk above as it isn't
+        enabled yet. enabling the queued sequences here, after the walk, keeps
+        N in sync with M
     */
-    for(int i = 0; i < CONFIG_TOTAL_SEQUENCES; i++) {
-        if(check_bit(queued_sequences, i, CONFIG_TOTAL_SEQUENCES)) {
-            enable_sequence(i);
-            clear_bit(queued_sequences, i, CONFIG_TOTAL_SEQUENCES);
-        }
+    for(uint8_t w = 0; w < 2; w++) {
+        enabled_sequences[w] |= queued_sequences[w];
+        queued_sequences[w] = 0;
+        snapshot.playing[w] = enabled_sequences[w];
     }
 
+    __DMB();
+    snapshot_seq++;
+
     return;
 }
 
+/*
+    copy the playback state published by the last load_sequences(). if the
+    play task published again part way through the copy, it's taken again
+
+    @param s    where the snapshot is copied to
+*/
+void read_play_snapshot(play_snapshot_t* s) {
+    uint32_t seq;
+
+    do {
+        seq = snapshot_seq;
+        __DMB();
+        memcpy(s, &snapshot, sizeof(*s));
+        __DMB();
+    } while((seq & 1) || seq != snapshot_seq);
+}
+
 /*
     toggle a sequence between enabled and disabled
 
@@ -295,6 +479,8 @@ void toggle_sequences(uint32_t* select_mask, uint8_t max) {
 }
 
 void enable_sequence(uint8_t sq_index) {
+    store_load_sequence(sq_index);
+
     uint8_t array_index = sq_index / 32;
     uint8_t bit_position = sq_index % 32;
 
@@ -312,35 +498,9 @@ void disable_sequence(uint8_t sq_index) {
 
     enabled_sequences[array_index] &= ~(1 << bit_position);
 
-    MIDICC_t p = {
-        .status = CONTROLLER,
-        .channel = sequences[sq_index].channel & 0x0F,
-        .control = ALL_NOTES_OFF,
-        .value = 0,
-    };
-
-    uint8_t port = (p.channel & 0xF0) >> 4;
-
-    switch(port) {
-        case 0:
-            send_midi_control(USART1, &p);
-            break;
-        case 1:
-            send_midi_control(USART2, &p);
-            break;
-        case 2:
-            send_midi_control(UART4, &p);
-            break;
-        case 3:
-            send_midi_control(USART6, &p);
-            break;
-        default:
-            #ifdef CONFIG_DEBUG_PRINT
-                send_uart(USART3, "incorrect port num\n\r", 20);
-            #endif
-            break;
-    }
+    uint8_t port = (sequences[sq_index].channel & 0xF0) >> 4;
 
+    midi_out_release(port, sequences[sq_index].channel & 0x0F);
 }
 
 void break_sequence(uint8_t sq_index) {
@@ -351,6 +511,7 @@ void break_sequence(uint8_t sq_index) {
 }
 
 void clear_sequence(uint8_t sq_index) {
+    store_load_sequence(sq_index);
     disable_sequence(sq_index);
 
     uint16_t seq_base_index = ((uint16_t)sq_index * CONFIG_STEPS_PER_SEQUENCE);
@@ -359,56 +520,32 @@ void clear_sequence(uint8_t sq_index) {
     note_t note_on[CONFIG_MAX_POLYPHONY] = {0};
     MIDINote_t note_off[CONFIG_MAX_POLYPHONY] = {0};
 
+    store_preserve_sequence(sq_index);
+
+    vTaskSuspendAll();
+
     for(uint32_t i = seq_base_index; i < end_of_sequence; i++) {
         memcpy(steps[i].note_on, note_on, sizeof(note_on));
         memcpy(steps[i].note_off, note_off, sizeof(note_off));
     }
-}
-
-static void save_array(uint32_t base_addr, uint8_t* ptr, uint32_t size) {
-    uint16_t page_size = 0x100;
-    uint8_t rx[256];
-
-    for(uint32_t offset = 0; offset < size; offset+=page_size) {
-        uint16_t bytes_to_write = page_size;
-
-        if(offset + page_size > size) {
-            bytes_to_write = size - offset;
-        }
 
-        flash_programPage(base_addr, ptr + offset, rx, bytes_to_write);
+    compile_sequence(sq_index);
 
-        base_addr += bytes_to_write;
-    }
+    xTaskResumeAll();
 }
 
-void save_data() {
-    flash_eraseChip();
-
-    uint32_t addr = CONFIG_METADATA_BASE_ADDR;
-
-    uint8_t tx[CONFIG_METADATA_BYTES_PER_SEQ];
-
-    for(int i = 0; i < CONFIG_TOTAL_SEQUENCES; i++) {
-        memset(tx, 0, sizeof(tx));
-        tx[0] = (uint8_t)sequences[i].channel;
-        tx[1] = (uint8_t)sequences[i].prescale_value;
-        memcpy(&tx[2], sequences[i].enabled_steps, sizeof(sequences[i].enabled_steps));
-
-        flash_programPage(addr, tx, tx, CONFIG_METADATA_BYTES_PER_SEQ);
-
-        addr+=CONFIG_METADATA_BYTES_PER_SEQ;
-    }
-
-    save_array(CONFIG_STEPS_BASE_ADDR, (uint8_t*)steps, sizeof(steps));
-}
+/*
+    encode the packets in a buffer into the step buffer of a port. the caller
+    must hold the midi_out lock
 
-void play_notes(mbuf_handle_t mbuf, USART_TypeDef* port) {
-    while(!mbuf_empty(mbuf)) {
-        MIDIPacket_t p;
-        mbuf_pop(mbuf, &p);
+    @param mbuf     buffer of packets to send
+    @param port     index of the port (0-3)
+*/
+void play_notes(mbuf_handle_t mbuf, uint8_t port) {
+    MIDIPacket_t p;
 
-        send_midi_note(port, &p);
+    while(mbuf_pop(mbuf, &p) == 0) {
+        midi_out_queue(port, &p);
     }
 }
 
@@ -418,13 +555,20 @@ void play_notes(mbuf_handle_t mbuf, USART_TypeDef* port) {
     only called in the sq_midi state which always disables the sequence on entry
 */
 void set_midi_channel(uint8_t sq_index, MIDIChannel_t channel) {
+    store_load_sequence(sq_index);
+    store_preserve_metadata(sq_index);
     sequences[sq_index].channel = channel;
+    store_mark_metadata(sq_index);
 }
 
 MIDIChannel_t get_channel(uint8_t sq_index) {
     return sequences[sq_index].channel;
 }
 
+uint8_t num_enabled_sequences() {
+    return __builtin_popcount(enabled_sequences[0]) + __builtin_popcount(enabled_sequences[1]);
+}
+
 uint8_t is_sq_enabled(uint8_t sq_index) {
     return check_bit(enabled_sequences, sq_index, CONFIG_TOTAL_SEQUENCES);
 }
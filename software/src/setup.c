@@ -12,9 +12,44 @@
 #include <string.h>
 #include "display.h"
 #include "common.h"
+#include "util.h"
 
 uint8_t display_buffer[DISPLAY_BUFFER_SIZE];
 
+#ifdef CONFIG_PROFILE_BOOT
+static uint32_t boot_start;
+static uint32_t phase_start;
+
+static void start_boot_profile() {
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->LAR = 0xC5ACCE55;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    boot_start = 0;
+    phase_start = 0;
+}
+
+static void print_us(char* name, uint8_t len, uint32_t cycles) {
+    char s[11];
+    uint8_t slen = u32_to_str(cycles / (SystemCoreClock / 1000000), s);
+
+    send_uart(USART3, name, len);
+    send_uart(USART3, " ", 1);
+    send_uart(USART3, s, slen);
+    send_uart(USART3, "us\n\r", 4);
+}
+
+/*
+    print how long the phase of setup() that just finished took
+*/
+static void boot_phase(char* name, uint8_t len) {
+    uint32_t now = DWT->CYCCNT;
+    print_us(name, len, now - phase_start);
+    phase_start = DWT->CYCCNT;
+}
+#endif
+
 void setup(MIDISequence_t* sequences) {
     /*
     setup uart for st link
@@ -24,6 +59,10 @@ void setup(MIDISequence_t* sequences) {
     */
    int err;
 
+    #ifdef CONFIG_PROFILE_BOOT
+        start_boot_profile();
+    #endif
+
     USART_Handler u;
     u.uart = USART3;
     u.baud = 9600;
@@ -97,6 +136,10 @@ void setup(MIDISequence_t* sequences) {
 
     NVIC_EnableIRQ(USART1_IRQn);
 
+    #ifdef CONFIG_PROFILE_BOOT
+        boot_phase("uarts", 5);
+    #endif
+
     SPI_Handler s;
     s.spi = SPI1;
     s.gpio = GPIOA;
@@ -119,17 +162,30 @@ void setup(MIDISequence_t* sequences) {
         send_uart(USART3, "Error initialising SPI flash chip\n\r", 34);
     }
 
+    #ifdef CONFIG_PROFILE_BOOT
+        boot_phase("spi flash", 9);
+    #endif
+
     err = init_sequences();
     if(err) {
         send_uart(USART3, "Error initialising sequences\n\r", 30);
     }
 
+    #ifdef CONFIG_PROFILE_BOOT
+        boot_phase("sequences", 9);
+    #endif
+
     init_i2c();
     init_ssd1306();
+    display_init();
 
     memset(display_buffer, 0, 1024);
     clear_display();
 
+    #ifdef CONFIG_PROFILE_BOOT
+        boot_phase("display", 7);
+    #endif
+
     // shift register
     // initialise gpio
     RCC->AHB1ENR |= RCC_AHB1ENR_GPIODEN;
@@ -162,6 +218,10 @@ void setup(MIDISequence_t* sequences) {
     }
     #endif
 
+    #ifdef CONFIG_PROFILE_BOOT
+        boot_phase("keyboard", 8);
+    #endif
+
     // initialise menu state machine
     menu(E_MAIN_MENU, E_NO_HOLD);
 
@@ -174,6 +234,11 @@ void setup(MIDISequence_t* sequences) {
     EXTI->RTSR |= (EXTI_RTSR_TR11 | EXTI_RTSR_TR12);    // enable rising edge int
 
     NVIC_EnableIRQ(EXTI15_10_IRQn);
+
+    #ifdef CONFIG_PROFILE_BOOT
+        boot_phase("menu", 4);
+        print_us("setup total", 11, DWT->CYCCNT - boot_start);
+    #endif
     
     send_uart(USART3, "Finished initialisation\n\r", 25);
 }
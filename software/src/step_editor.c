@@ -1,7 +1,9 @@
 #include "step_editor.h"
 #include "FreeRTOS.h"
 #include "semphr.h"
+#include "task.h"
 #include "sequence.h"
+#include "store.h"
 #include "uart.h"
 #include "util.h"
 #include "midi.h"
@@ -93,6 +95,7 @@ void edit_step_note(
     uint16_t seq_base_index = ((uint16_t)sq * CONFIG_STEPS_PER_SEQUENCE);
     uint16_t index = seq_base_index + (uint16_t)step;
 
+    store_load_sequence(sq);
     s = steps[index];
 
     switch(status) {
@@ -108,23 +111,31 @@ void edit_step_note(
             break;
     }
 
+    store_preserve_step(index);
     steps[index] = s;
+    compile_step(index);
 }
 
 void mute_step(uint8_t sequence, uint8_t step) {
+    store_load_sequence(sequence);
+
     uint32_t* muted_steps = sequences[sequence].muted_steps;
     toggle_bit(muted_steps, step, CONFIG_STEPS_PER_SEQUENCE);
 }
 
 void toggle_step(uint8_t sequence, uint8_t step) {
     uint32_t* en_steps = sequences[sequence].enabled_steps;
+    store_load_sequence(sequence);
+    store_preserve_metadata(sequence);
     toggle_bit(en_steps, step, CONFIG_STEPS_PER_SEQUENCE);
+    store_mark_metadata(sequence);
 }
 
 void edit_step_velocity(uint8_t sq, uint8_t step, int8_t amount) {
     step_t s;
     uint16_t index = ((uint16_t)sq * CONFIG_STEPS_PER_SEQUENCE) + (uint16_t)step;
 
+    store_load_sequence(sq);
     s = steps[index];
 
     uint8_t v = s.note_on[0].velocity;
@@ -143,7 +154,9 @@ void edit_step_velocity(uint8_t sq, uint8_t step, int8_t amount) {
         s.note_on[i].velocity = v;
     }
 
+    store_preserve_step(index);
     steps[index] = s;
+    store_mark_step(index);
 }
 
 uint8_t get_step_velocity(uint8_t sq, uint8_t st) {
@@ -208,11 +221,22 @@ static void defrag_buffer(uint8_t* buffer, uint8_t len) {
     }
 }
 
+/*
+    the functions below remove notes from steps. playback trusts the counts that
+    compile_step() records, so the scheduler is suspended while a step shrinks
+    to stop the play task reading a count that is ahead of its notes. the
+    sequence is loaded before that, as loading may wait on the flash
+*/
 void clear_step(uint8_t sq, uint8_t step) {
     uint16_t sq_start = ((uint16_t)sq * CONFIG_STEPS_PER_SEQUENCE);
     uint16_t index = sq_start + (uint16_t)step;
     memset(&note_matrix, 0, NUM_VALID_NOTES);
 
+    store_load_sequence(sq);
+    store_preserve_sequence(sq);
+
+    vTaskSuspendAll();
+
     // the number of valid elements in note_on
     uint8_t num_notes = init_note_matrix(index);
 
@@ -225,6 +249,7 @@ void clear_step(uint8_t sq, uint8_t step) {
 
         if(deletions > 0) {
             defrag_buffer(steps[sq_start + (uint16_t)i].note_off, CONFIG_MAX_POLYPHONY);
+            compile_step(sq_start + (uint16_t)i);
             num_notes -= deletions;
         }
 
@@ -240,6 +265,7 @@ void clear_step(uint8_t sq, uint8_t step) {
 
             if(deletions > 0) {
                 defrag_buffer(steps[sq_start + (uint16_t)i].note_off, CONFIG_MAX_POLYPHONY);
+                compile_step(sq_start + (uint16_t)i);
                 num_notes -= deletions;
             }     
         }
@@ -248,6 +274,9 @@ void clear_step(uint8_t sq, uint8_t step) {
     note_t note_on[CONFIG_MAX_POLYPHONY] = {0};
 
     memcpy(steps[index].note_on, note_on, sizeof(note_on));
+    compile_step(index);
+
+    xTaskResumeAll();
 }
 
 /*
@@ -291,7 +320,8 @@ static uint8_t array_all_zeroes(note_t* a, uint8_t array_length) {
 }
 
 void copy_step(step_t* temp_st, uint8_t* note_off_offsets, uint8_t sq, uint8_t st) {
-    uint16_t st_index = (sq*64)+st;
+    uint16_t sq_start = (uint16_t)sq * CONFIG_STEPS_PER_SEQUENCE;
+    uint16_t st_index = sq_start + st;
     memcpy(temp_st, &steps[st_index], sizeof(step_t));
 
     note_t note_on_arr[CONFIG_MAX_POLYPHONY];
@@ -305,7 +335,7 @@ void copy_step(step_t* temp_st, uint8_t* note_off_offsets, uint8_t sq, uint8_t s
     */
 
     for(uint8_t i = st+1; i < CONFIG_STEPS_PER_SEQUENCE; i++) {
-        uint8_t next_step_index = (sq*64)+i;
+        uint16_t next_step_index = sq_start + i;
         uint8_t note_distance = i - st;
         check_step(note_on_arr, steps[next_step_index], note_off_offsets, note_distance);
 
@@ -317,7 +347,7 @@ void copy_step(step_t* temp_st, uint8_t* note_off_offsets, uint8_t sq, uint8_t s
     // continue iterating from the first step
     if(array_all_zeroes(note_on_arr, CONFIG_MAX_POLYPHONY) == 0) {
         for(uint8_t i = 0; i <= st; i++) {
-            uint8_t next_step_index = (sq*64)+i;
+            uint16_t next_step_index = sq_start + i;
             uint8_t note_distance = (CONFIG_STEPS_PER_SEQUENCE - st) + i;
             check_step(note_on_arr, steps[next_step_index], note_off_offsets, note_distance);
             
@@ -330,21 +360,37 @@ void copy_step(step_t* temp_st, uint8_t* note_off_offsets, uint8_t sq, uint8_t s
 }
 
 void paste_step(step_t temp_step, uint8_t* note_off_offsets, uint8_t sq, uint8_t st) {
+    uint16_t sq_start = (uint16_t)sq * CONFIG_STEPS_PER_SEQUENCE;
+    uint16_t index = sq_start + st;
+
+    store_load_sequence(sq);
+
+    vTaskSuspendAll();
+
     clear_step(sq, st);
 
-    memcpy(steps[st].note_on, temp_step.note_on, sizeof(note_t)*CONFIG_MAX_POLYPHONY);
+    store_preserve_step(index);
+    memcpy(steps[index].note_on, temp_step.note_on, sizeof(note_t)*CONFIG_MAX_POLYPHONY);
+    compile_step(index);
 
     // TODO protect against buffer overflow or buffer overwriting
     for(uint8_t i = 0; i < CONFIG_MAX_POLYPHONY; i++) {
-        uint16_t note_off_index = note_off_offsets[i] + st;
+        uint16_t note_off_step = note_off_offsets[i] + st;
         uint8_t note = temp_step.note_on[i].note;
 
-        if(note_off_index > CONFIG_STEPS_PER_SEQUENCE) {
-            note_off_index-=CONFIG_STEPS_PER_SEQUENCE;
+        // the note off wraps round to the start of the sequence
+        if(note_off_step >= CONFIG_STEPS_PER_SEQUENCE) {
+            note_off_step -= CONFIG_STEPS_PER_SEQUENCE;
         }
 
+        uint16_t note_off_index = sq_start + note_off_step;
+
+        store_preserve_step(note_off_index);
         fifo_push_note_off(&steps[note_off_index], CONFIG_MAX_POLYPHONY, note);
+        compile_step(note_off_index);
     }
+
+    xTaskResumeAll();
 }
 
 void display_step_notes(uint8_t sq, uint8_t st) {
@@ -353,10 +399,17 @@ void display_step_notes(uint8_t sq, uint8_t st) {
     for(uint8_t i = 0; i < CONFIG_MAX_POLYPHONY; i++) {
         show_note(steps[(sq*64)+st].note_on[i].note);
     }
-
-    update_display();
 }
 
 void copy_steps(uint16_t dst_sq, uint16_t src_sq, uint8_t n) {
+    store_load_sequence(src_sq);
+    store_load_sequence(dst_sq);
+    store_preserve_sequence(dst_sq);
+
+    vTaskSuspendAll();
+
     memcpy(&steps[dst_sq*64], &steps[src_sq*64], n);
+    compile_sequence(dst_sq);
+
+    xTaskResumeAll();
 }
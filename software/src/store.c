@@ -0,0 +1,2030 @@
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+#include "midi.h"
+#include "store.h"
+#include "midi_out.h"
+#include "sequence.h"
+#include "flash.h"
+#include "uart.h"
+#include "util.h"
+#include <string.h>
+#include "autoconf.h"
+#include "stm32f722xx.h"
+
+/*
+    sequences are saved as a log of records in CONFIG_STORE_SECTORS sectors of
+    flash starting at CONFIG_STORE_BASE_ADDR. a save appends a record for each
+    block of sequence metadata or sequence steps that has changed, so it only
+    ever programs pages that are already erased. a save is committed by a
+    checkpoint written to one of two slots after the log. the record index of
+    each bank whose records moved is appended to the log first and the
+    checkpoint says where those index records are, so start up only has to
+    read the newest good checkpoint and an index record for each bank instead
+    of every record header. without one the newest record of each block is
+    found from its seq_no by scanning the log.
+
+    the log is used as a ring of sectors. records are appended at the head and
+    the oldest sector, the tail, is reclaimed by copying any records still
+    current in it to the head and erasing it. every sector is erased in turn so
+    the wear is spread over the whole region. a few erased sectors are kept
+    ahead of the head so a save doesn't normally have to wait on an erase
+
+    the old fixed layout at CONFIG_METADATA_BASE_ADDR and CONFIG_STEPS_BASE_ADDR
+    is only read, for any block of bank 0 the log doesn't hold yet
+
+    only the metadata is read at start up. the steps of a sequence are read
+    the first time it is needed, so playback can start before all of them are
+    in memory
+
+    the log holds CONFIG_STORE_BANKS banks of sequences but only one of them,
+    the working set, is in sequences[] and steps[]. switching banks saves the
+    working set, then the save task reads the records of the next bank into a
+    staging buffer while playback carries on. the play task swaps the staged
+    bank in on the first step of a bar, which only has to decode the sequences
+    that are playing, the rest are decoded as they are needed
+*/
+
+#if CONFIG_MAX_POLYPHONY > 15
+#error "a step's note counts are saved in 4 bits each"
+#endif
+
+/*
+    a sequence's metadata in a record is its channel, prescale and enabled
+    steps. sixteen of them fit a page, so all of the metadata is saved with
+    four page programs. the old fixed layout pads each to
+    CONFIG_METADATA_BYTES_PER_SEQ
+*/
+#define METADATA_ENTRY (2 + sizeof(((MIDISequence_t*)0)->enabled_steps))
+#define METADATA_PAYLOAD (STORE_SEQS_PER_RECORD * METADATA_ENTRY)
+
+/*
+    the steps of a sequence are saved as a bitmap of the steps holding any
+    notes, followed by an entry for each of those steps. an entry is a byte
+    with the number of note offs in the high nibble and note ons in the low,
+    then the note offs, then a note and velocity for each note on. empty steps
+    take no space, so most sequences fit in a page
+*/
+#define OCCUPANCY_BYTES (CONFIG_STEPS_PER_SEQUENCE / 8)
+#define STEP_ENTRY_MAX (1 + (3 * CONFIG_MAX_POLYPHONY))
+#define SEQUENCE_PAYLOAD_MAX (OCCUPANCY_BYTES + (CONFIG_STEPS_PER_SEQUENCE * STEP_ENTRY_MAX))
+
+#define RECORD_PAYLOAD_MAX SEQUENCE_PAYLOAD_MAX
+#define RECORD_PAGES_MAX ((sizeof(store_header_t) + RECORD_PAYLOAD_MAX + STORE_PAGE_SIZE - 1) / STORE_PAGE_SIZE)
+#define RECORD_BUFFER_SIZE (RECORD_PAGES_MAX * STORE_PAGE_SIZE)
+
+#define CHECKPOINT_PAGES ((sizeof(store_header_t) + sizeof(store_checkpoint_t) + STORE_PAGE_SIZE - 1) / STORE_PAGE_SIZE)
+#define CHECKPOINTS_PER_SLOT (STORE_PAGES_PER_SECTOR / CHECKPOINT_PAGES)
+
+/*
+    a slot is erased each time the checkpoints move on to it, so every save
+    would erase one if a slot held only a few
+*/
+_Static_assert(CHECKPOINTS_PER_SLOT >= 4, "a checkpoint slot holds too few checkpoints");
+
+// an index record is a page number for each block of a bank, in one page
+#define INDEX_PAYLOAD (STORE_BANK_BLOCKS * sizeof(uint16_t))
+
+_Static_assert(sizeof(store_header_t) + INDEX_PAYLOAD <= STORE_PAGE_SIZE, "a bank's index record doesn't fit a page");
+_Static_assert(CONFIG_STORE_BANKS <= 32, "the banks whose index changed are kept as bits of a word");
+
+#define STORE_NO_BLOCK 0xFFFF
+
+/*
+    the sectors the index records of every bank take, which a checkpoint
+    writes at most
+*/
+#define INDEX_SECTORS_MAX ((CONFIG_STORE_BANKS + STORE_PAGES_PER_SECTOR - 1) / STORE_PAGES_PER_SECTOR)
+
+/*
+    the free sectors a save leaves for its checkpoint's index records and a
+    compaction to relocate one sector's records and write their index records
+    into. a save that would take the head any closer to the tail finds the
+    store full
+*/
+#define STORE_MIN_FREE_SECTORS (2 + (2 * INDEX_SECTORS_MAX))
+
+/*
+    the most sectors the current records of every bank can take. a record
+    never crosses into the next sector, so at worst a sector holds as many
+    records as the largest fit in it. the log needs those, the erased sectors
+    kept ready for saving and the head on top, or a compaction could find
+    nothing left to reclaim. each bank has an index record current as well
+*/
+#define RECORDS_PER_SECTOR_MIN (STORE_PAGES_PER_SECTOR / RECORD_PAGES_MAX)
+#define STORE_LIVE_SECTORS_MAX ((STORE_RECORDS + CONFIG_STORE_BANKS + RECORDS_PER_SECTOR_MIN - 1) / RECORDS_PER_SECTOR_MIN)
+
+_Static_assert(
+    CONFIG_STORE_SECTORS >= STORE_LIVE_SECTORS_MAX + CONFIG_STORE_FREE_SECTORS + 1,
+    "CONFIG_STORE_SECTORS can't hold every record of CONFIG_STORE_BANKS banks"
+);
+_Static_assert(CONFIG_STORE_FREE_SECTORS >= STORE_MIN_FREE_SECTORS, "CONFIG_STORE_FREE_SECTORS is below the sectors a compaction needs");
+
+extern MIDISequence_t sequences[CONFIG_TOTAL_SEQUENCES];
+extern step_t steps[CONFIG_TOTAL_SEQUENCES * CONFIG_STEPS_PER_SEQUENCE];
+
+/*
+    address of the current record for each block of every bank,
+    STORE_NO_RECORD if the log doesn't hold one. the seq_no of a record
+    restored from a checkpoint isn't known until the record is read, until
+    then it is the checkpoint's next_seq_no which every committed record is
+    below
+*/
+static uint32_t record_addr[STORE_RECORDS];
+static uint32_t record_seq[STORE_RECORDS];
+
+/*
+    address of the current index record of each bank, and a bit for each
+    bank whose record_addr changed since its index record was written
+*/
+static uint32_t index_addr[CONFIG_STORE_BANKS];
+static uint32_t index_dirty;
+
+/*
+    the bank in sequences[] and steps[]. dirty, the running save and the copy
+    on write slots all index the blocks of this bank alone
+*/
+static uint8_t bank;
+
+static uint32_t dirty[(STORE_BANK_BLOCKS + 31) / 32];
+
+/*
+    the records written by a running save. they only replace record_addr once
+    every one of them is on flash and a checkpoint holding them is written, so
+    a save cut short by a power loss leaves the previous save in place. a bank
+    isn't swapped while a save runs
+*/
+static uint32_t pending_addr[STORE_BANK_BLOCKS];
+static uint32_t pending_seq[STORE_BANK_BLOCKS];
+static volatile uint8_t save_running;
+
+static uint16_t free_sectors;
+
+static uint16_t head_sector;
+static uint8_t head_page;
+static uint32_t next_seq_no;
+static uint8_t compacting;
+
+/*
+    the checkpoint slot and position the next checkpoint is written to
+*/
+static uint8_t checkpoint_slot;
+static uint8_t checkpoint_pos;
+static uint8_t checkpoint_page[CHECKPOINT_PAGES * STORE_PAGE_SIZE] __attribute__((aligned(32)));
+static uint8_t index_page[STORE_PAGE_SIZE] __attribute__((aligned(32)));
+
+/*
+    the blocks of a running save that haven't been written yet, and copies of
+    the ones among them that were edited after the save started
+*/
+static uint32_t snapshot[(STORE_BANK_BLOCKS + 31) / 32];
+static uint8_t cow_data[CONFIG_SAVE_COW_SLOTS][RECORD_PAYLOAD_MAX];
+static uint16_t cow_length[CONFIG_SAVE_COW_SLOTS];
+static uint16_t cow_block[CONFIG_SAVE_COW_SLOTS];
+static volatile uint8_t saving;
+static uint32_t cow_overflows;
+
+/*
+    records are built in page for a save and in move_page while a compaction
+    relocates them, as a compaction can run in the middle of a save
+*/
+static uint8_t page[RECORD_BUFFER_SIZE] __attribute__((aligned(32)));
+static uint8_t move_page[RECORD_BUFFER_SIZE] __attribute__((aligned(32)));
+
+// the head reads each sector it moves into through here, see make_room()
+static uint8_t erased_page[STORE_PAGE_SIZE] __attribute__((aligned(32)));
+
+// a request to the flash task for each page of the record being programmed
+#define PROGRAM_PAGES_MAX (RECORD_PAGES_MAX > CHECKPOINT_PAGES ? RECORD_PAGES_MAX : CHECKPOINT_PAGES)
+static flash_request_t program_requests[PROGRAM_PAGES_MAX];
+
+/*
+    held while a sequence is loaded or a sector compacted, so a record isn't
+    erased while it is being read. loads have a buffer of their own as the save
+    task keeps using page while a load runs
+*/
+static SemaphoreHandle_t store_mutex;
+static uint8_t load_page[RECORD_BUFFER_SIZE] __attribute__((aligned(32)));
+
+// sequences whose steps are in steps[]
+static uint32_t loaded[2];
+
+/*
+    the payloads of the next bank's records, read ahead of a switch by the
+    save task. stage_length is STAGE_EMPTY for a block the bank has no record
+    of and STAGE_NONE for one that didn't fit, which is read from flash when
+    it is needed. the bank stays staged after it is swapped in, until the next
+    switch, as its sequences are decoded from here as they are needed. guarded
+    by store_mutex
+*/
+#define STAGE_EMPTY 0xFFFE
+#define STAGE_NONE 0xFFFF
+
+static uint8_t stage[CONFIG_BANK_STAGE_BYTES] __attribute__((aligned(32)));
+static uint16_t stage_offset[STORE_BANK_BLOCKS];
+static uint16_t stage_length[STORE_BANK_BLOCKS];
+static uint8_t stage_bank;
+
+// the bank asked for by the menu, and the staged bank waiting for a bar
+static volatile uint8_t requested_bank;
+static volatile uint8_t ready_bank;
+
+/*
+    the sequences playing when the bank was staged, decoded and compiled by
+    the save task so the swap only has to point the play task at them. they
+    are played from here after the swap until store_load_sequence() copies
+    them into steps[]. swap_ready holds the sequences decoded for the staged
+    bank, swapped those played from a slot and swap_legacy those read from
+    the old layouts. guarded by store_mutex
+*/
+static step_t swap_steps[CONFIG_BANK_SWAP_SEQUENCES][CONFIG_STEPS_PER_SEQUENCE];
+static step_events_t swap_events[CONFIG_BANK_SWAP_SEQUENCES][CONFIG_STEPS_PER_SEQUENCE];
+static uint8_t swap_slot[CONFIG_TOTAL_SEQUENCES];
+static uint32_t swap_ready[2];
+static uint32_t swapped[2];
+static uint32_t swap_legacy[2];
+
+static uint32_t sector_addr(uint16_t s) {
+    return CONFIG_STORE_BASE_ADDR + ((uint32_t)s * STORE_SECTOR_SIZE);
+}
+
+static uint16_t addr_sector(uint32_t addr) {
+    return (addr - CONFIG_STORE_BASE_ADDR) / STORE_SECTOR_SIZE;
+}
+
+static uint32_t page_addr(uint16_t s, uint8_t p) {
+    return sector_addr(s) + ((uint32_t)p * STORE_PAGE_SIZE);
+}
+
+static uint32_t checkpoint_addr(uint8_t slot, uint8_t pos) {
+    uint32_t addr = sector_addr(CONFIG_STORE_SECTORS + slot);
+    return addr + ((uint32_t)pos * CHECKPOINT_PAGES * STORE_PAGE_SIZE);
+}
+
+static uint8_t record_pages(uint16_t length) {
+    return (sizeof(store_header_t) + length + STORE_PAGE_SIZE - 1) / STORE_PAGE_SIZE;
+}
+
+/*
+    @param b        the bank
+    @param block    index of the block within the bank
+
+    @return index of the block in record_addr
+*/
+static uint16_t bank_block(uint8_t b, uint16_t block) {
+    return ((uint16_t)b * STORE_BANK_BLOCKS) + block;
+}
+
+/*
+    @return index in record_addr of the block a record holds
+*/
+static uint16_t block_of(uint8_t type, uint16_t index) {
+    if(type == STORE_RECORD_METADATA) {
+        uint8_t b = index / STORE_METADATA_RECORDS;
+        return bank_block(b, index % STORE_METADATA_RECORDS);
+    }
+
+    uint8_t b = index / CONFIG_TOTAL_SEQUENCES;
+    return bank_block(b, STORE_METADATA_RECORDS + (index % CONFIG_TOTAL_SEQUENCES));
+}
+
+// the steps of a sequence in steps[]
+static step_t* sequence_steps(uint8_t sq_index) {
+    return &steps[(uint16_t)sq_index * CONFIG_STEPS_PER_SEQUENCE];
+}
+
+/*
+    point the index at a block's current record. the bank's index record is
+    written again by the next checkpoint
+*/
+static void set_record(uint16_t block, uint32_t addr, uint32_t seq) {
+    record_addr[block] = addr;
+    record_seq[block] = seq;
+    index_dirty |= 1UL << (block / STORE_BANK_BLOCKS);
+}
+
+static uint8_t valid_header(store_header_t* h) {
+    if(h->magic != STORE_MAGIC) {
+        return 0;
+    }
+
+    if(h->type == STORE_RECORD_METADATA) {
+        return h->version == STORE_FORMAT_VERSION
+            && h->index < (CONFIG_STORE_BANKS * STORE_METADATA_RECORDS)
+            && h->length == METADATA_PAYLOAD;
+    }
+
+    if(h->type == STORE_RECORD_SEQUENCE) {
+        return h->version == STORE_FORMAT_VERSION
+            && h->index < (CONFIG_STORE_BANKS * CONFIG_TOTAL_SEQUENCES)
+            && h->length >= OCCUPANCY_BYTES
+            && h->length <= SEQUENCE_PAYLOAD_MAX;
+    }
+
+    return 0;
+}
+
+static uint8_t valid_index_header(store_header_t* h) {
+    return h->magic == STORE_MAGIC
+        && h->type == STORE_RECORD_INDEX
+        && h->version == STORE_CHECKPOINT_VERSION
+        && h->index < CONFIG_STORE_BANKS
+        && h->length == INDEX_PAYLOAD;
+}
+
+/*
+    @return the number of pages taken by the record starting at a page, 1 for
+            anything that isn't a valid header
+*/
+static uint8_t header_pages(store_header_t* h) {
+    if(valid_header(h)) {
+        return record_pages(h->length);
+    }
+
+    return 1;
+}
+
+static uint8_t is_erased(uint8_t* data, uint16_t len) {
+    for(uint16_t i = 0; i < len; i++) {
+        if(data[i] != 0xFF) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+static uint32_t record_crc(uint8_t* record) {
+    store_header_t* h = (store_header_t*)record;
+    uint32_t crc = h->crc;
+
+    h->crc = 0;
+    uint32_t result = crc32(0, record, sizeof(store_header_t) + h->length);
+    h->crc = crc;
+
+    return result;
+}
+
+/*
+    @param sq_index     index of the sequence in sequences[]
+    @param entry        the sequence's metadata, laid out the same in records
+                        and in the old fixed layout
+*/
+static void unpack_metadata(uint8_t sq_index, uint8_t* entry) {
+    sequences[sq_index].channel = entry[0];
+    sequences[sq_index].prescale_value = entry[1];
+    memcpy(sequences[sq_index].enabled_steps, &entry[2], sizeof(sequences[sq_index].enabled_steps));
+}
+
+/*
+    encode the steps of a sequence. every note is saved wherever it sits in
+    the step, so a step caught before it is compiled loses nothing
+
+    @return the length of the payload
+*/
+static uint16_t pack_steps(uint8_t sq_index, uint8_t* payload) {
+    step_t* st = &steps[(uint16_t)sq_index * CONFIG_STEPS_PER_SEQUENCE];
+    uint16_t pos = OCCUPANCY_BYTES;
+
+    memset(payload, 0, OCCUPANCY_BYTES);
+
+    for(uint8_t i = 0; i < CONFIG_STEPS_PER_SEQUENCE; i++, st++) {
+        uint16_t count = pos++;
+        uint8_t note_offs = 0;
+        uint8_t note_ons = 0;
+
+        for(uint8_t n = 0; n < CONFIG_MAX_POLYPHONY; n++) {
+            if(st->note_off[n]) {
+                payload[pos++] = (uint8_t)st->note_off[n];
+                note_offs++;
+            }
+        }
+
+        for(uint8_t n = 0; n < CONFIG_MAX_POLYPHONY; n++) {
+            if(st->note_on[n].note) {
+                payload[pos++] = (uint8_t)st->note_on[n].note;
+                payload[pos++] = st->note_on[n].velocity;
+                note_ons++;
+            }
+        }
+
+        if(note_offs || note_ons) {
+            payload[count] = (note_offs << 4) | note_ons;
+            payload[i / 8] |= 1 << (i % 8);
+        } else {
+            pos = count;
+        }
+    }
+
+    return pos;
+}
+
+/*
+    decode the steps of a sequence
+
+    @param st   where the CONFIG_STEPS_PER_SEQUENCE steps are written
+
+    @return 0 if the payload doesn't hold the steps its bitmap says it does
+*/
+static uint8_t unpack_steps(step_t* st, uint8_t* payload, uint16_t length) {
+    uint16_t pos = OCCUPANCY_BYTES;
+
+    memset(st, 0, sizeof(step_t) * CONFIG_STEPS_PER_SEQUENCE);
+
+    for(uint8_t i = 0; i < CONFIG_STEPS_PER_SEQUENCE; i++, st++) {
+        if(!(payload[i / 8] & (1 << (i % 8)))) {
+            continue;
+        }
+
+        if(pos >= length) {
+            return 0;
+        }
+
+        uint8_t note_offs = payload[pos] >> 4;
+        uint8_t note_ons = payload[pos] & 0x0F;
+        pos++;
+
+        if(note_offs > CONFIG_MAX_POLYPHONY || note_ons > CONFIG_MAX_POLYPHONY) {
+            return 0;
+        }
+
+        if(pos + note_offs + (2 * note_ons) > length) {
+            return 0;
+        }
+
+        for(uint8_t n = 0; n < note_offs; n++) {
+            st->note_off[n] = payload[pos++];
+        }
+
+        for(uint8_t n = 0; n < note_ons; n++) {
+            st->note_on[n].note = payload[pos++];
+            st->note_on[n].velocity = payload[pos++];
+        }
+    }
+
+    return pos == length;
+}
+
+/*
+    @param block    index of the block within the working set
+
+    @return the length of the payload
+*/
+static uint16_t pack_block(uint16_t block, uint8_t* payload) {
+    if(block >= STORE_METADATA_RECORDS) {
+        return pack_steps(block - STORE_METADATA_RECORDS, payload);
+    }
+
+    for(uint8_t i = 0; i < STORE_SEQS_PER_RECORD; i++) {
+        uint8_t sq = (block * STORE_SEQS_PER_RECORD) + i;
+        uint8_t* tx = &payload[i * METADATA_ENTRY];
+
+        tx[0] = (uint8_t)sequences[sq].channel;
+        tx[1] = (uint8_t)sequences[sq].prescale_value;
+        memcpy(&tx[2], sequences[sq].enabled_steps, sizeof(sequences[sq].enabled_steps));
+    }
+
+    return METADATA_PAYLOAD;
+}
+
+/*
+    reset the metadata of a block of sequences, for a bank with no record of it
+*/
+static void clear_metadata(uint16_t block) {
+    uint8_t entry[METADATA_ENTRY] = {0};
+
+    for(uint8_t i = 0; i < STORE_SEQS_PER_RECORD; i++) {
+        unpack_metadata((block * STORE_SEQS_PER_RECORD) + i, entry);
+    }
+}
+
+static uint8_t unpack_block(uint16_t block, uint8_t* payload, uint16_t length) {
+    if(block >= STORE_METADATA_RECORDS) {
+        return unpack_steps(sequence_steps(block - STORE_METADATA_RECORDS), payload, length);
+    }
+
+    for(uint8_t i = 0; i < STORE_SEQS_PER_RECORD; i++) {
+        uint8_t sq = (block * STORE_SEQS_PER_RECORD) + i;
+        unpack_metadata(sq, &payload[i * METADATA_ENTRY]);
+    }
+
+    return 1;
+}
+
+/*
+    the dirty bits are set from the editors and before the scheduler is started
+    by store_load(), so they are guarded by masking interrupts rather than
+    with taskENTER_CRITICAL
+*/
+static uint32_t dirty_lock() {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    return primask;
+}
+
+static void dirty_unlock(uint32_t primask) {
+    __set_PRIMASK(primask);
+}
+
+static void mark_block(uint16_t block) {
+    uint32_t primask = dirty_lock();
+    dirty[block / 32] |= (1UL << (block % 32));
+    dirty_unlock(primask);
+}
+
+static void clear_block(uint16_t block) {
+    uint32_t primask = dirty_lock();
+    dirty[block / 32] &= ~(1UL << (block % 32));
+    dirty_unlock(primask);
+}
+
+/*
+    program a run of pages, only ever called from the save task. every page
+    but the last is queued for the flash task without waiting, writes are
+    carried out in the order they are queued so once the last is done they
+    all are
+
+    @param addr     address of the first page
+    @param buf      the data, a page for each
+    @param pages    number of pages
+*/
+static void program_pages(uint32_t addr, uint8_t* buf, uint8_t pages) {
+    for(uint8_t p = 0; p < pages; p++) {
+        flash_request_t* r = &program_requests[p];
+        uint32_t offset = (uint32_t)p * STORE_PAGE_SIZE;
+
+        r->op = FLASH_OP_PROGRAM;
+        r->addr = addr + offset;
+        r->tx = &buf[offset];
+        r->len = STORE_PAGE_SIZE;
+        r->callback = NULL;
+        r->done = NULL;
+
+        if(p == pages - 1) {
+            flash_run(r);
+        } else {
+            flash_submit(r);
+        }
+    }
+}
+
+static uint8_t compact_sector(uint16_t s);
+
+/*
+    reclaim the oldest sectors until there are a number of erased sectors ahead
+    of the head. the erased sectors always directly follow the head, so the
+    oldest sector is the one after them
+
+    a compaction frees its sector but the records it moves can fill most of
+    another, so with the log full of current records the tail only goes round
+    and round. once a whole pass of the log has gone by without the free count
+    going up it is given up on
+
+    @return 1 if the target was reached
+*/
+static uint8_t reclaim(uint16_t target) {
+    if(compacting) {
+        return free_sectors >= target;
+    }
+
+    compacting = 1;
+
+    uint16_t most = free_sectors;
+    uint16_t passed = 0;
+
+    while(free_sectors < target && passed < CONFIG_STORE_SECTORS) {
+        uint16_t tail = (head_sector + free_sectors + 1) % CONFIG_STORE_SECTORS;
+
+        if(tail == head_sector || !compact_sector(tail)) {
+            break;
+        }
+
+        if(free_sectors > most) {
+            most = free_sectors;
+            passed = 0;
+        } else {
+            passed++;
+        }
+    }
+
+    compacting = 0;
+
+    return free_sectors >= target;
+}
+
+/*
+    move the head on to the first of the free sectors
+*/
+static void next_sector() {
+    head_sector = (head_sector + 1) % CONFIG_STORE_SECTORS;
+    head_page = 0;
+    free_sectors--;
+
+    /*
+        an erase cut short by a power loss can leave the start of its sector
+        erased and the rest not. the first header reads erased so the sector
+        is counted free, and programming over the rest would corrupt the
+        records written there. the sector is erased again if any of it isn't
+    */
+    for(uint8_t p = 0; p < STORE_PAGES_PER_SECTOR; p++) {
+        flash_fastRead(page_addr(head_sector, p), erased_page, STORE_PAGE_SIZE);
+
+        if(!is_erased(erased_page, STORE_PAGE_SIZE)) {
+            flash_eraseSector(sector_addr(head_sector));
+            break;
+        }
+    }
+}
+
+/*
+    make sure the head has enough erased pages for a record. a record never
+    crosses into the next sector, any pages left at the end of the head are
+    skipped. the records moved by a compaction came from one sector so they
+    always fit in the erased sector that follows, this never nests
+
+    @param pages    number of pages the record takes
+
+    @return 0 if the store is full
+*/
+static uint8_t make_room(uint8_t pages) {
+    if(head_page + pages <= STORE_PAGES_PER_SECTOR) {
+        return 1;
+    }
+
+    reclaim(STORE_MIN_FREE_SECTORS);
+
+    // a save leaves the last sectors to the compactions that free the rest
+    if(free_sectors < (compacting ? 1 : STORE_MIN_FREE_SECTORS)) {
+        return 0;
+    }
+
+    next_sector();
+
+    return 1;
+}
+
+/*
+    write a record to the head of the log, one full page program at a time.
+    the payload follows the header in buf, the type, version, index and
+    length of the header are filled in by the caller and the rest here
+
+    @param buf      a buffer of the record's pages holding the payload
+
+    @return the address of the record
+*/
+static uint32_t append(uint8_t* buf) {
+    store_header_t* h = (store_header_t*)buf;
+    uint8_t pages = record_pages(h->length);
+
+    h->magic = STORE_MAGIC;
+    h->seq_no = next_seq_no++;
+    h->crc = 0;
+    h->crc = record_crc(buf);
+
+    uint16_t end = sizeof(store_header_t) + h->length;
+    memset(&buf[end], 0xFF, ((uint16_t)pages * STORE_PAGE_SIZE) - end);
+
+    uint32_t addr = sector_addr(head_sector) + ((uint32_t)head_page * STORE_PAGE_SIZE);
+
+    program_pages(addr, buf, pages);
+
+    head_page += pages;
+
+    return addr;
+}
+
+/*
+    write a record for a block to the head of the log. make_room() must have
+    been called first
+
+    @param buf      a RECORD_BUFFER_SIZE buffer holding the payload
+    @param block    index of the block in record_addr
+    @param length   number of payload bytes
+
+    @return the address of the record
+*/
+static uint32_t append_record(uint8_t* buf, uint16_t block, uint16_t length) {
+    store_header_t* h = (store_header_t*)buf;
+    uint8_t b = block / STORE_BANK_BLOCKS;
+    uint16_t i = block % STORE_BANK_BLOCKS;
+
+    h->version = STORE_FORMAT_VERSION;
+    h->length = length;
+
+    if(i < STORE_METADATA_RECORDS) {
+        h->type = STORE_RECORD_METADATA;
+        h->index = ((uint16_t)b * STORE_METADATA_RECORDS) + i;
+    } else {
+        h->type = STORE_RECORD_SEQUENCE;
+        h->index = ((uint16_t)b * CONFIG_TOTAL_SEQUENCES) + (i - STORE_METADATA_RECORDS);
+    }
+
+    return append(buf);
+}
+
+/*
+    read a whole record into buf. only the first page is read before the
+    header says how long the record is
+
+    @return 0 if the header isn't valid or the record fails its crc check
+*/
+static uint8_t fetch_record(uint32_t addr, uint8_t* buf) {
+    store_header_t* h = (store_header_t*)buf;
+
+    flash_fastRead(addr, buf, STORE_PAGE_SIZE);
+
+    if(!valid_header(h)) {
+        return 0;
+    }
+
+    uint16_t len = sizeof(store_header_t) + h->length;
+
+    if(len > STORE_PAGE_SIZE) {
+        flash_fastRead(addr + STORE_PAGE_SIZE, &buf[STORE_PAGE_SIZE], len - STORE_PAGE_SIZE);
+    }
+
+    return record_crc(buf) == h->crc;
+}
+
+/*
+    look through the whole log for the newest record of a block that is older
+    than a record that failed its crc check
+
+    @param buf  a RECORD_BUFFER_SIZE buffer the candidates are checked in
+
+    @return the record's address, or STORE_NO_RECORD
+*/
+static uint32_t find_older_record(uint16_t block, uint32_t below_seq, uint8_t* buf) {
+    uint32_t best = STORE_NO_RECORD;
+    uint32_t best_seq = 0;
+    store_header_t h;
+
+    for(uint16_t s = 0; s < CONFIG_STORE_SECTORS; s++) {
+        for(uint8_t p = 0; p < STORE_PAGES_PER_SECTOR; p += header_pages(&h)) {
+            uint32_t addr = page_addr(s, p);
+
+            flash_SPIRead(addr, (uint8_t*)&h, (uint8_t*)&h, sizeof(h));
+
+            if(is_erased((uint8_t*)&h, sizeof(h))) {
+                break;
+            }
+
+            if(!valid_header(&h) || block_of(h.type, h.index) != block) {
+                continue;
+            }
+
+            if(h.seq_no < below_seq && (best == STORE_NO_RECORD || h.seq_no > best_seq)) {
+                if(fetch_record(addr, buf)) {
+                    best = addr;
+                    best_seq = h.seq_no;
+                }
+            }
+        }
+    }
+
+    return best;
+}
+
+/*
+    read the current record of a block into buf, falling back to older records
+    if it fails its crc check. must be called with store_mutex held, or before
+    the scheduler is started
+
+    @return 0 if no good record of the block is left in the log
+*/
+static uint8_t read_record(uint16_t block, uint8_t* buf) {
+    store_header_t* h = (store_header_t*)buf;
+
+    while(record_addr[block] != STORE_NO_RECORD) {
+        if(fetch_record(record_addr[block], buf)) {
+            record_seq[block] = h->seq_no;
+            return 1;
+        }
+
+        // a record cut short by a power loss, fall back to the one before
+        set_record(block, find_older_record(block, record_seq[block], buf), record_seq[block]);
+
+        if(record_addr[block] != STORE_NO_RECORD) {
+            fetch_record(record_addr[block], buf);
+            record_seq[block] = h->seq_no;
+        }
+    }
+
+    return 0;
+}
+
+/*
+    append the index record of a bank, the page its current record of each
+    block starts on. a bank with no records has no index record. these are
+    part of committing records already written, so they take the free sectors
+    a save leaves without reclaiming any
+
+    @return 0 if there was no room for it
+*/
+static uint8_t write_index(uint8_t b) {
+    store_header_t* h = (store_header_t*)index_page;
+    uint16_t* record_page = (uint16_t*)&index_page[sizeof(store_header_t)];
+    uint8_t any = 0;
+
+    for(uint16_t i = 0; i < STORE_BANK_BLOCKS; i++) {
+        uint32_t addr = record_addr[bank_block(b, i)];
+
+        record_page[i] = STORE_NO_PAGE;
+
+        if(addr != STORE_NO_RECORD) {
+            record_page[i] = (addr - CONFIG_STORE_BASE_ADDR) / STORE_PAGE_SIZE;
+            any = 1;
+        }
+    }
+
+    if(!any) {
+        index_addr[b] = STORE_NO_RECORD;
+        return 1;
+    }
+
+    if(head_page >= STORE_PAGES_PER_SECTOR) {
+        if(free_sectors == 0) {
+            return 0;
+        }
+
+        next_sector();
+    }
+
+    h->type = STORE_RECORD_INDEX;
+    h->version = STORE_CHECKPOINT_VERSION;
+    h->index = b;
+    h->length = INDEX_PAYLOAD;
+
+    index_addr[b] = append(index_page);
+
+    return 1;
+}
+
+/*
+    write the index record of every bank whose records moved, then the
+    position of the head and where the index records are to the next
+    checkpoint position. a slot is only erased once the other holds a
+    checkpoint, so a power loss during the write leaves the previous
+    checkpoint to boot from. each slot holds CHECKPOINTS_PER_SLOT checkpoints
+    between erases to spread the wear
+
+    @return 0 if there was no room for the index records, nothing is
+            committed
+*/
+static uint8_t write_checkpoint() {
+    for(uint8_t b = 0; b < CONFIG_STORE_BANKS; b++) {
+        if((index_dirty & (1UL << b)) && !write_index(b)) {
+            return 0;
+        }
+    }
+
+    if(checkpoint_pos >= CHECKPOINTS_PER_SLOT) {
+        checkpoint_slot ^= 1;
+        checkpoint_pos = 0;
+        flash_eraseSector(checkpoint_addr(checkpoint_slot, 0));
+    }
+
+    store_header_t* h = (store_header_t*)checkpoint_page;
+    store_checkpoint_t* cp = (store_checkpoint_t*)&checkpoint_page[sizeof(store_header_t)];
+
+    memset(checkpoint_page, 0xFF, sizeof(checkpoint_page));
+
+    cp->head_sector = head_sector;
+    cp->head_page = head_page;
+    cp->bank = bank;
+    cp->free_sectors = free_sectors;
+    cp->next_seq_no = next_seq_no + 1;
+
+    for(uint8_t b = 0; b < CONFIG_STORE_BANKS; b++) {
+        cp->index_page[b] = STORE_NO_PAGE;
+
+        if(index_addr[b] != STORE_NO_RECORD) {
+            cp->index_page[b] = (index_addr[b] - CONFIG_STORE_BASE_ADDR) / STORE_PAGE_SIZE;
+        }
+    }
+
+    h->magic = STORE_MAGIC;
+    h->type = STORE_RECORD_CHECKPOINT;
+    h->version = STORE_CHECKPOINT_VERSION;
+    h->index = 0;
+    h->length = sizeof(store_checkpoint_t);
+    h->seq_no = next_seq_no++;
+    h->crc = 0;
+    h->crc = record_crc(checkpoint_page);
+
+    program_pages(checkpoint_addr(checkpoint_slot, checkpoint_pos), checkpoint_page, CHECKPOINT_PAGES);
+
+    checkpoint_pos++;
+    index_dirty = 0;
+
+    return 1;
+}
+
+/*
+    copy the records that are still current out of a sector and erase it. a
+    checkpoint with their new addresses is written before the erase, so a
+    power loss never leaves the checkpoint pointing at an erased record. the
+    store mutex is held while the records are moved so a sequence being loaded
+    can't have its record erased from under it
+
+    @return 0 if there was no room to move the records or their index records
+            to, the sector is left as it was
+*/
+static uint8_t compact_sector(uint16_t s) {
+    store_header_t h;
+
+    flash_SPIRead(page_addr(s, 0), (uint8_t*)&h, (uint8_t*)&h, sizeof(h));
+
+    // a sector left erased by a power loss after its erase, it is free already
+    if(is_erased((uint8_t*)&h, sizeof(h))) {
+        free_sectors++;
+        return 1;
+    }
+
+    xSemaphoreTake(store_mutex, portMAX_DELAY);
+
+    for(uint8_t p = 0; p < STORE_PAGES_PER_SECTOR; p += header_pages(&h)) {
+        uint32_t addr = page_addr(s, p);
+
+        flash_SPIRead(addr, (uint8_t*)&h, (uint8_t*)&h, sizeof(h));
+
+        if(is_erased((uint8_t*)&h, sizeof(h))) {
+            break;
+        }
+
+        // a current index record is written again by the checkpoint
+        if(valid_index_header(&h) && index_addr[h.index] == addr) {
+            index_dirty |= 1UL << h.index;
+            continue;
+        }
+
+        if(!valid_header(&h)) {
+            continue;
+        }
+
+        uint16_t block = block_of(h.type, h.index);
+        uint16_t local = block % STORE_BANK_BLOCKS;
+
+        if(block / STORE_BANK_BLOCKS == bank && pending_addr[local] == addr) {
+            // a record of the running save, it stays uncommitted
+            if(fetch_record(addr, move_page)) {
+                if(!make_room(record_pages(h.length))) {
+                    xSemaphoreGive(store_mutex);
+                    return 0;
+                }
+
+                pending_addr[local] = append_record(move_page, block, h.length);
+                pending_seq[local] = ((store_header_t*)move_page)->seq_no;
+            } else {
+                pending_addr[local] = STORE_NO_RECORD;
+                mark_block(local);
+            }
+
+            continue;
+        }
+
+        if(record_addr[block] != addr) {
+            continue;
+        }
+
+        /*
+            a damaged record isn't copied, the good record it falls back on is
+            copied instead if that is in this sector too
+        */
+        if(read_record(block, move_page) && addr_sector(record_addr[block]) == s) {
+            uint16_t length = ((store_header_t*)move_page)->length;
+
+            if(!make_room(record_pages(length))) {
+                xSemaphoreGive(store_mutex);
+                return 0;
+            }
+
+            uint32_t moved = append_record(move_page, block, length);
+            set_record(block, moved, ((store_header_t*)move_page)->seq_no);
+        }
+    }
+
+    if(!write_checkpoint()) {
+        xSemaphoreGive(store_mutex);
+        return 0;
+    }
+
+    xSemaphoreGive(store_mutex);
+
+    /*
+        nothing indexes the sector once the checkpoint is written, so loads
+        carry on while it is erased. the flash task suspends the erase to
+        serve their reads
+    */
+    flash_eraseSector(sector_addr(s));
+
+    free_sectors++;
+
+    return 1;
+}
+
+/*
+    fill in the metadata blocks the log doesn't hold a record of. the old fixed
+    layout is read for every sequence in one transfer, and the blocks are
+    marked to be moved into the log by the next save. the old layout only ever
+    held bank 0
+*/
+static void load_legacy_metadata() {
+    static uint8_t metadata[CONFIG_TOTAL_SEQUENCES * CONFIG_METADATA_BYTES_PER_SEQ] __attribute__((aligned(32)));
+    uint8_t read = 0;
+
+    for(uint16_t b = 0; b < STORE_METADATA_RECORDS; b++) {
+        if(record_addr[b] != STORE_NO_RECORD) {
+            continue;
+        }
+
+        if(!read) {
+            flash_fastRead(CONFIG_METADATA_BASE_ADDR, metadata, sizeof(metadata));
+            read = 1;
+        }
+
+        uint8_t first = b * STORE_SEQS_PER_RECORD;
+
+        for(uint8_t sq = first; sq < first + STORE_SEQS_PER_RECORD; sq++) {
+            unpack_metadata(sq, &metadata[sq * CONFIG_METADATA_BYTES_PER_SEQ]);
+        }
+
+        mark_block(b);
+    }
+}
+
+/*
+    read the steps of a sequence of bank 0 the log doesn't hold from the old
+    fixed layout
+
+    @param dst  where the CONFIG_STEPS_PER_SEQUENCE steps are written
+*/
+static void load_legacy_steps(uint8_t sq_index, step_t* dst) {
+    uint16_t st = (uint16_t)sq_index * CONFIG_STEPS_PER_SEQUENCE;
+    uint32_t addr = CONFIG_STEPS_BASE_ADDR + ((uint32_t)st * sizeof(step_t));
+
+    flash_fastRead(addr, load_page, CONFIG_STEPS_PER_SEQUENCE * sizeof(step_t));
+    memcpy(dst, load_page, CONFIG_STEPS_PER_SEQUENCE * sizeof(step_t));
+}
+
+/*
+    rebuild the record index by reading the header of every record in the log.
+    this is only needed when there is no good checkpoint, the first time the
+    log is used or after both checkpoints are lost. a save cut short can't be
+    told apart here, its records are taken as current
+*/
+static void scan_log() {
+    store_header_t h;
+    uint32_t newest = 0;
+    uint8_t found = 0;
+
+    /*
+        records are only read by header here, the pages a record's payload
+        runs on to are skipped. records are written in order so the first
+        erased page ends a sector
+    */
+    for(uint16_t s = 0; s < CONFIG_STORE_SECTORS; s++) {
+        uint8_t used = 0;
+
+        for(uint8_t p = 0; p < STORE_PAGES_PER_SECTOR; p += header_pages(&h)) {
+            uint32_t addr = page_addr(s, p);
+
+            flash_SPIRead(addr, (uint8_t*)&h, (uint8_t*)&h, sizeof(h));
+
+            if(is_erased((uint8_t*)&h, sizeof(h))) {
+                break;
+            }
+
+            used = p + header_pages(&h);
+
+            if(valid_header(&h)) {
+                uint16_t block = block_of(h.type, h.index);
+
+                if(record_addr[block] == STORE_NO_RECORD || h.seq_no > record_seq[block]) {
+                    record_addr[block] = addr;
+                    record_seq[block] = h.seq_no;
+                }
+            } else if(!valid_index_header(&h)) {
+                continue;
+            }
+
+            if(!found || h.seq_no >= newest) {
+                newest = h.seq_no;
+                head_sector = s;
+                found = 1;
+            }
+        }
+
+        if(used > STORE_PAGES_PER_SECTOR) {
+            used = STORE_PAGES_PER_SECTOR;
+        }
+
+        if(used == 0) {
+            free_sectors++;
+        }
+
+        if(found && head_sector == s) {
+            head_page = used;
+        }
+    }
+
+    if(found) {
+        next_seq_no = newest + 1;
+    } else {
+        /*
+            an empty log. the head starts on sector 0 which is taken out of the
+            free count as it is written to directly
+        */
+        free_sectors--;
+    }
+
+    // the first checkpoint erases a slot, whatever is left in them, and indexes every bank
+    checkpoint_slot = 1;
+    checkpoint_pos = CHECKPOINTS_PER_SLOT;
+    index_dirty = 0xFFFFFFFF >> (32 - CONFIG_STORE_BANKS);
+}
+
+static uint8_t valid_checkpoint_header(store_header_t* h) {
+    return h->magic == STORE_MAGIC
+        && h->type == STORE_RECORD_CHECKPOINT
+        && h->version == STORE_CHECKPOINT_VERSION
+        && h->length == sizeof(store_checkpoint_t);
+}
+
+/*
+    restore the record index from the index records a checkpoint points at
+
+    @return 0 if one of them fails its crc check
+*/
+static uint8_t load_indexes(store_checkpoint_t* cp) {
+    store_header_t* h = (store_header_t*)index_page;
+    uint16_t* record_page = (uint16_t*)&index_page[sizeof(store_header_t)];
+
+    for(uint8_t b = 0; b < CONFIG_STORE_BANKS; b++) {
+        index_addr[b] = STORE_NO_RECORD;
+
+        for(uint16_t i = 0; i < STORE_BANK_BLOCKS; i++) {
+            record_addr[bank_block(b, i)] = STORE_NO_RECORD;
+        }
+
+        if(cp->index_page[b] == STORE_NO_PAGE) {
+            continue;
+        }
+
+        index_addr[b] = CONFIG_STORE_BASE_ADDR + ((uint32_t)cp->index_page[b] * STORE_PAGE_SIZE);
+        flash_fastRead(index_addr[b], index_page, STORE_PAGE_SIZE);
+
+        if(!valid_index_header(h) || h->index != b || record_crc(index_page) != h->crc) {
+            return 0;
+        }
+
+        for(uint16_t i = 0; i < STORE_BANK_BLOCKS; i++) {
+            if(record_page[i] != STORE_NO_PAGE) {
+                record_addr[bank_block(b, i)] = CONFIG_STORE_BASE_ADDR + ((uint32_t)record_page[i] * STORE_PAGE_SIZE);
+                record_seq[bank_block(b, i)] = cp->next_seq_no;
+            }
+        }
+    }
+
+    return 1;
+}
+
+/*
+    find the newest checkpoint that passes its crc check and restore the record
+    index and the head from it. only the headers of the checkpoint slots and an
+    index record for each bank are read, so this takes the same time however
+    full the log is
+
+    @return 0 if neither slot holds a good checkpoint
+*/
+static uint8_t load_checkpoint() {
+    store_header_t* h = (store_header_t*)checkpoint_page;
+    store_checkpoint_t* cp = (store_checkpoint_t*)&checkpoint_page[sizeof(store_header_t)];
+    uint8_t next_pos[2];
+    uint8_t best_slot = 0;
+    uint32_t below = 0xFFFFFFFF;
+
+    while(1) {
+        uint32_t best = STORE_NO_RECORD;
+        uint32_t best_seq = 0;
+
+        for(uint8_t slot = 0; slot < 2; slot++) {
+            next_pos[slot] = CHECKPOINTS_PER_SLOT;
+
+            for(uint8_t pos = 0; pos < CHECKPOINTS_PER_SLOT; pos++) {
+                uint32_t addr = checkpoint_addr(slot, pos);
+                store_header_t ch;
+
+                flash_SPIRead(addr, (uint8_t*)&ch, (uint8_t*)&ch, sizeof(ch));
+
+                if(is_erased((uint8_t*)&ch, sizeof(ch))) {
+                    next_pos[slot] = pos;
+                    break;
+                }
+
+                if(!valid_checkpoint_header(&ch) || ch.seq_no >= below) {
+                    continue;
+                }
+
+                if(best == STORE_NO_RECORD || ch.seq_no > best_seq) {
+                    best = addr;
+                    best_seq = ch.seq_no;
+                    best_slot = slot;
+                }
+            }
+        }
+
+        if(best == STORE_NO_RECORD) {
+            return 0;
+        }
+
+        flash_fastRead(best, checkpoint_page, sizeof(checkpoint_page));
+
+        if(record_crc(checkpoint_page) == h->crc && load_indexes(cp)) {
+            break;
+        }
+
+        // a checkpoint cut short by a power loss, try the one before it
+        below = best_seq;
+    }
+
+    head_sector = cp->head_sector;
+    head_page = cp->head_page;
+    free_sectors = cp->free_sectors;
+    next_seq_no = cp->next_seq_no;
+
+    if(cp->bank < CONFIG_STORE_BANKS) {
+        bank = cp->bank;
+    }
+
+    // the next checkpoint follows this one, past any cut short after it
+    checkpoint_slot = best_slot;
+    checkpoint_pos = next_pos[best_slot];
+
+    return 1;
+}
+
+/*
+    step the head past anything written after the checkpoint was, the records
+    of a save that never committed and any a compaction moved before it was
+    cut short. the pages they take can't be programmed again until erased
+*/
+static void skip_uncommitted() {
+    store_header_t h;
+
+    while(1) {
+        if(head_page < STORE_PAGES_PER_SECTOR) {
+            flash_SPIRead(page_addr(head_sector, head_page), (uint8_t*)&h, (uint8_t*)&h, sizeof(h));
+
+            if(!is_erased((uint8_t*)&h, sizeof(h))) {
+                if(valid_header(&h) && h.seq_no >= next_seq_no) {
+                    next_seq_no = h.seq_no + 1;
+                }
+
+                head_page += header_pages(&h);
+                continue;
+            }
+        }
+
+        // the rest of the head may have been skipped for a record that didn't fit
+        if(free_sectors == 0) {
+            break;
+        }
+
+        uint16_t next = (head_sector + 1) % CONFIG_STORE_SECTORS;
+
+        flash_SPIRead(page_addr(next, 0), (uint8_t*)&h, (uint8_t*)&h, sizeof(h));
+
+        if(is_erased((uint8_t*)&h, sizeof(h))) {
+            break;
+        }
+
+        head_sector = next;
+        head_page = 0;
+        free_sectors--;
+    }
+
+    if(head_page > STORE_PAGES_PER_SECTOR) {
+        head_page = STORE_PAGES_PER_SECTOR;
+    }
+}
+
+/*
+    restore the record index from the newest checkpoint, or rebuild it from the
+    log when there isn't one, and load the metadata of every sequence. the
+    steps are left on flash, they are loaded a sequence at a time by
+    store_load_sequence() as they are needed
+*/
+void store_load() {
+    store_mutex = xSemaphoreCreateMutex();
+
+    for(uint16_t b = 0; b < STORE_RECORDS; b++) {
+        record_addr[b] = STORE_NO_RECORD;
+        record_seq[b] = 0;
+    }
+
+    for(uint8_t b = 0; b < CONFIG_STORE_BANKS; b++) {
+        index_addr[b] = STORE_NO_RECORD;
+    }
+
+    for(uint16_t b = 0; b < STORE_BANK_BLOCKS; b++) {
+        pending_addr[b] = STORE_NO_RECORD;
+    }
+
+    for(uint8_t i = 0; i < CONFIG_SAVE_COW_SLOTS; i++) {
+        cow_block[i] = STORE_NO_BLOCK;
+    }
+
+    memset(loaded, 0, sizeof(loaded));
+    memset(dirty, 0, sizeof(dirty));
+
+    head_sector = 0;
+    head_page = 0;
+    next_seq_no = 0;
+    free_sectors = 0;
+    index_dirty = 0;
+    bank = 0;
+    stage_bank = STORE_NO_BANK;
+    requested_bank = STORE_NO_BANK;
+    ready_bank = STORE_NO_BANK;
+
+    uint8_t checkpoint = load_checkpoint();
+
+    if(checkpoint) {
+        skip_uncommitted();
+    } else {
+        scan_log();
+    }
+
+    for(uint16_t b = 0; b < STORE_METADATA_RECORDS; b++) {
+        if(read_record(bank_block(bank, b), load_page)) {
+            unpack_block(b, &load_page[sizeof(store_header_t)], METADATA_PAYLOAD);
+        } else if(bank != 0) {
+            clear_metadata(b);
+        }
+    }
+
+    if(bank == 0) {
+        load_legacy_metadata();
+    }
+
+    #ifdef CONFIG_DEBUG_PRINT
+        char s[11];
+        uint8_t len;
+
+        if(checkpoint) {
+            send_uart(USART3, "checkpoint ", 11);
+        } else {
+            send_uart(USART3, "full scan ", 10);
+        }
+
+        send_uart(USART3, "bank ", 5);
+        len = u32_to_str(bank, s);
+        send_uart(USART3, s, len);
+        send_uart(USART3, " log head ", 10);
+        len = u32_to_str(head_sector, s);
+        send_uart(USART3, s, len);
+        send_uart(USART3, " free sectors ", 14);
+        len = u32_to_str(free_sectors, s);
+        send_uart(USART3, s, len);
+        send_uart(USART3, "\n\r", 2);
+    #endif
+}
+
+/*
+    decode the steps of a sequence of the working set from the stage, if the
+    stage holds the bank. must be called with store_mutex held
+
+    @return 0 if the sequence has to be read from flash
+*/
+static uint8_t unstage_steps(uint8_t sq_index) {
+    uint16_t block = STORE_METADATA_RECORDS + sq_index;
+    uint16_t length = stage_length[block];
+
+    if(stage_bank != bank || length == STAGE_NONE) {
+        return 0;
+    }
+
+    if(length == STAGE_EMPTY) {
+        // bank 0 may still hold the sequence in the old fixed layout
+        if(bank == 0) {
+            return 0;
+        }
+
+        memset(&steps[(uint16_t)sq_index * CONFIG_STEPS_PER_SEQUENCE], 0, sizeof(step_t) * CONFIG_STEPS_PER_SEQUENCE);
+        return 1;
+    }
+
+    return unpack_steps(sequence_steps(sq_index), &stage[stage_offset[block]], length);
+}
+
+/*
+    copy a sequence the play task is playing from a swap slot into steps[]
+    and play it from there. must be called with store_mutex held
+*/
+static void unswap(uint8_t sq_index) {
+    uint8_t slot = swap_slot[sq_index];
+    uint8_t w = sq_index / 32;
+    uint32_t bit = 1UL << (sq_index % 32);
+
+    adopt_steps(sq_index, swap_steps[slot], swap_events[slot]);
+
+    // steps read from the old layouts are moved into the log by the next save
+    if(swap_legacy[w] & bit) {
+        mark_block(STORE_METADATA_RECORDS + sq_index);
+    }
+
+    uint32_t primask = dirty_lock();
+    swapped[w] &= ~bit;
+    loaded[w] |= bit;
+    dirty_unlock(primask);
+}
+
+/*
+    read the steps of a sequence from flash, or the stage, into steps[] and
+    compile them, if that hasn't been done already. a sequence of bank 0 the
+    log doesn't hold is read from the old fixed layout and marked to be moved
+    into the log by the next save
+
+    every editor calls this before it changes a sequence. a bank swap leaves
+    steps[] holding the old bank until each sequence is loaded, and an edit
+    made there would be loaded over and lost
+
+    @param sq_index     index of the sequence in sequences[]
+*/
+void store_load_sequence(uint8_t sq_index) {
+    uint8_t w = sq_index / 32;
+    uint32_t bit = 1UL << (sq_index % 32);
+
+    if(loaded[w] & bit) {
+        return;
+    }
+
+    xSemaphoreTake(store_mutex, portMAX_DELAY);
+
+    // another task may have loaded it while this one waited
+    if(loaded[w] & bit) {
+        xSemaphoreGive(store_mutex);
+        return;
+    }
+
+    if(swapped[w] & bit) {
+        unswap(sq_index);
+        xSemaphoreGive(store_mutex);
+        return;
+    }
+
+    uint16_t block = STORE_METADATA_RECORDS + sq_index;
+    uint8_t current = unstage_steps(sq_index);
+
+    if(!current && read_record(bank_block(bank, block), load_page)) {
+        uint16_t length = ((store_header_t*)load_page)->length;
+        current = unpack_steps(sequence_steps(sq_index), &load_page[sizeof(store_header_t)], length);
+    }
+
+    if(!current && bank == 0) {
+        load_legacy_steps(sq_index, sequence_steps(sq_index));
+    } else if(!current) {
+        // a bank with no record of the sequence starts it empty
+        memset(&steps[(uint16_t)sq_index * CONFIG_STEPS_PER_SEQUENCE], 0, sizeof(step_t) * CONFIG_STEPS_PER_SEQUENCE);
+        current = 1;
+    }
+
+    compile_sequence(sq_index);
+
+    // compiling marks the steps as changed, only the old fixed layout needs saving
+    if(current) {
+        clear_block(block);
+    }
+
+    uint32_t primask = dirty_lock();
+    loaded[w] |= bit;
+    dirty_unlock(primask);
+
+    xSemaphoreGive(store_mutex);
+}
+
+/*
+    @param w    which word of the mask, sequences 0 - 31 or 32 - 63
+
+    @return a mask of the sequences whose steps have been loaded, or are
+            played from a swap slot
+*/
+uint32_t store_loaded_mask(uint8_t w) {
+    return loaded[w] | swapped[w];
+}
+
+void store_mark_step(uint16_t st_index) {
+    mark_block(STORE_METADATA_RECORDS + (st_index / CONFIG_STEPS_PER_SEQUENCE));
+}
+
+void store_mark_metadata(uint8_t sq_index) {
+    mark_block(sq_index / STORE_SEQS_PER_RECORD);
+}
+
+/*
+    called by the editors before they change a block. if the block is part of
+    a save that hasn't reached it yet, its contents are copied into a free slot
+    first so the save still writes the block as it was when the save started.
+    this never waits, so it can be called with the scheduler suspended
+
+    @param block    index of the block in record_addr
+*/
+static void preserve_block(uint16_t block) {
+    if(!saving) {
+        return;
+    }
+
+    vTaskSuspendAll();
+
+    if(snapshot[block / 32] & (1UL << (block % 32))) {
+        uint8_t slot = CONFIG_SAVE_COW_SLOTS;
+        uint8_t held = 0;
+
+        for(uint8_t i = 0; i < CONFIG_SAVE_COW_SLOTS; i++) {
+            if(cow_block[i] == block) {
+                held = 1;
+                break;
+            }
+
+            if(cow_block[i] == STORE_NO_BLOCK && slot == CONFIG_SAVE_COW_SLOTS) {
+                slot = i;
+            }
+        }
+
+        // a block already copied by an earlier edit keeps that copy
+        if(!held && slot < CONFIG_SAVE_COW_SLOTS) {
+            cow_block[slot] = block;
+            cow_length[slot] = pack_block(block, cow_data[slot]);
+        } else if(!held) {
+            /*
+                no slot is free. the block is left out of this save, flash
+                keeps its previous record and the block goes in the next save
+            */
+            snapshot[block / 32] &= ~(1UL << (block % 32));
+            mark_block(block);
+            cow_overflows++;
+        }
+    }
+
+    xTaskResumeAll();
+}
+
+void store_preserve_step(uint16_t st_index) {
+    preserve_block(STORE_METADATA_RECORDS + (st_index / CONFIG_STEPS_PER_SEQUENCE));
+}
+
+void store_preserve_sequence(uint8_t sq_index) {
+    preserve_block(STORE_METADATA_RECORDS + sq_index);
+}
+
+void store_preserve_metadata(uint8_t sq_index) {
+    preserve_block(sq_index / STORE_SEQS_PER_RECORD);
+}
+
+/*
+    take the next block of the running save and copy it into payload. blocks
+    held in a slot go first to free the slots up for the editors. must be
+    called with the scheduler suspended
+
+    @param length   set to the length of the payload
+
+    @return the block, or STORE_NO_BLOCK when the save is complete
+*/
+static uint16_t next_snapshot_block(uint8_t* payload, uint16_t* length) {
+    uint16_t block = STORE_NO_BLOCK;
+
+    for(uint8_t i = 0; i < CONFIG_SAVE_COW_SLOTS; i++) {
+        if(cow_block[i] != STORE_NO_BLOCK) {
+            block = cow_block[i];
+            *length = cow_length[i];
+            memcpy(payload, cow_data[i], cow_length[i]);
+            cow_block[i] = STORE_NO_BLOCK;
+            break;
+        }
+    }
+
+    if(block == STORE_NO_BLOCK) {
+        for(uint8_t w = 0; w < (STORE_BANK_BLOCKS + 31) / 32; w++) {
+            if(snapshot[w]) {
+                block = (w * 32) + __builtin_ctz(snapshot[w]);
+                *length = pack_block(block, payload);
+                break;
+            }
+        }
+    }
+
+    if(block != STORE_NO_BLOCK) {
+        snapshot[block / 32] &= ~(1UL << (block % 32));
+    }
+
+    return block;
+}
+
+/*
+    give up on a save the log has no room for. none of its records are taken
+    into the index, and every block it was to write is marked again so the
+    next save writes it as it is in ram by then
+
+    @param block    the block the save couldn't find room for
+*/
+static void abandon_save(uint16_t block) {
+    uint8_t* payload = &page[sizeof(store_header_t)];
+    uint16_t length;
+
+    vTaskSuspendAll();
+
+    mark_block(block);
+
+    for(uint16_t b = 0; b < STORE_BANK_BLOCKS; b++) {
+        if(pending_addr[b] != STORE_NO_RECORD) {
+            pending_addr[b] = STORE_NO_RECORD;
+            mark_block(b);
+        }
+    }
+
+    while((block = next_snapshot_block(payload, &length)) != STORE_NO_BLOCK) {
+        mark_block(block);
+    }
+
+    saving = 0;
+
+    xTaskResumeAll();
+}
+
+/*
+    append a record for every block that had changed when the save started.
+    the changed blocks are taken as a snapshot and any the editors change
+    before they are written are copied first by preserve_block(), so what
+    lands on flash is the sequences as they were at that moment. the save task
+    runs at the lowest priority and takes the flash one page at a time, so
+    playback and editing carry on while it runs. edits made during the save
+    are picked up by the next one
+
+    every sequence is loaded first. that marks any of bank 0 still only held
+    in the old fixed layout, so the first save moves all of it into the log
+
+    the records are only taken into the index once all of them are written,
+    and a checkpoint holding the new index commits the save. a power loss
+    before that leaves the previous save to boot from, as does the log
+    filling up with current records part way through
+
+    @return STORE_SAVE_FULL if the log had no room for the save, the edits
+            are left in ram to be saved once there is. if only the index
+            records didn't fit, the records stay in the index and the next
+            checkpoint commits them. else STORE_SAVE_OK
+*/
+uint8_t store_save() {
+    save_running = 1;
+
+    for(uint8_t i = 0; i < CONFIG_TOTAL_SEQUENCES; i++) {
+        store_load_sequence(i);
+    }
+
+    vTaskSuspendAll();
+
+    uint32_t primask = dirty_lock();
+    memcpy(snapshot, dirty, sizeof(snapshot));
+    memset(dirty, 0, sizeof(dirty));
+    dirty_unlock(primask);
+
+    // bits past the last block are never written
+    for(uint16_t b = STORE_BANK_BLOCKS; b < ((STORE_BANK_BLOCKS + 31) / 32) * 32; b++) {
+        snapshot[b / 32] &= ~(1UL << (b % 32));
+    }
+
+    saving = 1;
+
+    xTaskResumeAll();
+
+    #ifdef CONFIG_DEBUG_PRINT
+        uint32_t records = 0;
+        uint32_t pages = 0;
+    #endif
+
+    while(1) {
+        uint8_t* payload = &page[sizeof(store_header_t)];
+        uint16_t length = 0;
+
+        vTaskSuspendAll();
+        uint16_t block = next_snapshot_block(payload, &length);
+
+        if(block == STORE_NO_BLOCK) {
+            saving = 0;
+        }
+
+        xTaskResumeAll();
+
+        if(block == STORE_NO_BLOCK) {
+            break;
+        }
+
+        // a compaction started here builds its records in move_page
+        if(!make_room(record_pages(length))) {
+            abandon_save(block);
+            save_running = 0;
+            return STORE_SAVE_FULL;
+        }
+
+        pending_addr[block] = append_record(page, block, length);
+        pending_seq[block] = ((store_header_t*)page)->seq_no;
+
+        #ifdef CONFIG_DEBUG_PRINT
+            records++;
+            pages += record_pages(length);
+        #endif
+    }
+
+    xSemaphoreTake(store_mutex, portMAX_DELAY);
+
+    for(uint16_t b = 0; b < STORE_BANK_BLOCKS; b++) {
+        if(pending_addr[b] != STORE_NO_RECORD) {
+            set_record(bank_block(bank, b), pending_addr[b], pending_seq[b]);
+            pending_addr[b] = STORE_NO_RECORD;
+        }
+    }
+
+    uint8_t committed = write_checkpoint();
+
+    save_running = 0;
+
+    xSemaphoreGive(store_mutex);
+
+    #ifdef CONFIG_DEBUG_PRINT
+        char s[11];
+        uint8_t len;
+
+        send_uart(USART3, "records ", 8);
+        len = u32_to_str(records, s);
+        send_uart(USART3, s, len);
+        send_uart(USART3, " pages ", 7);
+        len = u32_to_str(pages, s);
+        send_uart(USART3, s, len);
+        send_uart(USART3, " cow overflows ", 15);
+        len = u32_to_str(cow_overflows, s);
+        send_uart(USART3, s, len);
+        send_uart(USART3, "\n\r", 2);
+    #endif
+
+    return committed ? STORE_SAVE_OK : STORE_SAVE_FULL;
+}
+
+/*
+    reclaim the oldest sectors of the log until CONFIG_STORE_FREE_SECTORS are
+    erased and ready ahead of the head. run after a save so the erases are off
+    the save path
+*/
+void store_compact() {
+    reclaim(CONFIG_STORE_FREE_SECTORS);
+}
+
+/*
+    ask for a bank to be switched to. the save task is notified with
+    SAVE_TASK_BANK to save the working set and read the bank in with
+    store_stage_bank()
+
+    @param b    the bank, asking for the bank in ram cancels a switch
+*/
+void store_select_bank(uint8_t b) {
+    if(b < CONFIG_STORE_BANKS) {
+        requested_bank = b;
+    }
+}
+
+/*
+    decode and compile a sequence of the staged bank into a swap slot. must be
+    called with store_mutex held
+*/
+static void stage_sequence(uint8_t sq_index, uint8_t slot) {
+    uint16_t block = STORE_METADATA_RECORDS + sq_index;
+    uint16_t length = stage_length[block];
+    step_t* st = swap_steps[slot];
+    uint8_t current = 0;
+
+    if(length == STAGE_NONE) {
+        if(read_record(bank_block(stage_bank, block), load_page)) {
+            length = ((store_header_t*)load_page)->length;
+            current = unpack_steps(st, &load_page[sizeof(store_header_t)], length);
+        }
+    } else if(length != STAGE_EMPTY) {
+        current = unpack_steps(st, &stage[stage_offset[block]], length);
+    }
+
+    if(!current && stage_bank == 0) {
+        load_legacy_steps(sq_index, st);
+        swap_legacy[sq_index / 32] |= 1UL << (sq_index % 32);
+    } else if(!current) {
+        memset(st, 0, sizeof(swap_steps[slot]));
+    }
+
+    compile_steps(st, swap_events[slot]);
+    swap_slot[sq_index] = slot;
+    swap_ready[sq_index / 32] |= 1UL << (sq_index % 32);
+}
+
+/*
+    read the records of the bank asked for into the stage, run by the save
+    task once the working set is saved. the store mutex is only held for a
+    record at a time so the other tasks' loads aren't held up for long. the
+    metadata blocks come first so they always fit, any sequence that doesn't
+    is read from flash once the bank is in. a bank that has never been saved
+    has no records and comes in empty
+
+    the sequences playing are then decoded and compiled into the swap slots,
+    so the swap doesn't have to. a bank staged already, whose swap found
+    other sequences playing, only has that done again
+
+    the old fixed layout only holds bank 0, and anything bank 0 held there was
+    moved into the log when the working set was saved to switch away from it
+*/
+void store_stage_bank() {
+    uint8_t next = requested_bank;
+    uint16_t used = 0;
+    uint8_t slot = 0;
+
+    xSemaphoreTake(store_mutex, portMAX_DELAY);
+
+    ready_bank = STORE_NO_BANK;
+
+    if(next == STORE_NO_BANK || next == bank) {
+        xSemaphoreGive(store_mutex);
+        return;
+    }
+
+    // the slots are about to be reused, anything still played from them is copied out
+    for(uint8_t sq = 0; sq < CONFIG_TOTAL_SEQUENCES; sq++) {
+        if(swapped[sq / 32] & (1UL << (sq % 32))) {
+            unswap(sq);
+        }
+    }
+
+    memset(swap_ready, 0, sizeof(swap_ready));
+    memset(swap_legacy, 0, sizeof(swap_legacy));
+
+    if(stage_bank != next) {
+        stage_bank = STORE_NO_BANK;
+
+        xSemaphoreGive(store_mutex);
+
+        for(uint16_t b = 0; b < STORE_BANK_BLOCKS; b++) {
+            xSemaphoreTake(store_mutex, portMAX_DELAY);
+
+            stage_length[b] = STAGE_EMPTY;
+
+            if(read_record(bank_block(next, b), load_page)) {
+                uint16_t length = ((store_header_t*)load_page)->length;
+
+                if(used + length <= CONFIG_BANK_STAGE_BYTES) {
+                    memcpy(&stage[used], &load_page[sizeof(store_header_t)], length);
+                    stage_offset[b] = used;
+                    stage_length[b] = length;
+                    used += length;
+                } else {
+                    stage_length[b] = STAGE_NONE;
+                }
+            }
+
+            xSemaphoreGive(store_mutex);
+        }
+
+        xSemaphoreTake(store_mutex, portMAX_DELAY);
+
+        stage_bank = next;
+    }
+
+    xSemaphoreGive(store_mutex);
+
+    for(uint8_t sq = 0; sq < CONFIG_TOTAL_SEQUENCES && slot < CONFIG_BANK_SWAP_SEQUENCES; sq++) {
+        if(is_sq_enabled(sq)) {
+            xSemaphoreTake(store_mutex, portMAX_DELAY);
+            stage_sequence(sq, slot++);
+            xSemaphoreGive(store_mutex);
+        }
+    }
+
+    xSemaphoreTake(store_mutex, portMAX_DELAY);
+
+    // another bank asked for while this one was read is staged next
+    if(requested_bank == next) {
+        ready_bank = next;
+    }
+
+    xSemaphoreGive(store_mutex);
+
+    #ifdef CONFIG_DEBUG_PRINT
+        char s[11];
+        uint8_t len;
+
+        send_uart(USART3, "staged bank ", 12);
+        len = u32_to_str(next, s);
+        send_uart(USART3, s, len);
+        send_uart(USART3, " bytes ", 7);
+        len = u32_to_str(used, s);
+        send_uart(USART3, s, len);
+        send_uart(USART3, " playing ", 9);
+        len = u32_to_str(slot, s);
+        send_uart(USART3, s, len);
+        send_uart(USART3, "\n\r", 2);
+    #endif
+}
+
+/*
+    swap the staged bank into the working set, called by the play task on the
+    first step of every bar. it never waits, while another task holds the
+    store the swap is left to the next bar. the working set has to be saved
+    first, so nothing is swapped while a save runs or after an edit since the
+    last one
+
+    the sequences playing were decoded and compiled when the bank was staged,
+    so the swap only points the play task at them and lays the metadata over
+    sequences[]. one started since then has the bank staged again, rather
+    than the swap leaving it silent. while more play than
+    CONFIG_BANK_SWAP_SEQUENCES the switch waits for some to stop
+
+    the release of the notes still sounding is queued with the step, ahead
+    of its note offs, and every sequence starts again from its first step.
+    the rest of the sequences are copied or decoded as they are loaded
+
+    @param port_buffers     note on and note off buffers for each port
+    @param num_ports        number of elements in port_buffers
+
+    @return STORE_SWAP_DONE if the bank was swapped in, STORE_SWAP_DIRTY if
+            the working set needs saving first, STORE_SWAP_RESTAGE if the
+            sequences playing need staging, else STORE_SWAP_NONE
+*/
+uint8_t store_swap_bank(port_buffers_t* port_buffers, uint8_t num_ports) {
+    if(ready_bank == STORE_NO_BANK) {
+        return STORE_SWAP_NONE;
+    }
+
+    if(xSemaphoreTake(store_mutex, 0) != pdTRUE) {
+        return STORE_SWAP_NONE;
+    }
+
+    if(ready_bank == STORE_NO_BANK || save_running) {
+        xSemaphoreGive(store_mutex);
+        return STORE_SWAP_NONE;
+    }
+
+    for(uint8_t w = 0; w < (STORE_BANK_BLOCKS + 31) / 32; w++) {
+        if(dirty[w]) {
+            xSemaphoreGive(store_mutex);
+            return STORE_SWAP_DIRTY;
+        }
+    }
+
+    uint8_t playing = 0;
+    uint8_t unstaged = 0;
+
+    for(uint8_t sq = 0; sq < CONFIG_TOTAL_SEQUENCES; sq++) {
+        if(is_sq_enabled(sq)) {
+            playing++;
+            unstaged |= !(swap_ready[sq / 32] & (1UL << (sq % 32)));
+        }
+    }
+
+    if(unstaged) {
+        xSemaphoreGive(store_mutex);
+        return playing <= CONFIG_BANK_SWAP_SEQUENCES ? STORE_SWAP_RESTAGE : STORE_SWAP_NONE;
+    }
+
+    release_sequences(port_buffers, num_ports);
+
+    bank = ready_bank;
+    ready_bank = STORE_NO_BANK;
+
+    for(uint16_t b = 0; b < STORE_METADATA_RECORDS; b++) {
+        if(stage_length[b] == METADATA_PAYLOAD) {
+            unpack_block(b, &stage[stage_offset[b]], METADATA_PAYLOAD);
+        } else {
+            clear_metadata(b);
+        }
+    }
+
+    for(uint8_t sq = 0; sq < CONFIG_TOTAL_SEQUENCES; sq++) {
+        sequences[sq].counter = 0;
+        sequences[sq].prescale_counter = 0;
+
+        if(swap_ready[sq / 32] & (1UL << (sq % 32))) {
+            uint8_t slot = swap_slot[sq];
+            play_steps_from(sq, swap_steps[slot], swap_events[slot]);
+        }
+    }
+
+    uint32_t primask = dirty_lock();
+    memset(loaded, 0, sizeof(loaded));
+    memcpy(swapped, swap_ready, sizeof(swapped));
+    memset(swap_ready, 0, sizeof(swap_ready));
+    dirty_unlock(primask);
+
+    xSemaphoreGive(store_mutex);
+
+    return STORE_SWAP_DONE;
+}
+
+/*
+    @return the bank in sequences[] and steps[]
+*/
+uint8_t store_bank() {
+    return bank;
+}
@@ -4,96 +4,185 @@
 #include "tasks.h"
 #include "timers.h"
 #include "midi.h"
-#include "keyboard.h"
+#include "key_matrix.h"
 #include "menu.h"
 #include "sequence.h"
+#include "store.h"
+#include "flash.h"
+#include "display.h"
 #include "m_buf.h"
 #include "k_buf.h"
 #include "rotary_encoder.h"
 #include "semphr.h"
 #include "uart.h"
+#include "clock.h"
+#include "util.h"
+#include "stm32f722xx.h"
 
-#define NOTE_BUFFER_SIZE (CONFIG_MAX_SEQUENCES * CONFIG_MAX_POLYPHONY)
+/*
+    one extra slot as the ring buffer always keeps one empty. on top of its
+    note offs a sequence can queue two releases a step, one for a disabled
+    step and one for a bank swap
+*/
+#define NOTE_ON_BUFFER_SIZE ((CONFIG_MAX_SEQUENCES * CONFIG_MAX_POLYPHONY) + 1)
+#define NOTE_OFF_BUFFER_SIZE ((CONFIG_MAX_SEQUENCES * (CONFIG_MAX_POLYPHONY + 2)) + 1)
 
 kbuf_handle_t uart_intr_kbuf;
+extern TaskHandle_t saveTask;
 
-extern SemaphoreHandle_t midi_uart_mutex;
+/*
+    playback runs one step ahead of the clock. while the dma sends step N,
+    load_sequences() renders step N+1 and the packets are encoded into the
+    step buffer of each port, so all the clock edge has to do is hand the
+    finished buffers to the dma. the time from the edge to the first midi byte
+    no longer depends on how many sequences are enabled
+*/
+static MIDIPacket_t note_on_buffers[NUM_MIDI_PORTS][NOTE_ON_BUFFER_SIZE];
+static MIDIPacket_t note_off_buffers[NUM_MIDI_PORTS][NOTE_OFF_BUFFER_SIZE];
+static midi_buf_t note_on_mbufs[NUM_MIDI_PORTS];
+static midi_buf_t note_off_mbufs[NUM_MIDI_PORTS];
+static port_buffers_t port_buffers[NUM_MIDI_PORTS];
 
-// this is updated in menu.c tempo state
-volatile float TEMPO_PERIOD_MS = 15000/(CONFIG_TEMPO);
+#ifdef CONFIG_PROFILE_TICK
+/*
+    cpu cycles spent rendering and encoding the last step, the worst
+    seen so far and how many sequences were enabled for the last step
+*/
+static uint32_t render_cycles;
+static uint32_t render_cycles_max;
+static uint8_t render_sequences;
 
-static void uart_tx_task(void *pvParameters) {
-    UARTTaskParams_t* params = (UARTTaskParams_t*)pvParameters;
-    
-    while(1) {
-        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
-        play_notes(params->note_off, params->port);
-        play_notes(params->note_on, params->port);
+static void start_cycle_counter() {
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->LAR = 0xC5ACCE55;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+void print_tick_profile() {
+    char s[11];
+    uint8_t len;
+
+    send_uart(USART3, "render ", 7);
+    len = u32_to_str(render_cycles, s);
+    send_uart(USART3, s, len);
+    send_uart(USART3, " cycles, max ", 13);
+    len = u32_to_str(render_cycles_max, s);
+    send_uart(USART3, s, len);
+    send_uart(USART3, ", sequences ", 12);
+    len = u32_to_str(render_sequences, s);
+    send_uart(USART3, s, len);
+    send_uart(USART3, "\n\r", 2);
+}
+#endif
+
+/*
+    packets dropped because a port's note buffers were full while a step was
+    rendered
+*/
+void print_note_buffer_stats() {
+    char s[11];
+    uint8_t len;
+
+    for(uint8_t i = 0; i < NUM_MIDI_PORTS; i++) {
+        send_uart(USART3, "port ", 5);
+        send_hex(USART3, i);
+        send_uart(USART3, " note on overflows ", 19);
+        len = u32_to_str(mbuf_overflows(&note_on_mbufs[i]), s);
+        send_uart(USART3, s, len);
+        send_uart(USART3, " note off overflows ", 20);
+        len = u32_to_str(mbuf_overflows(&note_off_mbufs[i]), s);
+        send_uart(USART3, s, len);
+        send_uart(USART3, "\n\r", 2);
     }
 }
 
+static void render_step() {
+    static uint32_t step;
+
+    #ifdef CONFIG_PROFILE_TICK
+        uint32_t start = DWT->CYCCNT;
+    #endif
+
+    /*
+        a bank switch only takes effect on the first step of a bar. edits made
+        since the last save hold it back until the save task has saved them,
+        and sequences started since the bank was staged until it is staged
+        again
+    */
+    if((step++ % CONFIG_STEPS_PER_BAR) == 0) {
+        uint8_t swap = store_swap_bank(port_buffers, NUM_MIDI_PORTS);
+
+        if(swap == STORE_SWAP_DIRTY) {
+            xTaskNotify(saveTask, SAVE_TASK_SAVE, eSetBits);
+        } else if(swap == STORE_SWAP_RESTAGE) {
+            xTaskNotify(saveTask, SAVE_TASK_BANK, eSetBits);
+        } else if(swap == STORE_SWAP_DONE) {
+            xTaskNotify(saveTask, SAVE_TASK_LOAD, eSetBits);
+        }
+    }
+
+    load_sequences(port_buffers, NUM_MIDI_PORTS);
+
+    midi_out_lock();
+
+    for(uint8_t i = 0; i < NUM_MIDI_PORTS; i++) {
+        play_notes(port_buffers[i].note_off, i);
+        play_notes(port_buffers[i].note_on, i);
+    }
+
+    midi_out_unlock();
+
+    #ifdef CONFIG_PROFILE_TICK
+        render_cycles = DWT->CYCCNT - start;
+        render_sequences = num_enabled_sequences();
+
+        if(render_cycles > render_cycles_max) {
+            render_cycles_max = render_cycles;
+        }
+    #endif
+}
+
 void sq_play_task(void *pvParameters) {
-    TickType_t lastWakeTime;
-    
-    uint8_t num_ports = 4;
-    UARTTaskParams_t uart_tx_params[num_ports];
-    
-    MIDIPacket_t note_on_buffer_A[NOTE_BUFFER_SIZE];
-    MIDIPacket_t note_off_buffer_A[NOTE_BUFFER_SIZE];
-    uart_tx_params[0].port = USART1;
-    uart_tx_params[0].note_on = mbuf_init(note_on_buffer_A, NOTE_BUFFER_SIZE);
-    uart_tx_params[0].note_off = mbuf_init(note_off_buffer_A, NOTE_BUFFER_SIZE);
-    
-    MIDIPacket_t note_on_buffer_B[NOTE_BUFFER_SIZE];
-    MIDIPacket_t note_off_buffer_B[NOTE_BUFFER_SIZE];
-    uart_tx_params[1].port = USART2;
-    uart_tx_params[1].note_on = mbuf_init(note_on_buffer_B, NOTE_BUFFER_SIZE);
-    uart_tx_params[1].note_off = mbuf_init(note_off_buffer_B, NOTE_BUFFER_SIZE);
-    
-    MIDIPacket_t note_on_buffer_C[NOTE_BUFFER_SIZE];
-    MIDIPacket_t note_off_buffer_C[NOTE_BUFFER_SIZE];
-    uart_tx_params[2].port = UART4;
-    uart_tx_params[2].note_on = mbuf_init(note_on_buffer_C, NOTE_BUFFER_SIZE);
-    uart_tx_params[2].note_off = mbuf_init(note_off_buffer_C, NOTE_BUFFER_SIZE);
-    
-    
-    MIDIPacket_t note_on_buffer_D[NOTE_BUFFER_SIZE];
-    MIDIPacket_t note_off_buffer_D[NOTE_BUFFER_SIZE];
-    uart_tx_params[3].port = USART6;
-    uart_tx_params[3].note_on = mbuf_init(note_on_buffer_D, NOTE_BUFFER_SIZE);
-    uart_tx_params[3].note_off = mbuf_init(note_off_buffer_D, NOTE_BUFFER_SIZE);
-
-    TaskHandle_t uartTxTask[4];
-    xTaskCreate(uart_tx_task, "UARTA_TX", 512, &uart_tx_params[0], 2, &uartTxTask[0]);
-    xTaskCreate(uart_tx_task, "UARTB_TX", 512, &uart_tx_params[1], 2, &uartTxTask[1]);
-    xTaskCreate(uart_tx_task, "UARTC_TX", 512, &uart_tx_params[2], 2, &uartTxTask[2]);
-    xTaskCreate(uart_tx_task, "UARTD_TX", 512, &uart_tx_params[3], 2, &uartTxTask[3]);
+    for(uint8_t i = 0; i < NUM_MIDI_PORTS; i++) {
+        port_buffers[i].port = i;
+        port_buffers[i].note_on = mbuf_init(&note_on_mbufs[i], note_on_buffers[i], NOTE_ON_BUFFER_SIZE);
+        port_buffers[i].note_off = mbuf_init(&note_off_mbufs[i], note_off_buffers[i], NOTE_OFF_BUFFER_SIZE);
+    }
 
-    while(1) {
-        lastWakeTime = xTaskGetTickCount();
+    #ifdef CONFIG_PROFILE_TICK
+        start_cycle_counter();
+    #endif
 
-        load_sequences(uart_tx_params, num_ports);
+    clock_init(xTaskGetCurrentTaskHandle());
 
-        xSemaphoreTake(midi_uart_mutex, portMAX_DELAY);
+    render_step();
 
-        xTaskNotifyGive(uartTxTask[0]);
-        xTaskNotifyGive(uartTxTask[1]);
-        xTaskNotifyGive(uartTxTask[2]);
-        xTaskNotifyGive(uartTxTask[3]);
+    while(1) {
+        /*
+            the master clock gives one notification per step. the count is
+            not cleared so a step that overruns is caught up on rather than
+            skipped, keeping the sequences in time with the clock
+        */
+        ulTaskNotifyTake(pdFALSE, portMAX_DELAY);
 
-        xSemaphoreGive(midi_uart_mutex);
+        midi_out_commit();
 
-        vTaskDelayUntil(&lastWakeTime, pdMS_TO_TICKS(TEMPO_PERIOD_MS));
+        render_step();
     }
 }
 
+/*
+    the keys are scanned and debounced from a timer interrupt, see
+    key_matrix.c, and a key press wakes this task straight away. the encoder
+    and midi input are still polled, after each key event and otherwise every
+    CONFIG_KEY_SCAN_MS. shift and ctrl are only held, they are passed to the
+    menu with the keys pressed while they are down
+*/
 void key_scan_task(void *pvParameters) {
-    TickType_t lastWakeTime;
+    key_event_t ev;
+    uint16_t hold = E_NO_HOLD;
 
-    keyboard_t k;
-    kb_handle_t kb = &k;
-
-    kb_reset(kb);
     /*
         uart_intr_buf is a vector style buffer for recieving midi commands from
         a midi controller
@@ -102,15 +191,38 @@ void key_scan_task(void *pvParameters) {
     uart_intr_kbuf = kbuf_init(uart_intr_buf, 3);
     kbuf_reset(uart_intr_kbuf);
 
+    key_matrix_init();
+
     while(1) {
-        lastWakeTime = xTaskGetTickCount();
+        uint8_t key = 0xFF;
+
+        if(key_matrix_get(&ev, pdMS_TO_TICKS(CONFIG_KEY_SCAN_MS))) {
+            if(ev.key == E_SHIFT || ev.key == E_CTRL) {
+                if(ev.type == KEY_PRESS) {
+                    hold = ev.key;
+                } else if(ev.type == KEY_RELEASE && hold == ev.key) {
+                    hold = E_NO_HOLD;
+                }
+            } else if(ev.type == KEY_PRESS) {
+                key = ev.key;
+            }
+        }
+
         int8_t encoder_dir = get_encoder_direction();
 
-        scan(kb);
+        if(key != 0xFF) {
+            #ifdef CONFIG_DEBUG_PRINT
+                char s[11];
+                uint8_t len = u32_to_str(xTaskGetTickCount() - ev.time, s);
 
-        if(kb->ready) {
-            menu(kb->key, kb->hold);
-            kb->ready = 0;
+                send_uart(USART3, "key ", 4);
+                send_hex(USART3, key);
+                send_uart(USART3, " after ms ", 10);
+                send_uart(USART3, s, len);
+                send_uart(USART3, "\n\r", 2);
+            #endif
+
+            menu(key, hold);
         } else if(kbuf_ready(uart_intr_kbuf)) {
             menu(E_ST_NOTE, E_NO_HOLD);
         } else if(encoder_dir != 0) {
@@ -122,27 +234,146 @@ void key_scan_task(void *pvParameters) {
             */
             menu(0xFFFD + encoder_dir, 0xFFFF);
         } else {
-            kb_reset(kb);
+            menu_refresh();
         }
+    }
 
-        vTaskDelayUntil(&lastWakeTime, pdMS_TO_TICKS(CONFIG_KEY_SCAN_MS));
+    vTaskDelete(NULL);
+}
+
+/*
+    load the steps of every sequence in the background. a sequence that is
+    enabled or edited first is loaded straight away by the task that needs it,
+    this only fills in the rest
+*/
+void prefetch_task(void *pvParameters) {
+    for(uint8_t i = 0; i < CONFIG_TOTAL_SEQUENCES; i++) {
+        store_load_sequence(i);
     }
 
+    #ifdef CONFIG_DEBUG_PRINT
+        send_uart(USART3, "all sequences loaded\n\r", 22);
+    #endif
+
     vTaskDelete(NULL);
 }
 
-void save_task(void *pvParameters) {
+#ifdef CONFIG_MIDI_OUT_TRACE
+// how often the trace is drained
+#define TRACE_PERIOD pdMS_TO_TICKS(20)
+
+/*
+    print the step buffers midi_out_commit() put in the trace, one line each
+    with the step number, clock count, port and bytes. the debug uart runs at
+    9600 baud so this is left to the lowest priority, the play task only ever
+    copies a step into ram
+*/
+void trace_task(void *pvParameters) {
+    static uint8_t data[CONFIG_MIDI_TX_BUFFER_LENGTH];
+    midi_out_trace_t t;
+    uint32_t dropped = 0;
+    char s[11];
+    uint8_t len;
+
+    while(1) {
+        while(midi_out_trace_read(&t, data)) {
+            len = u32_to_str(t.step, s);
+            send_uart(USART3, s, len);
+            send_uart(USART3, " ", 1);
+            len = u32_to_str(t.now, s);
+            send_uart(USART3, s, len);
+            send_uart(USART3, " ", 1);
+            send_hex(USART3, t.port);
+
+            for(uint16_t i = 0; i < t.len; i++) {
+                send_uart(USART3, " ", 1);
+                send_hex(USART3, data[i]);
+            }
+
+            send_uart(USART3, "\n\r", 2);
+        }
+
+        if(midi_out_trace_dropped() != dropped) {
+            dropped = midi_out_trace_dropped();
+
+            send_uart(USART3, "trace dropped ", 14);
+            len = u32_to_str(dropped, s);
+            send_uart(USART3, s, len);
+            send_uart(USART3, "\n\r", 2);
+        }
+
+        vTaskDelay(TRACE_PERIOD);
+    }
+}
+#endif
+
+/*
+    carry out the requests queued for the flash, see flash.c. each request
+    queued notifies the task, so one queued while the last batch was served is
+    picked up straight away
+*/
+void flash_task(void *pvParameters) {
+    while(1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        flash_serve();
+    }
+}
+
+/*
+    send the frames update_display() hands over, see display.c. the first
+    frame, drawn in setup(), was handed over before the task existed
+*/
+void display_task(void *pvParameters) {
+    display_start();
+
     while(1) {
+        display_serve();
+
         ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+}
+
+void save_task(void *pvParameters) {
+    uint32_t events;
+
+    while(1) {
+        xTaskNotifyWait(0, 0xFFFFFFFF, &events, portMAX_DELAY);
 
-        #ifdef CONFIG_DEBUG_PRINT
-            send_uart(USART3, "saving data\n\r", 13);
-        #endif
+        // the sequences in ram are saved before another bank is read over them
+        if(events & (SAVE_TASK_SAVE | SAVE_TASK_BANK)) {
+            #ifdef CONFIG_DEBUG_PRINT
+                send_uart(USART3, "saving data\n\r", 13);
+            #endif
 
-        save_data();
+            if(store_save() == STORE_SAVE_FULL) {
+                #ifdef CONFIG_DEBUG_PRINT
+                    send_uart(USART3, "store full\n\r", 12);
+                #endif
 
-        #ifdef CONFIG_DEBUG_PRINT
-            send_uart(USART3, "finished saving\n\r", 17);
-        #endif    
+                /*
+                    the edits are still only in ram, so the bank in ram stays.
+                    asking for it again cancels the switch
+                */
+                store_select_bank(store_bank());
+                events |= SAVE_TASK_BANK;
+            } else {
+                store_compact();
+
+                #ifdef CONFIG_DEBUG_PRINT
+                    send_uart(USART3, "finished saving\n\r", 17);
+                #endif
+            }
+        }
+
+        if(events & SAVE_TASK_BANK) {
+            store_stage_bank();
+        }
+
+        if(events & SAVE_TASK_LOAD) {
+            for(uint8_t i = 0; i < CONFIG_TOTAL_SEQUENCES; i++) {
+                store_load_sequence(i);
+            }
+        }
     }
 }
@@ -150,4 +150,52 @@ uint8_t find_first_bit(uint32_t* field) {
         return _find_first_bit(field[1]) + 32;
     }
     return 0xFF;
-}
\ No newline at end of file
+}
+
+/*
+    write n as a decimal string, without leading zeros, into s
+
+    @param n    the number to convert
+    @param s    buffer of at least 11 bytes, the string is null terminated
+
+    @return the number of digits written
+*/
+uint8_t u32_to_str(uint32_t n, char* s) {
+    char digits[10];
+    uint8_t len = 0;
+
+    do {
+        digits[len++] = (n % 10) + 48;
+        n /= 10;
+    } while(n > 0);
+
+    for(uint8_t i = 0; i < len; i++) {
+        s[i] = digits[len - 1 - i];
+    }
+
+    s[len] = '\0';
+
+    return len;
+}
+
+/*
+    reflected crc-32 (polynomial 0xEDB88320) computed a bit at a time. slow but
+    only used when flash records are written or loaded
+
+    @param crc      0 to start, or the result of a previous call to continue
+    @param data     bytes to add to the crc
+    @param len      number of bytes in data
+*/
+uint32_t crc32(uint32_t crc, uint8_t* data, uint32_t len) {
+    crc = ~crc;
+
+    for(uint32_t i = 0; i < len; i++) {
+        crc ^= data[i];
+
+        for(uint8_t b = 0; b < 8; b++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+        }
+    }
+
+    return ~crc;
+}